@@ -5,10 +5,13 @@
 #include <string.h>          // strcpy
 #include <stdlib.h>          // free
 #include <pthread.h>          // pthread_t, pthread_create, pthread_join
+#include <fcntl.h>          // open
 
 #include "netlogging.h"
 
 #define PORT 65432
+#define RECORDER_PATH   "/dev/shm/netlogging.rec"          // Records not sent yet, kept if the process dies
+#define CRASH_DUMP_PATH "/tmp/netlogging."          // Followed by the pid and ".rec"
 
 
 
@@ -27,6 +30,33 @@ static void dump_backtrace(int  signal,
     char        **strings;
     size_t      i;
     struct sigaction     sa;
+    char        path[64]    = CRASH_DUMP_PATH;
+    size_t      len         = sizeof(CRASH_DUMP_PATH) - 1;
+    char        digits[16];
+    int         nb_digits   = 0;
+    int         fd          = -1;
+
+
+    // Save the records not sent yet first, with async-signal-safe calls only
+    for ( pid_t pid = getpid(); (pid != 0) || (nb_digits == 0); pid /= 10 )
+    {
+        digits[nb_digits++] = '0' + pid % 10;
+    }
+
+    while ( nb_digits > 0 )
+    {
+        path[len++] = digits[--nb_digits];
+    }
+
+    memcpy(path + len, ".rec", sizeof(".rec") );
+
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0640);
+
+    if ( fd != -1 )
+    {
+        netlogg_recorder_dump(fd);
+        close(fd);
+    }
 
 
     size    = backtrace(array, 32);
@@ -74,7 +104,8 @@ int main(int        argc,
     Netlogging_args args = {
         .progname = argv[0],
         .port = PORT,
-        .dft_lvl = NETLOGG_DEBUG
+        .dft_lvl = NETLOGG_DEBUG,
+        .recorder_path = RECORDER_PATH
     };
 
     struct sigaction     sa;
@@ -0,0 +1,97 @@
+/**
+ * @file netlogg_allocs.c
+ * @author hbuyse
+ * @date 16/10/2026
+ *
+ * The wrappers call the functions of the glibc directly (__libc_malloc...):
+ * dlsym may allocate, it cannot be used to find the next malloc.
+ */
+
+#include <stddef.h>          // size_t
+
+#include "netlogg_allocs.h"
+
+
+#define COUNT(c)        __atomic_add_fetch(&(c), 1, __ATOMIC_RELAXED)
+
+
+/**
+ * \brief Allocations and frees (atomic)
+ */
+static uint64_t     nb_allocs   = 0;
+static uint64_t     nb_frees    = 0;
+
+
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t nmemb, size_t size);
+extern void* __libc_realloc(void *ptr, size_t size);
+extern void* __libc_memalign(size_t alignment, size_t size);
+extern void __libc_free(void *ptr);
+
+
+
+void* malloc(size_t size)
+{
+    COUNT(nb_allocs);
+
+    return (__libc_malloc(size) );
+}
+
+
+
+void* calloc(size_t nmemb,
+             size_t size
+             )
+{
+    COUNT(nb_allocs);
+
+    return (__libc_calloc(nmemb, size) );
+}
+
+
+
+void* realloc(void      *ptr,
+              size_t    size
+              )
+{
+    COUNT(nb_allocs);
+
+    return (__libc_realloc(ptr, size) );
+}
+
+
+
+void* aligned_alloc(size_t  alignment,
+                    size_t  size
+                    )
+{
+    COUNT(nb_allocs);
+
+    return (__libc_memalign(alignment, size) );
+}
+
+
+
+void free(void *ptr)
+{
+    if ( ptr != NULL )
+    {
+        COUNT(nb_frees);
+    }
+
+    __libc_free(ptr);
+}
+
+
+
+uint64_t netlogg_allocs(void)
+{
+    return (__atomic_load_n(&nb_allocs, __ATOMIC_RELAXED) );
+}
+
+
+
+uint64_t netlogg_frees(void)
+{
+    return (__atomic_load_n(&nb_frees, __ATOMIC_RELAXED) );
+}
@@ -0,0 +1,42 @@
+/**
+ * @file netlogg_allocs.h
+ * @author hbuyse
+ * @date 16/10/2026
+ *
+ * Allocator of the benchmarks and of the tests: malloc, calloc, realloc,
+ * aligned_alloc and free are wrapped to count the calls of the whole process,
+ * the library included. Not part of the library.
+ */
+
+
+#ifndef __NETLOGG_ALLOCS_H__
+#define __NETLOGG_ALLOCS_H__
+
+#include <stdint.h>          // uint64_t
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * \brief      Get the number of allocations (malloc, calloc, realloc and aligned_alloc) since the start
+ *
+ * \return     The number of allocations
+ */
+uint64_t netlogg_allocs(void);
+
+
+/**
+ * \brief      Get the number of frees (of a non NULL pointer) since the start
+ *
+ * \return     The number of frees
+ */
+uint64_t netlogg_frees(void);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif          // __NETLOGG_ALLOCS_H__
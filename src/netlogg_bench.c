@@ -0,0 +1,902 @@
+/**
+ * @file netlogg_bench.c
+ * @author hbuyse
+ * @date 16/10/2026
+ *
+ * Benchmarks of the netlogging library, run by `make bench`:
+ *
+ * - latency: time of one NETLOGG call for 1 to N producer threads, for a level
+ *   nobody wants (disabled) and for a level a client wants (enabled)
+ * - fanout: messages and bytes per second received by 1, 10 and 100 local TCP
+ *   clients, with and without a client reading slowly
+ * - cost: allocations and system calls of the library per 1000 messages sent
+ *   to 10 clients
+ *
+ * Each result is printed on stdout as one JSON object per line, so that two
+ * releases can be compared by a script. The allocations are counted by
+ * wrapping the allocator (see netlogg_allocs.c), and the system calls by
+ * wrapping the libc functions the library calls (the futex of the mutexes and
+ * the vDSO calls are not counted).
+ *
+ * Environment: BENCH_PORT (65434), BENCH_THREADS (number of CPUs, at most 16),
+ * BENCH_CALLS (calls per thread, 200000), BENCH_MSGS (messages per fan-out
+ * run, 200000), BENCH_WORKERS (Netlogging_args.workers, 0).
+ */
+
+#include <stdio.h>          // printf, fprintf
+#include <stdlib.h>          // getenv, atoi, qsort, malloc
+#include <string.h>          // memchr, memset
+#include <errno.h>          // errno
+#include <time.h>          // clock_gettime, nanosleep
+#include <unistd.h>          // sysconf, close
+#include <dlfcn.h>          // dlsym, RTLD_NEXT
+#include <pthread.h>          // pthread_create, pthread_join
+#include <sched.h>          // sched_yield
+#include <inttypes.h>          // PRIu64
+#include <sys/socket.h>          // socket, connect, recv, send
+#include <sys/resource.h>          // getrusage
+#include <sys/uio.h>          // struct iovec
+#include <sys/epoll.h>          // epoll_wait, epoll_ctl
+#include <sys/eventfd.h>          // eventfd_read, eventfd_write
+#include <netinet/in.h>          // struct sockaddr_in
+#include <arpa/inet.h>          // htons, htonl
+
+#include "netlogging.h"          // NETLOGG, netlogg_init, netlogg_send_site
+#include "netlogg_allocs.h"          // netlogg_allocs, netlogg_frees
+
+
+#define NBELEMS(e)          (sizeof(e) / sizeof(e[0]) )
+
+#define PORT_DFT            65434
+#define THREADS_MAX         16
+#define CALLS_DFT           200000
+#define MSGS_DFT            200000
+#define SETTLE_MS           300          // Time given to the clients to connect and change their level
+#define QUIET_MS            500          // A run ends when the clients received nothing for this long
+#define SLOW_READ           4096          // Bytes read by the slow client at once
+#define SLOW_PAUSE_US       5000          // Pause of the slow client between two reads
+#define PAYLOAD             "abcdefghijklmnopqrstuvwxyz0123456789"
+
+
+/**
+ * \brief System calls wrapped to be counted
+ */
+typedef enum {
+    SC_SENDMSG = 0,
+    SC_SENDMMSG,
+    SC_RECV,
+    SC_EPOLL_WAIT,
+    SC_EPOLL_CTL,
+    SC_EVENTFD_READ,
+    SC_EVENTFD_WRITE,
+    SC_PWRITEV,
+    SC_WRITE,
+    SC_MAX
+} bench_syscall;
+
+
+/**
+ * \brief Names of the counted system calls (keys of the JSON output)
+ */
+static const char     *sc_names[SC_MAX] =
+{
+    [SC_SENDMSG]        = "sendmsg",
+    [SC_SENDMMSG]       = "sendmmsg",
+    [SC_RECV]           = "recv",
+    [SC_EPOLL_WAIT]     = "epoll_wait",
+    [SC_EPOLL_CTL]      = "epoll_ctl",
+    [SC_EVENTFD_READ]   = "eventfd_read",
+    [SC_EVENTFD_WRITE]  = "eventfd_write",
+    [SC_PWRITEV]        = "pwritev",
+    [SC_WRITE]          = "write"
+};
+
+
+/**
+ * \brief Calls of each system call (atomic)
+ */
+static uint64_t     sc_counts[SC_MAX];
+
+
+/**
+ * \brief Client of a fan-out run, read by its own thread
+ */
+typedef struct {
+    pthread_t thread;          ///< Thread reading the client
+    int fd;          ///< Connection to the netlogging thread
+    int slow;          ///< Read SLOW_READ bytes every SLOW_PAUSE_US
+    int stop;          ///< Set by the main thread at the end of the run (atomic)
+    uint64_t msgs;          ///< Lines received (atomic, reset when the run starts)
+    uint64_t bytes;          ///< Bytes received (atomic, reset when the run starts)
+    uint64_t last_ns;          ///< Time of the last bytes received (atomic)
+} bench_client;
+
+
+/**
+ * \brief Producer thread of the latency benchmark
+ */
+typedef struct {
+    pthread_t thread;          ///< Thread of the producer
+    int enabled;          ///< Log at a level a client wants
+    uint32_t calls;          ///< Calls made
+    uint32_t *samples;          ///< Duration of each call (nanoseconds)
+} bench_producer;
+
+
+/**
+ * \brief Port of the netlogging thread
+ */
+static uint16_t     gPort           = PORT_DFT;
+
+
+/**
+ * \brief Call site of the messages sent without the level checks of NETLOGG
+ */
+static netlogg_site     bench_site     = {__FILE__, "bench %u %s", __LINE__, NETLOGG_INFO, 0, NETLOGG_BP_LEVEL};
+
+
+/**
+ * \brief Producers go when it is set (atomic)
+ */
+static int     go                   = 0;
+
+
+
+
+/*
+ *============================================================================
+ * Wrappers counting the system calls (the allocations are counted by netlogg_allocs.c)
+ *============================================================================
+ */
+#define SC_NEXT(type, name, ...) \
+    static type (*next)(__VA_ARGS__) = NULL; \
+    if ( next == NULL ) \
+    { \
+        next = (type (*)(__VA_ARGS__) ) dlsym(RTLD_NEXT, name); \
+    }
+
+#define COUNT(c)        __atomic_add_fetch(&(c), 1, __ATOMIC_RELAXED)
+
+
+ssize_t sendmsg(int                     fd,
+                const struct msghdr     *msg,
+                int                     flags
+                )
+{
+    SC_NEXT(ssize_t, "sendmsg", int, const struct msghdr *, int);
+    COUNT(sc_counts[SC_SENDMSG]);
+
+    return (next(fd, msg, flags) );
+}
+
+
+
+int sendmmsg(int                fd,
+             struct mmsghdr     *msgvec,
+             unsigned int       vlen,
+             int                flags
+             )
+{
+    SC_NEXT(int, "sendmmsg", int, struct mmsghdr *, unsigned int, int);
+    COUNT(sc_counts[SC_SENDMMSG]);
+
+    return (next(fd, msgvec, vlen, flags) );
+}
+
+
+
+ssize_t recv(int        fd,
+             void       *buff,
+             size_t     len,
+             int        flags
+             )
+{
+    SC_NEXT(ssize_t, "recv", int, void *, size_t, int);
+    COUNT(sc_counts[SC_RECV]);
+
+    return (next(fd, buff, len, flags) );
+}
+
+
+
+int epoll_wait(int                  epfd,
+               struct epoll_event   *events,
+               int                  maxevents,
+               int                  timeout
+               )
+{
+    SC_NEXT(int, "epoll_wait", int, struct epoll_event *, int, int);
+    COUNT(sc_counts[SC_EPOLL_WAIT]);
+
+    return (next(epfd, events, maxevents, timeout) );
+}
+
+
+
+int epoll_ctl(int                   epfd,
+              int                   op,
+              int                   fd,
+              struct epoll_event    *event
+              )
+{
+    SC_NEXT(int, "epoll_ctl", int, int, int, struct epoll_event *);
+    COUNT(sc_counts[SC_EPOLL_CTL]);
+
+    return (next(epfd, op, fd, event) );
+}
+
+
+
+int eventfd_read(int            fd,
+                 eventfd_t      *value
+                 )
+{
+    SC_NEXT(int, "eventfd_read", int, eventfd_t *);
+    COUNT(sc_counts[SC_EVENTFD_READ]);
+
+    return (next(fd, value) );
+}
+
+
+
+int eventfd_write(int           fd,
+                  eventfd_t     value
+                  )
+{
+    SC_NEXT(int, "eventfd_write", int, eventfd_t);
+    COUNT(sc_counts[SC_EVENTFD_WRITE]);
+
+    return (next(fd, value) );
+}
+
+
+
+ssize_t pwritev(int                     fd,
+                const struct iovec      *iov,
+                int                     iovcnt,
+                off_t                   offset
+                )
+{
+    SC_NEXT(ssize_t, "pwritev", int, const struct iovec *, int, off_t);
+    COUNT(sc_counts[SC_PWRITEV]);
+
+    return (next(fd, iov, iovcnt, offset) );
+}
+
+
+
+ssize_t write(int           fd,
+              const void    *buff,
+              size_t        len
+              )
+{
+    SC_NEXT(ssize_t, "write", int, const void *, size_t);
+    COUNT(sc_counts[SC_WRITE]);
+
+    return (next(fd, buff, len) );
+}
+
+
+
+
+/*
+ *============================================================================
+ * now_ns
+ *============================================================================
+ */
+static uint64_t now_ns(void)
+{
+    struct timespec     ts;
+
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ( (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec);
+}
+
+
+
+
+/*
+ *============================================================================
+ * sleep_ms
+ *============================================================================
+ */
+static void sleep_ms(uint32_t ms)
+{
+    struct timespec     ts = {ms / 1000, (ms % 1000) * 1000000l};
+
+
+    while ( (nanosleep(&ts, &ts) == -1) && (errno == EINTR) )
+    {
+    }
+}
+
+
+
+
+/*
+ *============================================================================
+ * env_u32
+ *============================================================================
+ */
+static uint32_t env_u32(const char  *name,
+                        uint32_t    dft
+                        )
+{
+    const char     *val = getenv(name);
+
+
+    return ( (val != NULL) && (atoi(val) > 0) ? (uint32_t) atoi(val) : dft);
+}
+
+
+
+
+/*
+ *============================================================================
+ * client_connect
+ *============================================================================
+ */
+static int client_connect(const char *cmd)
+{
+    struct sockaddr_in  addr;
+    int                 fd  = socket(AF_INET, SOCK_STREAM, 0);
+
+
+    if ( fd == -1 )
+    {
+        return (-1);
+    }
+
+    memset(&addr, 0, sizeof(addr) );
+    addr.sin_family         = AF_INET;
+    addr.sin_port           = htons(gPort);
+    addr.sin_addr.s_addr    = htonl(INADDR_LOOPBACK);
+
+    if ( (connect(fd, (struct sockaddr *) &addr, sizeof(addr) ) == -1) || (send(fd, cmd, strlen(cmd), 0) == -1) )
+    {
+        close(fd);
+
+        return (-1);
+    }
+
+    return (fd);
+}
+
+
+
+
+/*
+ *============================================================================
+ * client_run
+ *============================================================================
+ */
+static void* client_run(void *arg)
+{
+    bench_client    *c      = arg;
+    char            buff[64 * 1024];
+    ssize_t         r       = 0;
+    const char      *p      = NULL;
+    uint64_t        lines   = 0;
+
+
+    while ( ! __atomic_load_n(&c->stop, __ATOMIC_RELAXED) )
+    {
+        r = recv(c->fd, buff, c->slow ? SLOW_READ : sizeof(buff), 0);
+
+        if ( r <= 0 )
+        {
+            break;
+        }
+
+        for ( lines = 0, p = buff; (p = memchr(p, '\n', buff + r - p) ) != NULL; p++ )
+        {
+            lines++;
+        }
+
+        __atomic_add_fetch(&c->msgs, lines, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&c->bytes, r, __ATOMIC_RELAXED);
+        __atomic_store_n(&c->last_ns, now_ns(), __ATOMIC_RELAXED);
+
+        if ( c->slow )
+        {
+            usleep(SLOW_PAUSE_US);
+        }
+    }
+
+    return (NULL);
+}
+
+
+
+
+/*
+ *============================================================================
+ * clients_start
+ *============================================================================
+ */
+static bench_client* clients_start(uint32_t     nb,
+                                   int          slow,
+                                   const char   *cmd
+                                   )
+{
+    bench_client     *clients = calloc(nb + 1, sizeof(*clients) );
+
+
+    if ( clients == NULL )
+    {
+        return (NULL);
+    }
+
+    // The slow client is the last one
+    for ( uint32_t i = 0; i < nb + (slow != 0); i++ )
+    {
+        clients[i].slow = (i == nb);
+        clients[i].fd   = client_connect(cmd);
+
+        if ( clients[i].fd == -1 )
+        {
+            perror("connect");
+            exit(1);
+        }
+
+        pthread_create(&clients[i].thread, NULL, client_run, &clients[i]);
+    }
+
+    // Let the netlogging thread take the connections and the level, then forget the help
+    sleep_ms(SETTLE_MS);
+
+    for ( uint32_t i = 0; i < nb + (slow != 0); i++ )
+    {
+        __atomic_store_n(&clients[i].msgs, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&clients[i].bytes, 0, __ATOMIC_RELAXED);
+    }
+
+    return (clients);
+}
+
+
+
+
+/*
+ *============================================================================
+ * clients_stop
+ *============================================================================
+ */
+static void clients_stop(bench_client   *clients,
+                         uint32_t       nb
+                         )
+{
+    for ( uint32_t i = 0; i < nb; i++ )
+    {
+        __atomic_store_n(&clients[i].stop, 1, __ATOMIC_RELAXED);
+        shutdown(clients[i].fd, SHUT_RDWR);
+        pthread_join(clients[i].thread, NULL);
+        close(clients[i].fd);
+    }
+
+    free(clients);
+
+    // Let the netlogging thread see the connections closed
+    sleep_ms(SETTLE_MS);
+}
+
+
+
+
+/*
+ *============================================================================
+ * clients_wait
+ *============================================================================
+ */
+static void clients_wait(bench_client   *clients,
+                         uint32_t       nb,
+                         uint64_t       expected
+                         )
+{
+    uint64_t        total   = 0;
+    uint64_t        prev    = UINT64_MAX;
+    uint64_t        since   = now_ns();
+
+
+    // Until every fast client has everything, or nothing comes any more
+    for ( ; ; )
+    {
+        total = 0;
+
+        for ( uint32_t i = 0; i < nb; i++ )
+        {
+            total += __atomic_load_n(&clients[i].msgs, __ATOMIC_RELAXED);
+        }
+
+        if ( total >= expected * nb )
+        {
+            return;
+        }
+
+        if ( total != prev )
+        {
+            prev    = total;
+            since   = now_ns();
+        }
+        else if ( now_ns() - since > QUIET_MS * 1000000ull )
+        {
+            return;
+        }
+
+        sleep_ms(1);
+    }
+}
+
+
+
+
+/*
+ *============================================================================
+ * cmp_u32
+ *============================================================================
+ */
+static int cmp_u32(const void   *a,
+                   const void   *b
+                   )
+{
+    uint32_t    va  = *(const uint32_t *) a;
+    uint32_t    vb  = *(const uint32_t *) b;
+
+
+    return ( (va > vb) - (va < vb) );
+}
+
+
+
+
+/*
+ *============================================================================
+ * producer_run
+ *============================================================================
+ */
+static void* producer_run(void *arg)
+{
+    bench_producer  *p  = arg;
+    uint64_t        t0  = 0;
+    uint64_t        t1  = 0;
+
+
+    while ( ! __atomic_load_n(&go, __ATOMIC_ACQUIRE) )
+    {
+    }
+
+    for ( uint32_t i = 0; i < p->calls; i++ )
+    {
+        // The levels have to be constants
+        if ( p->enabled )
+        {
+            t0 = now_ns();
+            NETLOGG(NETLOGG_INFO, "bench %u %s", i, PAYLOAD);
+            t1 = now_ns();
+        }
+        else
+        {
+            t0 = now_ns();
+            NETLOGG(NETLOGG_DEBUG, "bench %u %s", i, PAYLOAD);
+            t1 = now_ns();
+        }
+
+        p->samples[i] = (t1 - t0 < UINT32_MAX) ? (uint32_t) (t1 - t0) : UINT32_MAX;
+    }
+
+    return (NULL);
+}
+
+
+
+
+/*
+ *============================================================================
+ * bench_latency
+ *============================================================================
+ */
+static void bench_latency(bench_client  *sink,
+                          uint32_t      nb_threads,
+                          int           enabled,
+                          uint32_t      calls
+                          )
+{
+    bench_producer  producers[THREADS_MAX];
+    uint32_t        *all    = malloc( (size_t) nb_threads * calls * sizeof(*all) );
+    uint64_t        n       = (uint64_t) nb_threads * calls;
+    uint64_t        sum     = 0;
+    uint64_t        t0      = 0;
+    uint64_t        t1      = 0;
+
+
+    if ( all == NULL )
+    {
+        perror("malloc");
+        exit(1);
+    }
+
+    __atomic_store_n(&go, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&sink->msgs, 0, __ATOMIC_RELAXED);
+
+    for ( uint32_t i = 0; i < nb_threads; i++ )
+    {
+        producers[i].enabled    = enabled;
+        producers[i].calls      = calls;
+        producers[i].samples    = all + (size_t) i * calls;
+        pthread_create(&producers[i].thread, NULL, producer_run, &producers[i]);
+    }
+
+    t0 = now_ns();
+    __atomic_store_n(&go, 1, __ATOMIC_RELEASE);
+
+    for ( uint32_t i = 0; i < nb_threads; i++ )
+    {
+        pthread_join(producers[i].thread, NULL);
+    }
+
+    t1 = now_ns();
+
+    // The calls that found the ring full returned at once: only the delivered messages were logged
+    if ( enabled )
+    {
+        clients_wait(sink, 1, n);
+    }
+
+    qsort(all, n, sizeof(*all), cmp_u32);
+
+    for ( uint64_t i = 0; i < n; i++ )
+    {
+        sum += all[i];
+    }
+
+    printf("{\"bench\":\"latency\",\"level\":\"%s\",\"threads\":%" PRIu32 ",\"calls\":%" PRIu64 ",\"calls_per_sec\":%.0f,"
+           "\"mean_ns\":%.1f,\"p50_ns\":%" PRIu32 ",\"p90_ns\":%" PRIu32 ",\"p99_ns\":%" PRIu32 ",\"p999_ns\":%" PRIu32 ",\"max_ns\":%" PRIu32 ",\"delivered\":%" PRIu64 "}\n",
+           enabled ? "enabled" : "disabled", nb_threads, n, n * 1e9 / (t1 - t0), (double) sum / n, all[n / 2], all[n * 90 / 100],
+           all[n * 99 / 100], all[n * 999 / 1000], all[n - 1],
+           __atomic_load_n(&sink->msgs, __ATOMIC_RELAXED) );
+    fflush(stdout);
+
+    free(all);
+}
+
+
+
+
+/*
+ *============================================================================
+ * bench_timer
+ *============================================================================
+ */
+static void bench_timer(void)
+{
+    uint64_t        t0      = 0;
+    uint64_t        best    = UINT64_MAX;
+
+
+    // Cost of the two clock_gettime around each call of the latency benchmark
+    for ( int i = 0; i < 100000; i++ )
+    {
+        t0      = now_ns();
+        t0      = now_ns() - t0;
+        best    = (t0 < best) ? t0 : best;
+    }
+
+    printf("{\"bench\":\"timer\",\"min_ns\":%" PRIu64 "}\n", best);
+}
+
+
+
+
+/*
+ *============================================================================
+ * produce
+ *============================================================================
+ */
+static uint64_t produce(uint32_t    msgs,
+                        uint64_t    *retries
+                        )
+{
+    // netlogg_send_site tells when the ring is full: wait for the netlogging thread instead of dropping
+    for ( uint32_t i = 0; i < msgs; i++ )
+    {
+        while ( netlogg_send_site(&bench_site, -1, i, PAYLOAD) != 0 )
+        {
+            (*retries)++;
+            sched_yield();
+        }
+    }
+
+    return (msgs);
+}
+
+
+
+
+/*
+ *============================================================================
+ * bench_fanout
+ *============================================================================
+ */
+static void bench_fanout(uint32_t   nb,
+                         int        slow,
+                         uint32_t   msgs
+                         )
+{
+    bench_client    *clients    = clients_start(nb, slow, "loglevel info\r\n");
+    uint64_t        retries     = 0;
+    uint64_t        t0          = 0;
+    uint64_t        t1          = 0;
+    uint64_t        rx_msgs     = 0;
+    uint64_t        rx_bytes    = 0;
+    double          secs        = 0;
+
+
+    if ( clients == NULL )
+    {
+        perror("calloc");
+        exit(1);
+    }
+
+    t0 = now_ns();
+    produce(msgs, &retries);
+    clients_wait(clients, nb, msgs);
+
+    for ( uint32_t i = 0; i < nb; i++ )
+    {
+        rx_msgs     += __atomic_load_n(&clients[i].msgs, __ATOMIC_RELAXED);
+        rx_bytes    += __atomic_load_n(&clients[i].bytes, __ATOMIC_RELAXED);
+        t1          = (clients[i].last_ns > t1) ? clients[i].last_ns : t1;
+    }
+
+    secs = (t1 > t0) ? (t1 - t0) / 1e9 : 1e-9;
+
+    printf("{\"bench\":\"fanout\",\"clients\":%" PRIu32 ",\"slow_client\":%s,\"msgs\":%" PRIu32 ",\"ring_full_retries\":%" PRIu64 ","
+           "\"received\":%" PRIu64 ",\"msgs_per_sec\":%.0f,\"bytes_per_sec\":%.0f,\"client_msgs_per_sec\":%.0f",
+           nb, slow ? "true" : "false", msgs, retries, rx_msgs, rx_msgs / secs, rx_bytes / secs, rx_msgs / secs / nb);
+
+    if ( slow )
+    {
+        printf(",\"slow_received\":%" PRIu64, __atomic_load_n(&clients[nb].msgs, __ATOMIC_RELAXED) );
+    }
+
+    printf("}\n");
+    fflush(stdout);
+
+    clients_stop(clients, nb + (slow != 0) );
+}
+
+
+
+
+/*
+ *============================================================================
+ * bench_cost
+ *============================================================================
+ */
+static void bench_cost(uint32_t msgs)
+{
+    bench_client    *clients    = clients_start(10, 0, "loglevel info\r\n");
+    uint64_t        retries     = 0;
+    uint64_t        allocs      = 0;
+    uint64_t        frees       = 0;
+    uint64_t        counts[SC_MAX];
+    uint64_t        total       = 0;
+    struct rusage   ru0;
+    struct rusage   ru1;
+
+
+    if ( clients == NULL )
+    {
+        perror("calloc");
+        exit(1);
+    }
+
+    // Only the library is counted: the clients only call recv
+    allocs  = netlogg_allocs();
+    frees   = netlogg_frees();
+
+    for ( int i = 0; i < SC_MAX; i++ )
+    {
+        counts[i] = __atomic_load_n(&sc_counts[i], __ATOMIC_RELAXED);
+    }
+
+    getrusage(RUSAGE_SELF, &ru0);
+
+    produce(msgs, &retries);
+    clients_wait(clients, 10, msgs);
+
+    getrusage(RUSAGE_SELF, &ru1);
+
+    printf("{\"bench\":\"cost\",\"clients\":10,\"msgs\":%" PRIu32 ",\"allocs_per_kmsg\":%.2f,\"frees_per_kmsg\":%.2f",
+           msgs, (netlogg_allocs() - allocs) * 1000.0 / msgs,
+           (netlogg_frees() - frees) * 1000.0 / msgs);
+
+    for ( int i = 0; i < SC_MAX; i++ )
+    {
+        counts[i]   = __atomic_load_n(&sc_counts[i], __ATOMIC_RELAXED) - counts[i];
+        total       += (i != SC_RECV) ? counts[i] : 0;
+
+        if ( i != SC_RECV )
+        {
+            printf(",\"%s_per_kmsg\":%.2f", sc_names[i], counts[i] * 1000.0 / msgs);
+        }
+    }
+
+    printf(",\"syscalls_per_kmsg\":%.2f,\"ctx_switches_per_kmsg\":%.2f}\n", total * 1000.0 / msgs,
+           ( (ru1.ru_nvcsw - ru0.ru_nvcsw) + (ru1.ru_nivcsw - ru0.ru_nivcsw) ) * 1000.0 / msgs);
+    fflush(stdout);
+
+    clients_stop(clients, 10);
+}
+
+
+
+
+/*
+ *============================================================================
+ * main
+ *============================================================================
+ */
+int main(int    argc,
+         char   **argv
+         )
+{
+    pthread_t           th;
+    bench_client        *sink       = NULL;
+    uint32_t            threads     = env_u32("BENCH_THREADS", sysconf(_SC_NPROCESSORS_ONLN) );
+    uint32_t            calls       = env_u32("BENCH_CALLS", CALLS_DFT);
+    uint32_t            msgs        = env_u32("BENCH_MSGS", MSGS_DFT);
+    uint32_t            fanout[]    = {1, 10, 100};
+    Netlogging_args     args        =
+    {
+        .progname   = argv[0],
+        .dft_lvl    = NETLOGG_EMERG,          // Keep the messages away from the syslog and the history
+        .workers    = env_u32("BENCH_WORKERS", 0)
+    };
+
+
+    gPort       = env_u32("BENCH_PORT", PORT_DFT);
+    args.port   = gPort;
+    threads     = (threads < THREADS_MAX) ? threads : THREADS_MAX;
+
+    if ( pthread_create(&th, NULL, netlogg_init, &args) != 0 )
+    {
+        perror("pthread_create");
+
+        return (1);
+    }
+
+    sleep_ms(SETTLE_MS);
+
+    printf("{\"bench\":\"config\",\"threads\":%" PRIu32 ",\"calls\":%" PRIu32 ",\"msgs\":%" PRIu32 ",\"workers\":%" PRIu32 "}\n",
+           threads, calls, msgs, args.workers);
+    bench_timer();
+
+    // A client wants INFO: DEBUG is disabled, INFO is enabled (and drained as fast as possible)
+    sink = clients_start(1, 0, "loglevel info\r\n");
+
+    for ( uint32_t n = 1; ; n = (n * 2 < threads) ? n * 2 : threads )
+    {
+        bench_latency(sink, n, 0, calls);
+        bench_latency(sink, n, 1, calls);
+
+        if ( n == threads )
+        {
+            break;
+        }
+    }
+
+    clients_stop(sink, 1);
+
+    for ( uint32_t i = 0; i < NBELEMS(fanout); i++ )
+    {
+        bench_fanout(fanout[i], 0, msgs);
+        bench_fanout(fanout[i], 1, msgs);
+    }
+
+    bench_cost(msgs);
+
+    return (0);
+}
@@ -0,0 +1,294 @@
+/**
+ * @file netlogg_decode.c
+ * @author hbuyse
+ * @date 16/10/2026
+ *
+ * Print the records kept by a flight recorder file (Netlogging_args.recorder_path)
+ * or written by netlogg_recorder_dump, oldest first.
+ *
+ * The ring is not read from its head (it died with the process): every
+ * published record is found by walking the ring, the space given back to the
+ * producers being zeroed. The file and format pointers of the records are
+ * looked up in the string table written with the ring.
+ */
+
+#include <stdio.h>          // fopen, fread, printf
+#include <stdlib.h>          // malloc, qsort
+#include <string.h>          // memcmp, memchr
+#include <inttypes.h>          // PRIu64, PRId32
+#include <time.h>          // localtime_r, strftime
+
+#include "netlogging.h"          // Netlogging_lvl
+#include "netlogg_ring.h"          // netlogg_record, netlogg_rec_hdr, netlogg_rec_str
+#include "netlogg_fmt.h"          // netlogg_fmt_render
+
+
+#define RING_PAD_BIT          0x80000000u
+
+
+/**
+ * \brief Name of the levels
+ */
+static const char     *lvl_strs[NETLOGG_LVLS] =
+{
+    [NETLOGG_EMERG]     = "EMERG",
+    [NETLOGG_ALERT]     = "ALERT",
+    [NETLOGG_CRIT]      = "CRIT",
+    [NETLOGG_ERROR]     = "ERROR",
+    [NETLOGG_WARN]      = "WARN",
+    [NETLOGG_NOTICE]    = "NOTICE",
+    [NETLOGG_INFO]      = "INFO",
+    [NETLOGG_DEBUG]     = "DEBUG"
+};
+
+
+
+
+/*
+ *============================================================================
+ * read_file
+ *============================================================================
+ */
+static char* read_file(const char   *path,
+                       size_t       *size
+                       )
+{
+    FILE        *f      = NULL;
+    char        *buff   = NULL;
+    long        len     = 0;
+
+
+    f = fopen(path, "rb");
+
+    if ( f == NULL )
+    {
+        perror(path);
+
+        return (NULL);
+    }
+
+    if ( (fseek(f, 0, SEEK_END) == 0) && ( (len = ftell(f) ) > 0) && (fseek(f, 0, SEEK_SET) == 0) )
+    {
+        buff = malloc(len);
+
+        if ( (buff != NULL) && (fread(buff, 1, len, f) != (size_t) len) )
+        {
+            free(buff);
+            buff = NULL;
+        }
+    }
+
+    fclose(f);
+
+    if ( buff == NULL )
+    {
+        fprintf(stderr, "%s: cannot be read\n", path);
+    }
+
+    *size = len;
+
+    return (buff);
+}
+
+
+
+
+/*
+ *============================================================================
+ * lookup
+ *============================================================================
+ */
+static const char* lookup(const char    *strtab,
+                          size_t        len,
+                          uint64_t      ptr
+                          )
+{
+    const netlogg_rec_str     *e    = NULL;
+    size_t                    off   = 0;
+
+
+    while ( off + sizeof(netlogg_rec_str) <= len )
+    {
+        e = (const netlogg_rec_str *) (strtab + off);
+
+        if ( (e->size < sizeof(netlogg_rec_str) + e->len + 1) || (off + e->size > len) )
+        {
+            break;
+        }
+
+        if ( e->ptr == ptr )
+        {
+            return (e->str);
+        }
+
+        off += e->size;
+    }
+
+    return (NULL);
+}
+
+
+
+
+/*
+ *============================================================================
+ * cmp_records
+ *============================================================================
+ */
+static int cmp_records(const void   *a,
+                       const void   *b
+                       )
+{
+    const netlogg_record     *ra    = *(const netlogg_record * const *) a;
+    const netlogg_record     *rb    = *(const netlogg_record * const *) b;
+
+
+    return ( (ra->ts > rb->ts) - (ra->ts < rb->ts) );
+}
+
+
+
+
+/*
+ *============================================================================
+ * print_record
+ *============================================================================
+ */
+static void print_record(const netlogg_record   *rec,
+                         const char             *strtab,
+                         size_t                 strtab_len
+                         )
+{
+    char            date[64];
+    char            msg[BUFF_SIZE_MAX];
+    struct tm       info;
+    time_t          sec     = rec->ts / 1000000000ull;
+    const char      *file   = lookup(strtab, strtab_len, (uintptr_t) rec->file);
+    const char      *format = lookup(strtab, strtab_len, (uintptr_t) rec->format);
+    size_t          flen    = 0;
+
+
+    localtime_r(&sec, &info);
+    strftime(date, sizeof(date), "%b %d %Y %H:%M:%S", &info);
+
+    if ( (rec->format == NULL) && (memchr(rec->payload, '\0', rec->len) != NULL) )
+    {
+        // Rendered by the caller of netlogg_send, after the file name
+        file    = rec->payload;
+        flen    = strlen(file) + 1;
+        snprintf(msg, sizeof(msg), "%.*s", (int) (rec->len - flen), rec->payload + flen);
+    }
+    else if ( format != NULL )
+    {
+        netlogg_fmt_render(msg, sizeof(msg), format, rec->payload, rec->len, rec->err);
+    }
+    else
+    {
+        // Not a NETLOGG call site: only the raw arguments are known
+        snprintf(msg, sizeof(msg), "<unknown format %p, %" PRIu32 " bytes of arguments>", (const void *) rec->format, rec->len);
+    }
+
+    printf("%s.%06" PRIu64 " - %s:%" PRId32 " - %s - %s%s\n", date, (uint64_t) (rec->ts % 1000000000ull) / 1000,
+           (file != NULL) ? file : "?", rec->lineno, lvl_strs[rec->lvl], msg, (rec->fd != -1) ? " (to one client)" : "");
+}
+
+
+
+
+/*
+ *============================================================================
+ * main
+ *============================================================================
+ */
+int main(int    argc,
+         char   **argv
+         )
+{
+    char                    *buff   = NULL;
+    size_t                  size    = 0;
+    const netlogg_rec_hdr   *hdr    = NULL;
+    const char              *ring   = NULL;
+    const char              *strtab = NULL;
+    const netlogg_record    *rec    = NULL;
+    const netlogg_record    **recs  = NULL;
+    size_t                  nb_recs = 0;
+    uint64_t                off     = 0;
+    uint32_t                rsize   = 0;
+
+
+    if ( argc != 2 )
+    {
+        fprintf(stderr, "Usage: %s <recorder file>\n", argv[0]);
+
+        return (1);
+    }
+
+    buff = read_file(argv[1], &size);
+
+    if ( buff == NULL )
+    {
+        return (1);
+    }
+
+    hdr = (const netlogg_rec_hdr *) buff;
+
+    if ( (size < sizeof(*hdr) ) || (memcmp(hdr->magic, NETLOGG_REC_MAGIC, sizeof(NETLOGG_REC_MAGIC) ) != 0) ||
+         (hdr->record_size != sizeof(netlogg_record) ) || (hdr->hdr_size + hdr->ring_size > size) ||
+         (hdr->strtab_off + hdr->strtab_len > size) )
+    {
+        fprintf(stderr, "%s: not a flight recorder file of this architecture\n", argv[1]);
+        free(buff);
+
+        return (1);
+    }
+
+    ring    = buff + hdr->hdr_size;
+    strtab  = buff + hdr->strtab_off;
+    recs    = malloc(hdr->ring_size / sizeof(netlogg_record) * sizeof(*recs) );
+
+    if ( recs == NULL )
+    {
+        perror("malloc");
+        free(buff);
+
+        return (1);
+    }
+
+    // Records are 8 bytes aligned and never split, the space read by the netlogging thread is zeroed
+    while ( off + sizeof(netlogg_record) <= hdr->ring_size )
+    {
+        rec     = (const netlogg_record *) (ring + off);
+        rsize   = rec->size;
+
+        if ( (rsize & RING_PAD_BIT) && ( (rsize & ~RING_PAD_BIT) >= 8) && ( (rsize & ~RING_PAD_BIT) <= hdr->ring_size - off) &&
+             ( (rsize & 7) == 0) )
+        {
+            off += rsize & ~RING_PAD_BIT;
+        }
+        else if ( (rsize >= sizeof(netlogg_record) ) && ( (rsize & 7) == 0) && (rsize <= hdr->ring_size - off) &&
+                  (sizeof(netlogg_record) + rec->len <= rsize) && (rec->lvl < NETLOGG_LVLS) )
+        {
+            recs[nb_recs++] = rec;
+            off             += rsize;
+        }
+        else
+        {
+            // Free space, or a record still being written
+            off += 8;
+        }
+    }
+
+    qsort(recs, nb_recs, sizeof(*recs), cmp_records);
+
+    printf("# %zu records not sent by process %" PRId32 "\n", nb_recs, hdr->pid);
+
+    for ( size_t i = 0; i < nb_recs; i++ )
+    {
+        print_record(recs[i], strtab, hdr->strtab_len);
+    }
+
+    free(recs);
+    free(buff);
+
+    return (0);
+}
@@ -0,0 +1,700 @@
+/**
+ * @file netlogg_file.c
+ * @author hbuyse
+ * @date 16/10/2026
+ *
+ * The netlogging thread copies the messages in the current buffer and hands
+ * the full ones over to the file thread, which writes all the buffers waiting
+ * with one pwritev. A small pool of buffers is shared by both threads: when the
+ * disk does not keep up, the pool is empty and the messages are dropped (and
+ * counted) instead of blocking anybody.
+ *
+ * The file thread is the only one using the file descriptor, so it rotates and
+ * syncs the file between two writes without any other synchronisation. It also
+ * compresses the buffers (one gzip member each) when it is asked to.
+ */
+
+#include <stdio.h>          // snprintf, rename
+#include <inttypes.h>          // PRIu32
+#include <stdlib.h>          // aligned_alloc, strdup
+#include <string.h>          // memcpy
+#include <errno.h>          // errno, EINTR, EBADF
+#include <limits.h>          // PATH_MAX
+#include <fcntl.h>          // open
+#include <unistd.h>          // pwritev, fdatasync, lseek, close
+#include <time.h>          // clock_gettime
+#include <pthread.h>          // pthread_create, pthread_mutex_lock, pthread_cond_timedwait
+#include <sys/uio.h>          // struct iovec, pwritev
+
+#include "netlogg_file.h"
+#include "netlogg_zip.h"          // netlogg_zip_member
+#include "netlogg_stats.h"          // netlogg_stats_add
+
+
+#define FILE_BUFF_SIZE        (1024 * 1024)          // Bytes written at once at least when the disk is late
+#define FILE_BUFF_ALIGN       4096          // Alignment of the buffers (page)
+#define FILE_BUFFS            8          // Buffers shared by the netlogging thread and the file thread
+#define FILE_TICK_MS          1000          // Longest sleep of the file thread (rotation on the time)
+#define FILE_RETRY_MIN_MS     100          // Messages dropped without writing after a write error, doubled by each new error
+#define FILE_RETRY_MAX_MS     10000          // Longest delay between two writes tried after an error
+
+
+/**
+ * \brief Buffer of messages
+ */
+typedef struct {
+    char *data;          ///< The messages (FILE_BUFF_SIZE bytes, aligned)
+    size_t used;          ///< Bytes used
+    uint64_t count;          ///< Number of messages
+} netlogg_file_buff;
+
+
+/**
+ * \brief Parameters of the sink
+ */
+static char     *gFilePath          = NULL;
+static uint64_t     gFileMaxSize    = 0;
+static uint32_t     gFileMaxAge     = 0;
+static uint32_t     gFileKeep       = 0;
+static uint32_t     gFileSyncMs     = 0;
+static int     gFileZip             = 0;
+
+
+/**
+ * \brief Compression context and output buffer of the file thread (gFileZip)
+ */
+static netlogg_zip     file_zip;
+static char     *file_zout          = NULL;
+static size_t     file_zout_size    = 0;
+
+
+/**
+ * \brief File being written (file thread only)
+ */
+static int     file_fd              = -1;
+
+
+/**
+ * \brief Size of the file being written (file thread only)
+ */
+static uint64_t     file_off        = 0;
+
+
+/**
+ * \brief When the file was opened and last synced, in milliseconds (file thread only)
+ */
+static uint64_t     file_opened_ms  = 0;
+static uint64_t     file_synced_ms  = 0;
+
+
+/**
+ * \brief Set when some bytes were written since the last fdatasync (file thread only)
+ */
+static int     file_dirty           = 0;
+
+
+/**
+ * \brief Buffer filled by the netlogging thread (NULL: none)
+ */
+static netlogg_file_buff     *file_cur  = NULL;
+
+
+/**
+ * \brief Buffers of the pool
+ */
+static netlogg_file_buff     file_buffs[FILE_BUFFS];
+
+
+/**
+ * \brief Buffers not used (stack)
+ */
+static netlogg_file_buff     *file_free[FILE_BUFFS];
+static uint32_t     file_nb_free    = 0;
+
+
+/**
+ * \brief Buffers waiting for the file thread (in order)
+ */
+static netlogg_file_buff     *file_pending[FILE_BUFFS];
+static uint32_t     file_nb_pending = 0;
+
+
+/**
+ * \brief Set while the file thread writes
+ */
+static int     file_busy            = 0;
+
+
+/**
+ * \brief Messages dropped since the last report
+ */
+static uint64_t     file_dropped    = 0;
+
+
+/**
+ * \brief errno of the last failed write or open (0: the file is written)
+ */
+static int     file_err             = 0;
+
+
+/**
+ * \brief file_err when the netlogging thread last asked for it (netlogging thread only)
+ */
+static int     file_err_seen        = 0;
+
+
+/**
+ * \brief Delay before the next write tried after an error, and its time in milliseconds (file thread only)
+ */
+static uint64_t     file_backoff_ms = 0;
+static uint64_t     file_retry_ms   = 0;
+
+
+/**
+ * \brief Lock of the pool, the pending buffers, file_busy, file_dropped and file_err
+ */
+static pthread_mutex_t     file_lock    = PTHREAD_MUTEX_INITIALIZER;
+
+
+/**
+ * \brief Signaled when a buffer is pending
+ */
+static pthread_cond_t     file_cond;
+
+
+/**
+ * \brief The file thread
+ */
+static pthread_t     file_thread;
+
+
+
+/**
+ * \brief      Get the time of the monotonic clock in milliseconds
+ *
+ * \return     The time
+ */
+static uint64_t netlogg_file_now_ms(void)
+{
+    struct timespec     now;
+
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return ( (uint64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000);
+}
+
+
+
+/**
+ * \brief      Keep the state of the file after a write or an open (file thread)
+ *
+ * The error is not logged: the message would go to this very file. The
+ * netlogging thread reports the changes (netlogg_file_state), and the writes
+ * are only tried again after a delay growing with the errors.
+ *
+ * \param[in]  err   errno of the failure (0: success)
+ */
+static void netlogg_file_set_err(int err)
+{
+    if ( err == 0 )
+    {
+        file_backoff_ms = 0;
+    }
+    else
+    {
+        file_backoff_ms = (file_backoff_ms == 0) ? FILE_RETRY_MIN_MS : file_backoff_ms * 2;
+        file_backoff_ms = (file_backoff_ms < FILE_RETRY_MAX_MS) ? file_backoff_ms : FILE_RETRY_MAX_MS;
+        file_retry_ms   = netlogg_file_now_ms() + file_backoff_ms;
+    }
+
+    // Only the file thread changes it
+    if ( file_err != err )
+    {
+        pthread_mutex_lock(&file_lock);
+        file_err = err;
+        pthread_mutex_unlock(&file_lock);
+    }
+}
+
+
+
+/**
+ * \brief      Open the file (appended if it exists)
+ *
+ * \return     0 on success, -1 on error
+ */
+static int netlogg_file_open(void)
+{
+    off_t     off = 0;
+
+
+    file_fd = open(gFilePath, O_WRONLY | O_CREAT | O_CLOEXEC, 0640);
+
+    if ( file_fd == -1 )
+    {
+        return (-1);
+    }
+
+    off             = lseek(file_fd, 0, SEEK_END);
+    file_off        = (off > 0) ? off : 0;
+    file_opened_ms  = netlogg_file_now_ms();
+
+    return (0);
+}
+
+
+
+/**
+ * \brief      Rename the file to path.1 (after path.1 to path.2...), then open a new one
+ */
+static void netlogg_file_rotate(void)
+{
+    char     from[PATH_MAX];
+    char     to[PATH_MAX];
+
+
+    if ( file_dirty && (gFileSyncMs != 0) )
+    {
+        fdatasync(file_fd);
+        file_dirty = 0;
+    }
+
+    for ( uint32_t i = gFileKeep; i > 1; i-- )
+    {
+        snprintf(from, sizeof(from), "%s.%" PRIu32, gFilePath, i - 1);
+        snprintf(to, sizeof(to), "%s.%" PRIu32, gFilePath, i);
+        rename(from, to);
+    }
+
+    if ( gFileKeep != 0 )
+    {
+        snprintf(to, sizeof(to), "%s.1", gFilePath);
+        rename(gFilePath, to);
+    }
+    else
+    {
+        unlink(gFilePath);
+    }
+
+    close(file_fd);
+
+    if ( netlogg_file_open() == -1 )
+    {
+        netlogg_file_set_err(errno);
+    }
+}
+
+
+
+/**
+ * \brief      Write at the end of the file (file thread)
+ *
+ * \param      iov     The buffers (modified)
+ * \param[in]  iovcnt  Their number
+ *
+ * \return     The number of buffers entirely written
+ */
+static uint32_t netlogg_file_pwritev(struct iovec   *iov,
+                                     uint32_t       iovcnt
+                                     )
+{
+    struct iovec        *v      = iov;
+    uint32_t            left    = iovcnt;
+    ssize_t             res     = 0;
+
+
+    // Closed by a failed rotation and not opened again
+    if ( file_fd == -1 )
+    {
+        netlogg_file_set_err(EBADF);
+        return (0);
+    }
+
+    while ( left != 0 )
+    {
+        res = pwritev(file_fd, v, left, file_off);
+        netlogg_stats_add(NETLOGG_STAT_SC_PWRITEV, 1);
+
+        if ( res == -1 )
+        {
+            if ( errno == EINTR )
+            {
+                continue;
+            }
+
+            netlogg_file_set_err(errno);
+            break;
+        }
+
+        file_off    += res;
+        file_dirty  = 1;
+        netlogg_file_set_err(0);
+
+        // Skip what was written
+        while ( (left != 0) && ( (size_t) res >= v->iov_len) )
+        {
+            res -= v->iov_len;
+            v++;
+            left--;
+        }
+
+        if ( left != 0 )
+        {
+            v->iov_base = (char *) v->iov_base + res;
+            v->iov_len  -= res;
+        }
+    }
+
+    return (iovcnt - left);
+}
+
+
+
+/**
+ * \brief      Write buffers at the end of the file, compressed if asked (file thread)
+ *
+ * \param      buffs  The buffers
+ * \param[in]  nb     Their number
+ */
+static void netlogg_file_write(netlogg_file_buff    **buffs,
+                               uint32_t             nb
+                               )
+{
+    struct iovec        iov[FILE_BUFFS];
+    struct iovec        in;
+    uint32_t            written = 0;
+    uint64_t            lost    = 0;
+    int                 wait    = (file_backoff_ms != 0) && (netlogg_file_now_ms() < file_retry_ms);
+
+
+    // Opened again after a failed rotation, once the delay after the error is over
+    if ( ! wait && (file_fd == -1) && (netlogg_file_open() == -1) )
+    {
+        netlogg_file_set_err(errno);
+        wait = 1;
+    }
+
+    // Not tried again before the end of the delay after an error
+    if ( wait )
+    {
+        for ( uint32_t i = 0; i < nb; i++ )
+        {
+            lost += buffs[i]->count;
+        }
+    }
+    else if ( ! gFileZip )
+    {
+        for ( uint32_t i = 0; i < nb; i++ )
+        {
+            iov[i].iov_base = buffs[i]->data;
+            iov[i].iov_len  = buffs[i]->used;
+        }
+
+        written = netlogg_file_pwritev(iov, nb);
+
+        // The messages of the buffers not written are lost
+        for ( uint32_t i = written; i < nb; i++ )
+        {
+            lost += buffs[i]->count;
+        }
+    }
+    else
+    {
+        for ( uint32_t i = 0; i < nb; i++ )
+        {
+            in.iov_base     = buffs[i]->data;
+            in.iov_len      = buffs[i]->used;
+            iov[0].iov_base = file_zout;
+            iov[0].iov_len  = netlogg_zip_member(&file_zip, file_zout, file_zout_size, &in, 1);
+
+            if ( (iov[0].iov_len == 0) || (netlogg_file_pwritev(iov, 1) != 1) )
+            {
+                lost += buffs[i]->count;
+            }
+        }
+    }
+
+    if ( lost != 0 )
+    {
+        netlogg_stats_add(NETLOGG_STAT_FILE_DROPS, lost);
+        pthread_mutex_lock(&file_lock);
+        file_dropped += lost;
+        pthread_mutex_unlock(&file_lock);
+    }
+}
+
+
+
+/**
+ * \brief      Write the pending buffers, rotate and sync the file (file thread)
+ *
+ * \param      arg   Not used
+ *
+ * \return     Never returns
+ */
+static void* netlogg_file_run(void *arg)
+{
+    netlogg_file_buff   *buffs[FILE_BUFFS];
+    uint32_t            nb      = 0;
+    uint64_t            now     = 0;
+    struct timespec     until;
+
+
+    for ( ; ; )
+    {
+        pthread_mutex_lock(&file_lock);
+
+        if ( file_nb_pending == 0 )
+        {
+            clock_gettime(CLOCK_MONOTONIC, &until);
+            until.tv_sec    += FILE_TICK_MS / 1000;
+            pthread_cond_timedwait(&file_cond, &file_lock, &until);
+        }
+
+        nb              = file_nb_pending;
+        file_nb_pending = 0;
+        file_busy       = (nb != 0);
+        memcpy(buffs, file_pending, nb * sizeof(*buffs) );
+
+        pthread_mutex_unlock(&file_lock);
+
+        if ( nb != 0 )
+        {
+            netlogg_file_write(buffs, nb);
+
+            pthread_mutex_lock(&file_lock);
+
+            for ( uint32_t i = 0; i < nb; i++ )
+            {
+                buffs[i]->used                  = 0;
+                buffs[i]->count                 = 0;
+                file_free[file_nb_free++]       = buffs[i];
+            }
+
+            file_busy = 0;
+
+            pthread_mutex_unlock(&file_lock);
+        }
+
+        now = netlogg_file_now_ms();
+
+        if ( file_fd == -1 )
+        {
+            // The last rotation failed: try again at the next tick without messages, after the delay
+            if ( (nb == 0) && (now >= file_retry_ms) && (netlogg_file_open() == -1) )
+            {
+                netlogg_file_set_err(errno);
+                continue;
+            }
+        }
+        else if ( ( (gFileMaxSize != 0) && (file_off >= gFileMaxSize) ) ||
+                  ( (gFileMaxAge != 0) && (file_off != 0) && (now - file_opened_ms >= (uint64_t) gFileMaxAge * 1000) ) )
+        {
+            netlogg_file_rotate();
+        }
+        else if ( file_dirty && (gFileSyncMs != 0) && (now - file_synced_ms >= gFileSyncMs) )
+        {
+            fdatasync(file_fd);
+            file_dirty      = 0;
+            file_synced_ms  = now;
+        }
+    }
+
+    return (NULL);
+}
+
+
+
+/**
+ * \brief      Give the current buffer to the file thread (file_lock held)
+ */
+static void netlogg_file_submit(void)
+{
+    file_pending[file_nb_pending++] = file_cur;
+    file_cur                        = NULL;
+
+    pthread_cond_signal(&file_cond);
+}
+
+
+
+int netlogg_file_init(const char    *path,
+                      uint64_t      max_size,
+                      uint32_t      max_age,
+                      uint32_t      keep,
+                      uint32_t      sync_ms,
+                      int           compress
+                      )
+{
+    pthread_condattr_t     attr;
+
+
+    gFilePath       = strdup(path);
+    gFileMaxSize    = max_size;
+    gFileMaxAge     = max_age;
+    gFileKeep       = keep;
+    gFileSyncMs     = sync_ms;
+    gFileZip        = compress;
+
+    if ( (gFilePath == NULL) || (netlogg_file_open() == -1) )
+    {
+        return (-1);
+    }
+
+    if ( gFileZip )
+    {
+        if ( netlogg_zip_init(&file_zip) == -1 )
+        {
+            errno = ENOMEM;
+
+            return (-1);
+        }
+
+        file_zout_size  = netlogg_zip_bound(&file_zip, FILE_BUFF_SIZE);
+        file_zout       = malloc(file_zout_size);
+
+        if ( file_zout == NULL )
+        {
+            return (-1);
+        }
+    }
+
+    for ( uint32_t i = 0; i < FILE_BUFFS; i++ )
+    {
+        file_buffs[i].data = aligned_alloc(FILE_BUFF_ALIGN, FILE_BUFF_SIZE);
+
+        if ( file_buffs[i].data == NULL )
+        {
+            return (-1);
+        }
+
+        file_free[file_nb_free++] = &file_buffs[i];
+    }
+
+    // The file thread sleeps on the monotonic clock
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&file_cond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    file_synced_ms = netlogg_file_now_ms();
+
+    errno = pthread_create(&file_thread, NULL, netlogg_file_run, NULL);
+
+    return ( (errno == 0) ? 0 : -1);
+}
+
+
+
+void netlogg_file_add(const char    *buff,
+                      size_t        len
+                      )
+{
+    if ( (file_cur != NULL) && (file_cur->used + len > FILE_BUFF_SIZE) )
+    {
+        pthread_mutex_lock(&file_lock);
+        netlogg_file_submit();
+        pthread_mutex_unlock(&file_lock);
+    }
+
+    if ( file_cur == NULL )
+    {
+        pthread_mutex_lock(&file_lock);
+
+        if ( file_nb_free != 0 )
+        {
+            file_cur = file_free[--file_nb_free];
+        }
+        else
+        {
+            // All the buffers wait for the disk
+            file_dropped++;
+            netlogg_stats_add(NETLOGG_STAT_FILE_DROPS, 1);
+        }
+
+        pthread_mutex_unlock(&file_lock);
+
+        if ( file_cur == NULL )
+        {
+            return;
+        }
+    }
+
+    memcpy(file_cur->data + file_cur->used, buff, len);
+    file_cur->used  += len;
+    file_cur->count++;
+}
+
+
+
+void netlogg_file_flush(void)
+{
+    if ( (file_cur == NULL) || (file_cur->used == 0) )
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&file_lock);
+
+    // When the file thread is writing, the messages wait for the next buffer to be full
+    if ( ! file_busy && (file_nb_pending == 0) )
+    {
+        netlogg_file_submit();
+    }
+
+    pthread_mutex_unlock(&file_lock);
+}
+
+
+
+int netlogg_file_waiting(void)
+{
+    return ( (file_cur != NULL) && (file_cur->used != 0) );
+}
+
+
+
+uint64_t netlogg_file_dropped(void)
+{
+    uint64_t     dropped = 0;
+
+
+    pthread_mutex_lock(&file_lock);
+
+    // Not while all the buffers wait for the disk or while it fails: the report would be dropped too
+    if ( ( (file_cur != NULL) || (file_nb_free != 0) ) && (file_err == 0) )
+    {
+        dropped         = file_dropped;
+        file_dropped    = 0;
+    }
+
+    pthread_mutex_unlock(&file_lock);
+
+    return (dropped);
+}
+
+
+
+int netlogg_file_state(int *err)
+{
+    pthread_mutex_lock(&file_lock);
+    *err = file_err;
+    pthread_mutex_unlock(&file_lock);
+
+    if ( *err == file_err_seen )
+    {
+        return (0);
+    }
+
+    file_err_seen = *err;
+
+    return (1);
+}
+
+
+
+const char* netlogg_file_path(void)
+{
+    return (gFilePath);
+}
@@ -0,0 +1,108 @@
+/**
+ * @file netlogg_file.h
+ * @author hbuyse
+ * @date 16/10/2026
+ *
+ * File sink of the netlogging thread: the rendered messages are appended to
+ * large aligned buffers, written by a dedicated thread with pwritev. The same
+ * thread rotates the file and syncs it, so the disk never slows down the
+ * netlogging thread nor the producers.
+ */
+
+
+#ifndef __NETLOGG_FILE_H__
+#define __NETLOGG_FILE_H__
+
+#include <stdint.h>          // uint32_t, uint64_t
+#include <stddef.h>          // size_t
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * \brief Delay after which the netlogging thread tries again to flush the messages waiting (milliseconds)
+ */
+#define NETLOGG_FILE_FLUSH_MS   10
+
+
+/**
+ * \brief      Open the file and start the thread writing it
+ *
+ * \param[in]  path      The file (the rotated ones are path.1, path.2...)
+ * \param[in]  max_size  Size of the file that triggers a rotation (0: no rotation on the size)
+ * \param[in]  max_age   Seconds after which the file is rotated (0: no rotation on the time)
+ * \param[in]  keep      Number of rotated files kept
+ * \param[in]  sync_ms   Interval between two fdatasync in milliseconds (0: never synced)
+ * \param[in]  compress  Write the file compressed with gzip (one member per buffer)
+ *
+ * \return     0 on success, -1 on error (errno is set)
+ */
+int netlogg_file_init(const char *path, uint64_t max_size, uint32_t max_age, uint32_t keep, uint32_t sync_ms,
+                      int compress);
+
+
+/**
+ * \brief      Append a message to the current buffer (netlogging thread)
+ *
+ * The message is dropped if all the buffers wait for the disk.
+ *
+ * \param[in]  buff  The message
+ * \param[in]  len   Its length
+ */
+void netlogg_file_add(const char *buff, size_t len);
+
+
+/**
+ * \brief      Give the current buffer to the writing thread if it has nothing to do (netlogging thread)
+ *
+ * When the disk keeps up, the messages are written as soon as possible, and
+ * when it does not, they are written by large buffers.
+ */
+void netlogg_file_flush(void);
+
+
+/**
+ * \brief      Tell if some messages of the current buffer wait for netlogg_file_flush (netlogging thread)
+ *
+ * \return     1 if some messages wait, 0 otherwise
+ */
+int netlogg_file_waiting(void);
+
+
+/**
+ * \brief      Get and reset the number of messages dropped because the disk did not keep up or failed
+ *
+ * Nothing is returned while all the buffers wait for the disk or while the
+ * writes fail (netlogging thread). The messages are counted in
+ * NETLOGG_STAT_FILE_DROPS as soon as they are dropped.
+ *
+ * \return     Number of dropped messages since the last call
+ */
+uint64_t netlogg_file_dropped(void);
+
+
+/**
+ * \brief      Tell if the writes of the file started or stopped failing since the last call (netlogging thread)
+ *
+ * \param      err   errno of the last failed write or open (0: the file is written again)
+ *
+ * \return     1 if the state changed, 0 otherwise
+ */
+int netlogg_file_state(int *err);
+
+
+/**
+ * \brief      Get the path of the file
+ *
+ * \return     The path given to netlogg_file_init
+ */
+const char* netlogg_file_path(void);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif          // __NETLOGG_FILE_H__
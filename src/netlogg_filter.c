@@ -0,0 +1,311 @@
+/**
+ * @file netlogg_filter.c
+ * @author hbuyse
+ * @date 16/10/2026
+ *
+ * The filters are created and released by the workers (commands of the
+ * clients) and evaluated by the netlogging thread without lock: a filter is
+ * published in the mask of the live filters once compiled, and a released
+ * one is only freed by the netlogging thread itself, between two messages.
+ *
+ * The substrings are searched with memmem, vectorized by the libc; the
+ * regular expressions are POSIX extended ones, matched in place thanks to
+ * REG_STARTEND.
+ */
+
+#include <stdio.h>          // snprintf
+#include <stdlib.h>          // free
+#include <string.h>          // memmem, strcmp, strdup
+#include <regex.h>          // regcomp, regexec, regfree
+#include <pthread.h>          // pthread_mutex_lock
+
+#include "netlogg_filter.h"
+
+
+/**
+ * \brief State of a filter slot
+ */
+typedef enum {
+    FILTER_FREE = 0,          ///< Unused
+    FILTER_LIVE,          ///< Used by some clients, evaluated by the netlogging thread
+    FILTER_DEAD          ///< Released, freed by the netlogging thread before the next messages
+} netlogg_filter_state;
+
+
+/**
+ * \brief Kind of filter
+ */
+typedef enum {
+    FILTER_FILE = 0,          ///< The file of the message is the argument (or ends with /argument)
+    FILTER_MATCH,          ///< The message contains the argument
+    FILTER_REGEX          ///< The message matches the argument
+} netlogg_filter_type;
+
+
+/**
+ * \brief A filter and the clients using it
+ */
+typedef struct {
+    netlogg_filter_state state;          ///< State of the slot (filters_lock)
+    netlogg_filter_type type;          ///< Kind of filter
+    uint32_t refs;          ///< Clients using the filter (filters_lock)
+    char *spec;          ///< The filter as given by the client
+    const char *arg;          ///< Argument of the filter (in spec)
+    size_t arg_len;          ///< Its length
+    regex_t re;          ///< Compiled regular expression (FILTER_REGEX)
+    const char *last_file;          ///< Last file evaluated by a FILTER_FILE (netlogging thread)
+    int last_res;          ///< Result for last_file
+} netlogg_filter;
+
+
+/**
+ * \brief Filter slots (the index is the id)
+ */
+static netlogg_filter     filters[NETLOGG_FILTERS_MAX];
+
+
+/**
+ * \brief Mask of the FILTER_LIVE slots (atomic)
+ */
+static uint64_t     filters_live    = 0;
+
+
+/**
+ * \brief Set when some slots are FILTER_DEAD (atomic)
+ */
+static int     filters_dead         = 0;
+
+
+/**
+ * \brief Next slot tried for a new filter (filters_lock)
+ *
+ * The slots are taken in turn: a batch published before a slot was freed
+ * still has the bit of its old filter, it should not be seen by a new one.
+ */
+static int     filters_next         = 0;
+
+
+/**
+ * \brief Serializes the changes of the slots
+ */
+static pthread_mutex_t     filters_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+
+int netlogg_filter_get(const char   *spec,
+                       char         *err,
+                       size_t       errlen
+                       )
+{
+    netlogg_filter      *f      = NULL;
+    int                 id      = -1;
+    int                 res     = 0;
+    int                 slot    = 0;
+
+
+    pthread_mutex_lock(&filters_lock);
+
+    // Shared with the clients already using the same filter
+    for ( int i = 0; i < NETLOGG_FILTERS_MAX; i++ )
+    {
+        if ( (filters[i].state == FILTER_LIVE) && (strcmp(filters[i].spec, spec) == 0) )
+        {
+            filters[i].refs++;
+            pthread_mutex_unlock(&filters_lock);
+
+            return (i);
+        }
+    }
+
+    for ( int i = 0; (i < NETLOGG_FILTERS_MAX) && (id == -1); i++ )
+    {
+        slot    = (filters_next + i) % NETLOGG_FILTERS_MAX;
+        id      = (filters[slot].state == FILTER_FREE) ? slot : -1;
+    }
+
+    if ( id == -1 )
+    {
+        pthread_mutex_unlock(&filters_lock);
+        snprintf(err, errlen, "too many different filters (%d)", NETLOGG_FILTERS_MAX);
+
+        return (-1);
+    }
+
+    f           = &filters[id];
+    f->spec     = strdup(spec);
+
+    if ( f->spec == NULL )
+    {
+        pthread_mutex_unlock(&filters_lock);
+        snprintf(err, errlen, "out of memory");
+
+        return (-1);
+    }
+
+    f->arg          = strchr(f->spec, '=') + 1;
+    f->arg_len      = strlen(f->arg);
+    f->last_file    = NULL;
+    f->type         = (strncmp(spec, "file=", 5) == 0) ? FILTER_FILE : (strncmp(spec, "match=", 6) == 0) ? FILTER_MATCH : FILTER_REGEX;
+
+    if ( f->type == FILTER_REGEX )
+    {
+        res = regcomp(&f->re, f->arg, REG_EXTENDED | REG_NOSUB);
+
+        if ( res != 0 )
+        {
+            regerror(res, &f->re, err, errlen);
+            free(f->spec);
+            f->spec = NULL;
+            pthread_mutex_unlock(&filters_lock);
+
+            return (-1);
+        }
+    }
+
+    f->refs         = 1;
+    f->state        = FILTER_LIVE;
+    filters_next    = (id + 1) % NETLOGG_FILTERS_MAX;
+
+    // Published once complete
+    __atomic_or_fetch(&filters_live, 1ull << id, __ATOMIC_RELEASE);
+
+    pthread_mutex_unlock(&filters_lock);
+
+    return (id);
+}
+
+
+
+void netlogg_filter_put(int id)
+{
+    pthread_mutex_lock(&filters_lock);
+
+    if ( --filters[id].refs == 0 )
+    {
+        // The netlogging thread may be evaluating it: it frees it itself
+        filters[id].state = FILTER_DEAD;
+        __atomic_and_fetch(&filters_live, ~(1ull << id), __ATOMIC_RELEASE);
+        __atomic_store_n(&filters_dead, 1, __ATOMIC_RELEASE);
+    }
+
+    pthread_mutex_unlock(&filters_lock);
+}
+
+
+
+const char* netlogg_filter_spec(int id)
+{
+    return (filters[id].spec);
+}
+
+
+
+int netlogg_filter_active(void)
+{
+    if ( __atomic_load_n(&filters_dead, __ATOMIC_ACQUIRE) )
+    {
+        pthread_mutex_lock(&filters_lock);
+
+        for ( int i = 0; i < NETLOGG_FILTERS_MAX; i++ )
+        {
+            if ( filters[i].state != FILTER_DEAD )
+            {
+                continue;
+            }
+
+            if ( filters[i].type == FILTER_REGEX )
+            {
+                regfree(&filters[i].re);
+            }
+
+            free(filters[i].spec);
+            filters[i].spec     = NULL;
+            filters[i].state    = FILTER_FREE;
+        }
+
+        __atomic_store_n(&filters_dead, 0, __ATOMIC_RELAXED);
+        pthread_mutex_unlock(&filters_lock);
+    }
+
+    return (__atomic_load_n(&filters_live, __ATOMIC_ACQUIRE) != 0);
+}
+
+
+
+/**
+ * \brief      Tell if a file is the one of a FILTER_FILE
+ *
+ * \param[in]  f     The filter
+ * \param[in]  file  The file of the message
+ *
+ * \return     1 if it is, 0 otherwise
+ */
+static int netlogg_filter_file(const netlogg_filter     *f,
+                               const char               *file
+                               )
+{
+    size_t     len = strlen(file);
+
+
+    if ( len < f->arg_len )
+    {
+        return (0);
+    }
+
+    return ( (memcmp(file + len - f->arg_len, f->arg, f->arg_len) == 0) && ( (len == f->arg_len) || (file[len - f->arg_len - 1] == '/') ) );
+}
+
+
+
+uint64_t netlogg_filter_match(const char    *file,
+                              const char    *msg,
+                              size_t        len
+                              )
+{
+    uint64_t        live    = __atomic_load_n(&filters_live, __ATOMIC_ACQUIRE);
+    uint64_t        mask    = 0;
+    netlogg_filter  *f      = NULL;
+    regmatch_t      pm;
+    int             id      = 0;
+
+
+    while ( live != 0 )
+    {
+        id      = __builtin_ctzll(live);
+        live    &= live - 1;
+        f       = &filters[id];
+
+        switch ( f->type )
+        {
+            case FILTER_FILE:
+            {
+                // The messages of a file are often next to each other
+                if ( file != f->last_file )
+                {
+                    f->last_file    = file;
+                    f->last_res     = netlogg_filter_file(f, file);
+                }
+
+                mask |= (uint64_t) f->last_res << id;
+                break;
+            }
+
+            case FILTER_MATCH:
+            {
+                mask |= (uint64_t) (memmem(msg, len, f->arg, f->arg_len) != NULL) << id;
+                break;
+            }
+
+            case FILTER_REGEX:
+            {
+                // The message is not nul terminated: its bounds are given in pm
+                pm.rm_so    = 0;
+                pm.rm_eo    = len;
+                mask        |= (uint64_t) (regexec(&f->re, msg, 1, &pm, REG_STARTEND) == 0) << id;
+                break;
+            }
+        }
+    }
+
+    return (mask);
+}
@@ -0,0 +1,86 @@
+/**
+ * @file netlogg_filter.h
+ * @author hbuyse
+ * @date 16/10/2026
+ *
+ * Content filters of the clients (filter file=, filter match=, filter regex=).
+ * The filters are compiled once and shared by the clients asking for the same
+ * one: the netlogging thread evaluates each distinct filter once per message
+ * and gives the messages a mask of the filters they match.
+ */
+
+
+#ifndef __NETLOGG_FILTER_H__
+#define __NETLOGG_FILTER_H__
+
+#include <stdint.h>          // uint64_t
+#include <stddef.h>          // size_t
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * \brief Number of distinct filters at once (one bit each in the mask of a message)
+ */
+#define NETLOGG_FILTERS_MAX     64
+
+
+/**
+ * \brief      Get a filter, compiled only if no client uses it yet
+ *
+ * \param[in]  spec    The filter: "file=<name>", "match=<substring>" or "regex=<extended regex>"
+ * \param      err     Why the filter was refused
+ * \param[in]  errlen  Size of err
+ *
+ * \return     The id of the filter (its bit in the masks), -1 on error
+ */
+int netlogg_filter_get(const char *spec, char *err, size_t errlen);
+
+
+/**
+ * \brief      Release a filter got by netlogg_filter_get
+ *
+ * \param[in]  id    The filter
+ */
+void netlogg_filter_put(int id);
+
+
+/**
+ * \brief      Get the text of a filter
+ *
+ * \param[in]  id    The filter
+ *
+ * \return     The filter as given to netlogg_filter_get
+ */
+const char* netlogg_filter_spec(int id);
+
+
+/**
+ * \brief      Tell if some filters are used (netlogging thread)
+ *
+ * The filters released since the last call are freed.
+ *
+ * \return     1 if netlogg_filter_match has to be called for the messages, 0 otherwise
+ */
+int netlogg_filter_active(void);
+
+
+/**
+ * \brief      Evaluate the filters in use on a message (netlogging thread)
+ *
+ * \param[in]  file  The file of the message
+ * \param[in]  msg   The text of the message (not nul terminated)
+ * \param[in]  len   Its length
+ *
+ * \return     The mask of the filters matched (bit id)
+ */
+uint64_t netlogg_filter_match(const char *file, const char *msg, size_t len);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif          // __NETLOGG_FILTER_H__
@@ -0,0 +1,662 @@
+/**
+ * @file netlogg_fmt.c
+ * @author hbuyse
+ * @date 16/10/2026
+ *
+ * The arguments are stored one after the other, each one aligned on 8 bytes:
+ * the integers (and the '*' width/precision) as 64 bits values, the floating
+ * point values as double or long double, the strings as a 32 bits length
+ * followed by the characters and a final nul character.
+ */
+
+#include <stdint.h>          // int64_t, uint32_t
+#include <stdio.h>          // snprintf
+#include <string.h>          // memcpy, strnlen, strerror_r
+#include <wchar.h>          // wchar_t, wint_t, wcsnlen
+
+#include "netlogg_fmt.h"
+
+
+#define FMT_ALIGN(s)          ( ( (s) + 7) & ~( (size_t) 7) )
+#define FMT_SPEC_MAX          64
+#define FMT_NULL_STR          0xFFFFFFFFu
+
+
+/**
+ * \brief Kind of argument expected by a conversion specification
+ */
+typedef enum {
+    ARG_NONE = 0,          ///< No argument (unknown conversion, printed as is)
+    ARG_PERCENT,          ///< %%
+    ARG_ERRNO,          ///< %m
+    ARG_SKIP,          ///< %n (the pointer is consumed but nothing is written)
+    ARG_INT,          ///< int (and the promoted char/short)
+    ARG_LONG,          ///< long
+    ARG_LLONG,          ///< long long
+    ARG_INTMAX,          ///< intmax_t
+    ARG_SIZE,          ///< size_t
+    ARG_PTRDIFF,          ///< ptrdiff_t
+    ARG_WINT,          ///< wint_t
+    ARG_DOUBLE,          ///< double
+    ARG_LDOUBLE,          ///< long double
+    ARG_PTR,          ///< void *
+    ARG_STR,          ///< char *
+    ARG_WSTR,          ///< wchar_t *
+    ARG_POSITIONAL          ///< %n$ (not supported)
+} fmt_arg_t;
+
+
+/**
+ * \brief Conversion specification found in a format
+ */
+typedef struct {
+    size_t len;          ///< Length of the specification ('%' included)
+    int nb_stars;          ///< Number of '*' (width and/or precision given as arguments)
+    int prec_star;          ///< Tells if the precision is given as an argument
+    long prec;          ///< Precision (-1 if none)
+    fmt_arg_t type;          ///< Kind of argument
+} fmt_spec;
+
+
+/**
+ * \brief      Parse the conversion specification starting at f (f[0] == '%')
+ *
+ * \param[in]  f     The specification
+ * \param      spec  The parsed specification
+ */
+static void fmt_parse(const char    *f,
+                      fmt_spec      *spec
+                      )
+{
+    const char     *p   = f + 1;
+    int            lng  = 0;          // number of 'l'
+    char           mod  = 0;          // other length modifier
+
+
+    spec->nb_stars  = 0;
+    spec->prec_star = 0;
+    spec->prec      = -1;
+    spec->type      = ARG_NONE;
+
+    // Positional arguments (%1$d) cannot be read in order
+    if ( (*p >= '1') && (*p <= '9') )
+    {
+        const char     *q = p;
+
+
+        while ( (*q >= '0') && (*q <= '9') )
+        {
+            q++;
+        }
+
+        if ( *q == '$' )
+        {
+            spec->len   = q + 1 - f;
+            spec->type  = ARG_POSITIONAL;
+
+            return;
+        }
+    }
+
+    // Flags
+    while ( (*p != '\0') && (strchr("-+ #0'I", *p) != NULL) )
+    {
+        p++;
+    }
+
+    // Width
+    if ( *p == '*' )
+    {
+        spec->nb_stars++;
+        p++;
+    }
+    else
+    {
+        while ( (*p >= '0') && (*p <= '9') )
+        {
+            p++;
+        }
+    }
+
+    // Precision
+    if ( *p == '.' )
+    {
+        p++;
+        spec->prec = 0;
+
+        if ( *p == '*' )
+        {
+            spec->nb_stars++;
+            spec->prec_star = 1;
+            p++;
+        }
+        else
+        {
+            while ( (*p >= '0') && (*p <= '9') )
+            {
+                spec->prec = spec->prec * 10 + (*p - '0');
+                p++;
+            }
+        }
+    }
+
+    // Length modifier
+    for ( ; ; )
+    {
+        if ( *p == 'l' )
+        {
+            lng++;
+        }
+        else if ( (*p == 'h') || (*p == 'q') || (*p == 'L') || (*p == 'j') || (*p == 'z') || (*p == 'Z') || (*p == 't') )
+        {
+            mod = *p;
+        }
+        else
+        {
+            break;
+        }
+
+        p++;
+    }
+
+    // Conversion
+    switch ( *p )
+    {
+        case 'd':
+        case 'i':
+        case 'o':
+        case 'u':
+        case 'x':
+        case 'X':
+            if ( (lng >= 2) || (mod == 'q') || (mod == 'L') )
+            {
+                spec->type = ARG_LLONG;
+            }
+            else if ( lng == 1 )
+            {
+                spec->type = ARG_LONG;
+            }
+            else if ( mod == 'j' )
+            {
+                spec->type = ARG_INTMAX;
+            }
+            else if ( (mod == 'z') || (mod == 'Z') )
+            {
+                spec->type = ARG_SIZE;
+            }
+            else if ( mod == 't' )
+            {
+                spec->type = ARG_PTRDIFF;
+            }
+            else
+            {
+                spec->type = ARG_INT;
+            }
+
+            break;
+
+        case 'e':
+        case 'E':
+        case 'f':
+        case 'F':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+            spec->type = (mod == 'L') ? ARG_LDOUBLE : ARG_DOUBLE;
+            break;
+
+        case 'c':
+            spec->type = (lng != 0) ? ARG_WINT : ARG_INT;
+            break;
+
+        case 'C':
+            spec->type = ARG_WINT;
+            break;
+
+        case 's':
+            spec->type = (lng != 0) ? ARG_WSTR : ARG_STR;
+            break;
+
+        case 'S':
+            spec->type = ARG_WSTR;
+            break;
+
+        case 'p':
+            spec->type = ARG_PTR;
+            break;
+
+        case 'n':
+            spec->type = ARG_SKIP;
+            break;
+
+        case 'm':
+            spec->type = ARG_ERRNO;
+            break;
+
+        case '%':
+            spec->type = ARG_PERCENT;
+            break;
+
+        default:
+            // Unknown conversion (or end of the format): printed as is
+            spec->len = p - f;
+
+            return;
+    }
+
+    spec->len = p + 1 - f;
+}
+
+
+
+/**
+ * \brief      Size taken in the arguments buffer by a fixed size argument
+ *
+ * \param[in]  type  The kind of argument
+ *
+ * \return     The size (0 for the strings and the conversions without argument)
+ */
+static size_t fmt_arg_size(fmt_arg_t type)
+{
+    switch ( type )
+    {
+        case ARG_INT:
+        case ARG_LONG:
+        case ARG_LLONG:
+        case ARG_INTMAX:
+        case ARG_SIZE:
+        case ARG_PTRDIFF:
+        case ARG_WINT:
+        case ARG_PTR:
+            return (sizeof(int64_t) );
+
+        case ARG_DOUBLE:
+            return (FMT_ALIGN(sizeof(double) ) );
+
+        case ARG_LDOUBLE:
+            return (FMT_ALIGN(sizeof(long double) ) );
+
+        default:
+            return (0);
+    }
+}
+
+
+
+size_t netlogg_fmt_capture(char         *args,
+                           size_t       size,
+                           const char   *format,
+                           va_list      ap
+                           )
+{
+    size_t      w       = 0;
+    fmt_spec    spec;
+    const char  *f      = format;
+    int64_t     v       = 0;
+    int         i       = 0;
+    long        prec    = -1;
+
+
+    while ( (f = strchr(f, '%') ) != NULL )
+    {
+        fmt_parse(f, &spec);
+        f += spec.len;
+
+        if ( spec.type == ARG_POSITIONAL )
+        {
+            break;
+        }
+
+        if ( (spec.type == ARG_NONE) || (spec.type == ARG_PERCENT) || (spec.type == ARG_ERRNO) )
+        {
+            continue;
+        }
+
+        if ( spec.type == ARG_SKIP )
+        {
+            (void) va_arg(ap, void *);
+            continue;
+        }
+
+        // Width and precision given as arguments
+        if ( w + spec.nb_stars * sizeof(int64_t) + fmt_arg_size(spec.type) > size )
+        {
+            break;
+        }
+
+        prec = spec.prec;
+
+        for ( i = 0; i < spec.nb_stars; i++ )
+        {
+            v = va_arg(ap, int);
+            memcpy(args + w, &v, sizeof(v) );
+            w += sizeof(v);
+            prec = v;
+        }
+
+        if ( ! spec.prec_star )
+        {
+            prec = spec.prec;
+        }
+
+        switch ( spec.type )
+        {
+            case ARG_INT:
+                v = va_arg(ap, int);
+                break;
+
+            case ARG_LONG:
+                v = va_arg(ap, long);
+                break;
+
+            case ARG_LLONG:
+                v = va_arg(ap, long long);
+                break;
+
+            case ARG_INTMAX:
+                v = va_arg(ap, intmax_t);
+                break;
+
+            case ARG_SIZE:
+                v = va_arg(ap, size_t);
+                break;
+
+            case ARG_PTRDIFF:
+                v = va_arg(ap, ptrdiff_t);
+                break;
+
+            case ARG_WINT:
+                v = va_arg(ap, wint_t);
+                break;
+
+            case ARG_PTR:
+                v = (intptr_t) va_arg(ap, void *);
+                break;
+
+            case ARG_DOUBLE:
+            {
+                double     d = va_arg(ap, double);
+
+
+                memcpy(args + w, &d, sizeof(d) );
+                w += fmt_arg_size(spec.type);
+                continue;
+            }
+
+            case ARG_LDOUBLE:
+            {
+                long double     d = va_arg(ap, long double);
+
+
+                memcpy(args + w, &d, sizeof(d) );
+                w += fmt_arg_size(spec.type);
+                continue;
+            }
+
+            case ARG_STR:
+            {
+                const char     *s   = va_arg(ap, const char *);
+                uint32_t       l    = FMT_NULL_STR;
+                size_t         max  = 0;
+
+
+                if ( w + sizeof(uint32_t) + 1 > size )
+                {
+                    return (w);
+                }
+
+                // Never read past the precision (the string may not be nul terminated)
+                max = size - w - sizeof(uint32_t) - 1;
+                max = ( (prec >= 0) && ( (size_t) prec < max) ) ? (size_t) prec : max;
+
+                if ( s != NULL )
+                {
+                    l = strnlen(s, max);
+                    memcpy(args + w + sizeof(uint32_t), s, l);
+                    args[w + sizeof(uint32_t) + l] = '\0';
+                }
+
+                memcpy(args + w, &l, sizeof(l) );
+                w += FMT_ALIGN(sizeof(uint32_t) + ( (s != NULL) ? l + 1 : 0) );
+                w = (w < size) ? w : size;
+                continue;
+            }
+
+            case ARG_WSTR:
+            {
+                const wchar_t     *s    = va_arg(ap, const wchar_t *);
+                uint32_t          l     = FMT_NULL_STR;
+                size_t            max   = 0;
+                size_t            off   = FMT_ALIGN(w + sizeof(uint32_t) );
+
+
+                if ( off + sizeof(wchar_t) > size )
+                {
+                    return (w);
+                }
+
+                max = (size - off) / sizeof(wchar_t) - 1;
+                max = ( (prec >= 0) && ( (size_t) prec < max) ) ? (size_t) prec : max;
+
+                if ( s != NULL )
+                {
+                    wchar_t     nul = L'\0';
+
+
+                    l = wcsnlen(s, max);
+                    memcpy(args + off, s, l * sizeof(wchar_t) );
+                    memcpy(args + off + l * sizeof(wchar_t), &nul, sizeof(nul) );
+                }
+
+                memcpy(args + w, &l, sizeof(l) );
+                w = FMT_ALIGN(off + ( (s != NULL) ? (l + 1) * sizeof(wchar_t) : 0) );
+                w = (w < size) ? w : size;
+                continue;
+            }
+
+            default:
+                continue;
+        }
+
+        memcpy(args + w, &v, sizeof(v) );
+        w += sizeof(v);
+    }
+
+    return (w);
+}
+
+
+
+size_t netlogg_fmt_render(char          *buff,
+                          size_t        size,
+                          const char    *format,
+                          const char    *args,
+                          size_t        len,
+                          int           err
+                          )
+{
+    size_t      w       = 0;
+    size_t      r       = 0;
+    size_t      l       = 0;
+    int         n       = 0;
+    int         i       = 0;
+    int         stars[2] = {0, 0};
+    int64_t     v       = 0;
+    fmt_spec    spec;
+    const char  *f      = format;
+    const char  *pct    = NULL;
+    char        conv[FMT_SPEC_MAX];
+    char        errbuf[128];
+
+// Call snprintf with the width/precision given as arguments
+#define FMT_PRINT(value) \
+    ( (spec.nb_stars == 0) ? snprintf(buff + w, size - w, conv, value) : \
+      (spec.nb_stars == 1) ? snprintf(buff + w, size - w, conv, stars[0], value) : \
+                             snprintf(buff + w, size - w, conv, stars[0], stars[1], value) )
+
+
+    if ( size == 0 )
+    {
+        return (0);
+    }
+
+    buff[0] = '\0';
+
+    while ( w < size - 1 )
+    {
+        // Copy the text up to the next conversion
+        pct = strchrnul(f, '%');
+        l   = pct - f;
+        l   = (l < size - 1 - w) ? l : size - 1 - w;
+        memcpy(buff + w, f, l);
+        w   += l;
+        buff[w] = '\0';
+
+        if ( (*pct == '\0') || (w >= size - 1) )
+        {
+            break;
+        }
+
+        fmt_parse(pct, &spec);
+        f = pct + spec.len;
+        n = 0;
+
+        if ( (spec.type == ARG_NONE) || (spec.type == ARG_POSITIONAL) || (spec.len >= sizeof(conv) ) )
+        {
+            // Not rendered: printed as is (everything left for the positional arguments)
+            l = (spec.type == ARG_POSITIONAL) ? strlen(pct) : spec.len;
+            n = snprintf(buff + w, size - w, "%.*s", (int) l, pct);
+            f = pct + l;
+        }
+        else if ( spec.type == ARG_PERCENT )
+        {
+            n = snprintf(buff + w, size - w, "%%");
+        }
+        else if ( spec.type == ARG_ERRNO )
+        {
+            n = snprintf(buff + w, size - w, "%s", strerror_r(err, errbuf, sizeof(errbuf) ) );
+        }
+        else if ( spec.type != ARG_SKIP )
+        {
+            // Stop if the argument was not captured
+            if ( r + spec.nb_stars * sizeof(int64_t) + fmt_arg_size(spec.type) + ( ( (spec.type == ARG_STR) || (spec.type == ARG_WSTR) ) ? sizeof(uint32_t) : 0) > len )
+            {
+                snprintf(buff + w, size - w, "...");
+                w = (w + 3 < size - 1) ? w + 3 : size - 1;
+                break;
+            }
+
+            memcpy(conv, pct, spec.len);
+            conv[spec.len] = '\0';
+
+            for ( i = 0; i < spec.nb_stars; i++ )
+            {
+                memcpy(&v, args + r, sizeof(v) );
+                r += sizeof(v);
+                stars[i] = (int) v;
+            }
+
+            switch ( spec.type )
+            {
+                case ARG_INT:
+                    memcpy(&v, args + r, sizeof(v) );
+                    n = FMT_PRINT( (int) v);
+                    break;
+
+                case ARG_LONG:
+                    memcpy(&v, args + r, sizeof(v) );
+                    n = FMT_PRINT( (long) v);
+                    break;
+
+                case ARG_LLONG:
+                    memcpy(&v, args + r, sizeof(v) );
+                    n = FMT_PRINT( (long long) v);
+                    break;
+
+                case ARG_INTMAX:
+                    memcpy(&v, args + r, sizeof(v) );
+                    n = FMT_PRINT( (intmax_t) v);
+                    break;
+
+                case ARG_SIZE:
+                    memcpy(&v, args + r, sizeof(v) );
+                    n = FMT_PRINT( (size_t) v);
+                    break;
+
+                case ARG_PTRDIFF:
+                    memcpy(&v, args + r, sizeof(v) );
+                    n = FMT_PRINT( (ptrdiff_t) v);
+                    break;
+
+                case ARG_WINT:
+                    memcpy(&v, args + r, sizeof(v) );
+                    n = FMT_PRINT( (wint_t) v);
+                    break;
+
+                case ARG_PTR:
+                    memcpy(&v, args + r, sizeof(v) );
+                    n = FMT_PRINT( (void *) (intptr_t) v);
+                    break;
+
+                case ARG_DOUBLE:
+                {
+                    double     d = 0;
+
+
+                    memcpy(&d, args + r, sizeof(d) );
+                    n = FMT_PRINT(d);
+                    break;
+                }
+
+                case ARG_LDOUBLE:
+                {
+                    long double     d = 0;
+
+
+                    memcpy(&d, args + r, sizeof(d) );
+                    n = FMT_PRINT(d);
+                    break;
+                }
+
+                case ARG_STR:
+                {
+                    uint32_t     sl = 0;
+
+
+                    memcpy(&sl, args + r, sizeof(sl) );
+                    n   = FMT_PRINT( (sl == FMT_NULL_STR) ? NULL : args + r + sizeof(uint32_t) );
+                    r   += FMT_ALIGN(sizeof(uint32_t) + ( (sl == FMT_NULL_STR) ? 0 : sl + 1) );
+                    break;
+                }
+
+                case ARG_WSTR:
+                {
+                    uint32_t     sl     = 0;
+                    size_t       off    = FMT_ALIGN(r + sizeof(uint32_t) );
+
+
+                    memcpy(&sl, args + r, sizeof(sl) );
+                    n   = FMT_PRINT( (sl == FMT_NULL_STR) ? NULL : (const wchar_t *) (args + off) );
+                    r   = FMT_ALIGN(off + ( (sl == FMT_NULL_STR) ? 0 : (sl + 1) * sizeof(wchar_t) ) );
+                    break;
+                }
+
+                default:
+                    break;
+            }
+
+            r += fmt_arg_size(spec.type);
+        }
+
+        if ( n > 0 )
+        {
+            w += n;
+            w = (w < size - 1) ? w : size - 1;
+        }
+    }
+
+#undef FMT_PRINT
+
+    return (w);
+}
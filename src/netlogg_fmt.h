@@ -0,0 +1,58 @@
+/**
+ * @file netlogg_fmt.h
+ * @author hbuyse
+ * @date 16/10/2026
+ *
+ * Deferred formatting: the producers only copy the raw arguments of a printf
+ * like format, the netlogging thread renders the text later.
+ */
+
+
+#ifndef __NETLOGG_FMT_H__
+#define __NETLOGG_FMT_H__
+
+#include <stddef.h>          // size_t
+#include <stdarg.h>          // va_list
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * \brief      Copy the arguments needed by a format in a binary buffer
+ *
+ * The strings (%s) are copied since they may not exist anymore when the message
+ * is rendered. The arguments that do not fit in the buffer are not copied and
+ * the rendering stops there.
+ *
+ * \param      args    The buffer
+ * \param[in]  size    The buffer size
+ * \param[in]  format  The format
+ * \param[in]  ap      List of variable for the format
+ *
+ * \return     Number of bytes used in args
+ */
+size_t netlogg_fmt_capture(char *args, size_t size, const char *format, va_list ap);
+
+
+/**
+ * \brief      Render a format with the arguments copied by netlogg_fmt_capture
+ *
+ * \param      buff    The output buffer (always nul terminated)
+ * \param[in]  size    The output buffer size
+ * \param[in]  format  The format
+ * \param[in]  args    The arguments
+ * \param[in]  len     The size of the arguments
+ * \param[in]  err     The value of errno when the arguments were captured (for %m)
+ *
+ * \return     Number of bytes written in buff (without the nul byte)
+ */
+size_t netlogg_fmt_render(char *buff, size_t size, const char *format, const char *args, size_t len, int err);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif          // __NETLOGG_FMT_H__
@@ -0,0 +1,118 @@
+/**
+ * @file netlogg_levels.c
+ * @author hbuyse
+ * @date 16/10/2026
+ *
+ * The patterns are only appended and their text never changes, so that the
+ * producers refreshing the level of a call site read them without lock.
+ */
+
+#include <string.h>          // strcmp, strcpy, strlen, strrchr
+#include <fnmatch.h>          // fnmatch
+#include <pthread.h>          // pthread_mutex_lock
+
+#include "netlogg_levels.h"
+
+
+/**
+ * \brief Patterns (only appended)
+ */
+static netlogg_levels_rule     levels_rules[NETLOGG_LEVELS_MAX];
+
+
+/**
+ * \brief Number of patterns (atomic)
+ */
+static uint32_t     levels_nb       = 0;
+
+
+/**
+ * \brief Serializes the changes of the patterns
+ */
+static pthread_mutex_t     levels_lock  = PTHREAD_MUTEX_INITIALIZER;
+
+
+
+int netlogg_levels_set(const char   *glob,
+                       int          lvl
+                       )
+{
+    uint32_t     i = 0;
+
+
+    if ( strlen(glob) >= NETLOGG_LEVELS_GLOB_MAX )
+    {
+        return (-1);
+    }
+
+    pthread_mutex_lock(&levels_lock);
+
+    for ( i = 0; (i < levels_nb) && (strcmp(levels_rules[i].glob, glob) != 0); i++ )
+    {
+    }
+
+    if ( i == NETLOGG_LEVELS_MAX )
+    {
+        pthread_mutex_unlock(&levels_lock);
+
+        return (-1);
+    }
+
+    // A new pattern is complete before it is published
+    if ( i == levels_nb )
+    {
+        strcpy(levels_rules[i].glob, glob);
+        levels_rules[i].lvl = lvl;
+        __atomic_store_n(&levels_nb, i + 1, __ATOMIC_RELEASE);
+    }
+
+    __atomic_store_n(&levels_rules[i].lvl, lvl, __ATOMIC_RELAXED);
+
+    pthread_mutex_unlock(&levels_lock);
+
+    return (0);
+}
+
+
+
+Netlogging_lvl netlogg_levels_get(const char *file)
+{
+    uint32_t        nb      = __atomic_load_n(&levels_nb, __ATOMIC_ACQUIRE);
+    const char      *name   = strrchr(file, '/');
+    size_t          best    = 0;
+    size_t          len     = 0;
+    int             lvl     = 0;
+    Netlogging_lvl  res     = NETLOGG_DEBUG;
+
+
+    name = (name != NULL) ? name + 1 : file;
+
+    for ( uint32_t i = 0; i < nb; i++ )
+    {
+        lvl = __atomic_load_n(&levels_rules[i].lvl, __ATOMIC_RELAXED);
+        len = strlen(levels_rules[i].glob);
+
+        if ( (lvl == -1) || (len < best) )
+        {
+            continue;
+        }
+
+        // The longest pattern is the most specific one
+        if ( (fnmatch(levels_rules[i].glob, file, 0) == 0) || (fnmatch(levels_rules[i].glob, name, 0) == 0) )
+        {
+            best    = len;
+            res     = (Netlogging_lvl) lvl;
+        }
+    }
+
+    return (res);
+}
+
+
+
+const netlogg_levels_rule* netlogg_levels_rules(uint32_t *nb)
+{
+    *nb = __atomic_load_n(&levels_nb, __ATOMIC_ACQUIRE);
+
+    return (levels_rules);
+}
@@ -0,0 +1,84 @@
+/**
+ * @file netlogg_levels.h
+ * @author hbuyse
+ * @date 16/10/2026
+ *
+ * Levels of the source files, changed at runtime by the setlevel command. A
+ * call site only sends the messages of its file level and above: the sites
+ * keep their level in a word of their own (see netlogg_site_enabled), so that
+ * the table is only read again when it changes.
+ */
+
+
+#ifndef __NETLOGG_LEVELS_H__
+#define __NETLOGG_LEVELS_H__
+
+#include <stdint.h>          // int32_t, uint32_t
+
+#include "netlogging.h"          // Netlogging_lvl
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * \brief Number of patterns (a pattern is kept once created, its level is changed by the next ones)
+ */
+#define NETLOGG_LEVELS_MAX          64
+
+
+/**
+ * \brief Longest pattern
+ */
+#define NETLOGG_LEVELS_GLOB_MAX     128
+
+
+/**
+ * \brief Level of the files matching a pattern
+ */
+typedef struct {
+    char glob[NETLOGG_LEVELS_GLOB_MAX];          ///< Shell pattern of the path of the files, or of their name
+    int32_t lvl;          ///< Less severe level sent by the files (atomic, -1: pattern removed)
+} netlogg_levels_rule;
+
+
+/**
+ * \brief      Set the level of the files matching a pattern
+ *
+ * The longest pattern matching a file gives its level, the files matched by
+ * none have every level.
+ *
+ * \param[in]  glob  The pattern, matched with fnmatch on the path and on the name of the files ("*": every file)
+ * \param[in]  lvl   The less severe level sent by the files (-1: remove the pattern)
+ *
+ * \return     0 on success, -1 if there are too many patterns
+ */
+int netlogg_levels_set(const char *glob, int lvl);
+
+
+/**
+ * \brief      Get the level of a file
+ *
+ * \param[in]  file  The file
+ *
+ * \return     The less severe level sent by the file (NETLOGG_DEBUG if no pattern matches it)
+ */
+Netlogging_lvl netlogg_levels_get(const char *file);
+
+
+/**
+ * \brief      Get the patterns
+ *
+ * \param      nb    Number of patterns (removed ones included)
+ *
+ * \return     The patterns (only the lvl field of the first nb patterns changes)
+ */
+const netlogg_levels_rule* netlogg_levels_rules(uint32_t *nb);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif          // __NETLOGG_LEVELS_H__
@@ -0,0 +1,363 @@
+/**
+ * @file netlogg_ratelimit.c
+ * @author hbuyse
+ * @date 16/10/2026
+ *
+ * The bucket of a site is a single word updated with a CAS (GCRA: the
+ * theoretical arrival time of the next message), found in an open addressing
+ * table whose slots are taken with a CAS on their key: the producers never
+ * lock. The rules are only appended, so that the producers read them without
+ * lock; a new generation makes the sites look for their rule again.
+ */
+
+#include <string.h>          // strcmp, strlen, memcmp
+#include <time.h>          // clock_gettime
+#include <pthread.h>          // pthread_mutex_lock
+
+#include "netlogg_ratelimit.h"
+
+
+#define RATE_PROBES     32          // Slots of the table tried for a site before it is left without limit
+
+
+/**
+ * \brief Bucket of a call site
+ */
+typedef struct {
+    uint64_t key;          ///< File and line of the site (atomic, 0: free slot)
+    const char *file;          ///< File of the site (atomic, set after key and lineno)
+    int32_t lineno;          ///< Line of the site (set after key)
+    uint32_t gen;          ///< Generation of the rules of interval and tau (atomic)
+    uint64_t interval;          ///< Nanoseconds between two messages (atomic, 0: no limit)
+    uint64_t tau;          ///< Nanoseconds a message can be ahead of its time, the burst (atomic)
+    uint64_t tat;          ///< Theoretical arrival time of the next message (atomic, CLOCK_MONOTONIC)
+    uint64_t dropped;          ///< Messages dropped (atomic)
+} __attribute__( (aligned(64) ) ) netlogg_ratelimit_bucket;
+
+
+/**
+ * \brief Buckets of the sites
+ */
+static netlogg_ratelimit_bucket     rate_sites[NETLOGG_RATELIMIT_SITES];
+
+
+/**
+ * \brief Rules (only appended)
+ */
+static netlogg_ratelimit_rule     rate_rules[NETLOGG_RATELIMIT_RULES_MAX];
+
+
+/**
+ * \brief Number of rules (atomic)
+ */
+static uint32_t     rate_nb_rules   = 0;
+
+
+/**
+ * \brief Number of rules with a rate (atomic, 0: nothing to check)
+ */
+static uint32_t     rate_on         = 0;
+
+
+/**
+ * \brief Generation of the rules, incremented by each change (atomic)
+ */
+static uint32_t     rate_gen        = 1;
+
+
+/**
+ * \brief Serializes the changes of the rules
+ */
+static pthread_mutex_t     rate_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+
+int netlogg_ratelimit_set(const char    *file,
+                          int32_t       lineno,
+                          uint32_t      rate,
+                          uint32_t      burst
+                          )
+{
+    uint32_t                    i   = 0;
+    uint32_t                    on  = 0;
+    netlogg_ratelimit_rule      *r  = NULL;
+
+
+    if ( strlen(file) >= NETLOGG_RATELIMIT_FILE_MAX )
+    {
+        return (-1);
+    }
+
+    pthread_mutex_lock(&rate_lock);
+
+    for ( i = 0; i < rate_nb_rules; i++ )
+    {
+        if ( (strcmp(rate_rules[i].file, file) == 0) && (rate_rules[i].lineno == lineno) )
+        {
+            break;
+        }
+    }
+
+    if ( i == NETLOGG_RATELIMIT_RULES_MAX )
+    {
+        pthread_mutex_unlock(&rate_lock);
+
+        return (-1);
+    }
+
+    r = &rate_rules[i];
+
+    // A new rule is complete before it is published
+    if ( i == rate_nb_rules )
+    {
+        strcpy(r->file, file);
+        r->lineno = lineno;
+        __atomic_store_n(&rate_nb_rules, i + 1, __ATOMIC_RELEASE);
+    }
+
+    __atomic_store_n(&r->rate, rate, __ATOMIC_RELAXED);
+    __atomic_store_n(&r->burst, (burst != 0) ? burst : rate, __ATOMIC_RELAXED);
+
+    for ( i = 0; i < rate_nb_rules; i++ )
+    {
+        on += (rate_rules[i].rate != 0);
+    }
+
+    __atomic_store_n(&rate_on, on, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&rate_gen, 1, __ATOMIC_RELEASE);
+
+    pthread_mutex_unlock(&rate_lock);
+
+    return (0);
+}
+
+
+
+/**
+ * \brief      Find the bucket of a site, take a free slot for it the first time
+ *
+ * \param[in]  file    The file of the site
+ * \param[in]  lineno  The line of the site
+ *
+ * \return     The bucket, NULL if the table has no room around its slot
+ */
+static netlogg_ratelimit_bucket* netlogg_ratelimit_lookup(const char  *file,
+                                                        int32_t     lineno
+                                                        )
+{
+    // User space addresses fit in 48 bits: the key is exact for the lines below 65536
+    uint64_t    key     = ( (uint64_t) (uintptr_t) file << 16) | (uint16_t) lineno;
+    uint32_t    idx     = (key * 0x9E3779B97F4A7C15ull) >> (64 - __builtin_ctz(NETLOGG_RATELIMIT_SITES) );
+    uint64_t    cur     = 0;
+
+
+    for ( int i = 0; i < RATE_PROBES; i++, idx = (idx + 1) & (NETLOGG_RATELIMIT_SITES - 1) )
+    {
+        cur = __atomic_load_n(&rate_sites[idx].key, __ATOMIC_ACQUIRE);
+
+        if ( cur == 0 )
+        {
+            if ( __atomic_compare_exchange_n(&rate_sites[idx].key, &cur, key, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE) )
+            {
+                rate_sites[idx].lineno = lineno;
+                __atomic_store_n(&rate_sites[idx].file, file, __ATOMIC_RELEASE);
+
+                return (&rate_sites[idx]);
+            }
+        }
+
+        // Taken by the same site from another thread, or by another site
+        if ( cur == key )
+        {
+            return (&rate_sites[idx]);
+        }
+    }
+
+    return (NULL);
+}
+
+
+
+/**
+ * \brief      Tell if a file is the one of a rule
+ *
+ * \param[in]  file  The file of the site
+ * \param[in]  rule  The file of the rule
+ *
+ * \return     1 if it is, 0 otherwise
+ */
+static int netlogg_ratelimit_file(const char    *file,
+                                  const char    *rule
+                                  )
+{
+    size_t      len     = strlen(file);
+    size_t      rlen    = strlen(rule);
+
+
+    if ( len < rlen )
+    {
+        return (0);
+    }
+
+    return ( (memcmp(file + len - rlen, rule, rlen) == 0) && ( (len == rlen) || (file[len - rlen - 1] == '/') ) );
+}
+
+
+
+/**
+ * \brief      Find the most specific rule of a site and keep its limit in the bucket
+ *
+ * \param      s       The bucket
+ * \param[in]  file    The file of the site
+ * \param[in]  lineno  The line of the site
+ * \param[in]  gen     The generation of the rules
+ */
+static void netlogg_ratelimit_resolve(netlogg_ratelimit_bucket  *s,
+                                      const char                *file,
+                                      int32_t                   lineno,
+                                      uint32_t                  gen
+                                      )
+{
+    uint32_t    nb      = __atomic_load_n(&rate_nb_rules, __ATOMIC_ACQUIRE);
+    uint32_t    rate    = 0;
+    uint32_t    burst   = 0;
+    int         best    = -1;
+    int         match   = -1;
+
+
+    for ( uint32_t i = 0; i < nb; i++ )
+    {
+        if ( __atomic_load_n(&rate_rules[i].rate, __ATOMIC_RELAXED) == 0 )
+        {
+            continue;
+        }
+
+        // Every site, then the sites of the file, then the site itself
+        if ( strcmp(rate_rules[i].file, "*") == 0 )
+        {
+            match = 0;
+        }
+        else if ( ! netlogg_ratelimit_file(file, rate_rules[i].file) )
+        {
+            continue;
+        }
+        else if ( rate_rules[i].lineno == 0 )
+        {
+            match = 1;
+        }
+        else if ( rate_rules[i].lineno == lineno )
+        {
+            match = 2;
+        }
+        else
+        {
+            continue;
+        }
+
+        if ( match > best )
+        {
+            best    = match;
+            rate    = __atomic_load_n(&rate_rules[i].rate, __ATOMIC_RELAXED);
+            burst   = __atomic_load_n(&rate_rules[i].burst, __ATOMIC_RELAXED);
+        }
+    }
+
+    __atomic_store_n(&s->interval, (rate != 0) ? 1000000000ull / rate : 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&s->tau, ( (rate != 0) && (burst > 1) ) ? (burst - 1) * (1000000000ull / rate) : 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&s->gen, gen, __ATOMIC_RELEASE);
+}
+
+
+
+int netlogg_ratelimit_check(const char  *file,
+                            int32_t     lineno
+                            )
+{
+    netlogg_ratelimit_bucket    *s          = NULL;
+    uint32_t                gen         = 0;
+    uint64_t                interval    = 0;
+    uint64_t                tau         = 0;
+    uint64_t                now         = 0;
+    uint64_t                tat         = 0;
+    uint64_t                t           = 0;
+    struct timespec         ts;
+
+
+    if ( __atomic_load_n(&rate_on, __ATOMIC_RELAXED) == 0 )
+    {
+        return (1);
+    }
+
+    s = netlogg_ratelimit_lookup(file, lineno);
+
+    if ( s == NULL )
+    {
+        return (1);
+    }
+
+    gen = __atomic_load_n(&rate_gen, __ATOMIC_ACQUIRE);
+
+    if ( __atomic_load_n(&s->gen, __ATOMIC_ACQUIRE) != gen )
+    {
+        netlogg_ratelimit_resolve(s, file, lineno, gen);
+    }
+
+    interval    = __atomic_load_n(&s->interval, __ATOMIC_RELAXED);
+    tau         = __atomic_load_n(&s->tau, __ATOMIC_RELAXED);
+
+    if ( interval == 0 )
+    {
+        return (1);
+    }
+
+    // The wall clock may go back
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    now = (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+    tat = __atomic_load_n(&s->tat, __ATOMIC_RELAXED);
+
+    do
+    {
+        t = (tat > now) ? tat : now;
+
+        // Too far ahead of the rate: the burst is used up
+        if ( t - now > tau )
+        {
+            __atomic_add_fetch(&s->dropped, 1, __ATOMIC_RELAXED);
+
+            return (0);
+        }
+    } while ( ! __atomic_compare_exchange_n(&s->tat, &tat, t + interval, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED) );
+
+    return (1);
+}
+
+
+
+const netlogg_ratelimit_rule* netlogg_ratelimit_rules(uint32_t *nb)
+{
+    *nb = __atomic_load_n(&rate_nb_rules, __ATOMIC_ACQUIRE);
+
+    return (rate_rules);
+}
+
+
+
+uint64_t netlogg_ratelimit_site(uint32_t        idx,
+                                const char      **file,
+                                int32_t         *lineno
+                                )
+{
+    const char     *f = __atomic_load_n(&rate_sites[idx].file, __ATOMIC_ACQUIRE);
+
+
+    // The file is set once the slot is taken
+    if ( f == NULL )
+    {
+        return (0);
+    }
+
+    *file   = f;
+    *lineno = rate_sites[idx].lineno;
+
+    return (__atomic_load_n(&rate_sites[idx].dropped, __ATOMIC_RELAXED) );
+}
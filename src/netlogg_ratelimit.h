@@ -0,0 +1,104 @@
+/**
+ * @file netlogg_ratelimit.h
+ * @author hbuyse
+ * @date 16/10/2026
+ *
+ * Rate limits of the call sites: each site (file and line) has its own token
+ * bucket, checked by the producers before the message is copied in the ring.
+ * The limits are rules on a file, a line of a file or every site, changed at
+ * runtime by the ratelimit command.
+ */
+
+
+#ifndef __NETLOGG_RATELIMIT_H__
+#define __NETLOGG_RATELIMIT_H__
+
+#include <stdint.h>          // uint32_t, uint64_t
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * \brief Number of rules (a rule is kept once created, its rate is changed by the next ones)
+ */
+#define NETLOGG_RATELIMIT_RULES_MAX     64
+
+
+/**
+ * \brief Longest file of a rule
+ */
+#define NETLOGG_RATELIMIT_FILE_MAX      128
+
+
+/**
+ * \brief Number of call sites with a bucket (the next ones are not limited)
+ */
+#define NETLOGG_RATELIMIT_SITES         4096
+
+
+/**
+ * \brief Limit of the sites of a file, of a line of a file or of every site
+ */
+typedef struct {
+    char file[NETLOGG_RATELIMIT_FILE_MAX];          ///< File of the sites ("*": every site), or the end of its path after a /
+    int32_t lineno;          ///< Line of the site (0: every line of the file)
+    uint32_t rate;          ///< Messages per second of each site (atomic, 0: no limit)
+    uint32_t burst;          ///< Messages sent at once before the rate applies (atomic)
+} netlogg_ratelimit_rule;
+
+
+/**
+ * \brief      Set the limit of the sites of a file, of a line of a file or of every site
+ *
+ * The most specific rule applies to a site: its line, then its file, then "*".
+ *
+ * \param[in]  file    The file ("*": every site)
+ * \param[in]  lineno  The line (0: every line of the file)
+ * \param[in]  rate    Messages per second of each site (0: remove the limit)
+ * \param[in]  burst   Messages sent at once before the rate applies (0: rate)
+ *
+ * \return     0 on success, -1 if there are too many rules
+ */
+int netlogg_ratelimit_set(const char *file, int32_t lineno, uint32_t rate, uint32_t burst);
+
+
+/**
+ * \brief      Tell if a message of a site can be sent (producers, lock-free)
+ *
+ * \param[in]  file    The file of the site (static string)
+ * \param[in]  lineno  The line of the site
+ *
+ * \return     1 if it can be sent, 0 if the site is over its limit (the message is counted as dropped)
+ */
+int netlogg_ratelimit_check(const char *file, int32_t lineno);
+
+
+/**
+ * \brief      Get the rules
+ *
+ * \param      nb    Number of rules (rules with a rate of 0 included)
+ *
+ * \return     The rules (only the rate and burst fields of the first nb rules change)
+ */
+const netlogg_ratelimit_rule* netlogg_ratelimit_rules(uint32_t *nb);
+
+
+/**
+ * \brief      Get the messages dropped by a site
+ *
+ * \param[in]  idx     Index of the site (up to NETLOGG_RATELIMIT_SITES)
+ * \param      file    The file of the site
+ * \param      lineno  The line of the site
+ *
+ * \return     The messages dropped by the site (0 if there is no site at this index)
+ */
+uint64_t netlogg_ratelimit_site(uint32_t idx, const char **file, int32_t *lineno);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif          // __NETLOGG_RATELIMIT_H__
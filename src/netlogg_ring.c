@@ -0,0 +1,570 @@
+/**
+ * @file netlogg_ring.c
+ * @author hbuyse
+ * @date 16/10/2026
+ *
+ * Bounded MPSC byte ring: the producers reserve contiguous space for a record
+ * with a CAS on the tail, fill it, then publish it by writing its size. The
+ * consumer reads the records in order and zeroes them when it gives the space
+ * back, so a size of 0 always means "not published yet". The producers never
+ * enter the kernel unless the consumer is sleeping.
+ *
+ * A producer overwriting the oldest records takes the place of the consumer
+ * for them: the consumer announces the record it reads (ring_reading), the
+ * producer announces that it drops some (ring_victim), and each one checks
+ * the announce of the other after a full fence, so that they never work on
+ * the same record.
+ *
+ * The ring can be moved into a file (the flight recorder): the file is mapped
+ * over the pages of the ring, so the records not read yet outlive a crash of
+ * the process without any cost for the producers.
+ */
+
+#include <string.h>          // memset, memcpy
+#include <errno.h>          // errno, EINTR
+#include <time.h>          // clock_gettime, nanosleep
+#include <sched.h>          // sched_yield
+#include <fcntl.h>          // open
+#include <unistd.h>          // write, close, getpid
+#include <sys/mman.h>          // mmap
+#include <sys/eventfd.h>          // eventfd, eventfd_read, eventfd_write
+
+#include "netlogg_ring.h"
+#include "netlogg_stats.h"          // netlogg_stats_add
+
+
+#define CACHELINE_SIZE        64
+#define PAGE_SIZE_MIN         4096          // The ring is mapped page by page over the recorder file
+
+#define RING_MASK             ( (uint64_t) NETLOGG_RING_SIZE - 1)
+#define RING_ALIGN(s)         ( ( (s) + 7) & ~( (size_t) 7) )
+#define RING_PAD_BIT          0x80000000u
+#define RING_NONE             UINT64_MAX          // ring_reading when the consumer reads nothing, ring_victim when nobody drops
+#define RING_YIELDS           64          // Times a producer lets the consumer run before it sleeps or gives up
+#define RING_BLOCK_SLEEP_NS   50000          // Sleep of a blocked producer between two tries
+
+#if (NETLOGG_RING_SIZE & (NETLOGG_RING_SIZE - 1) ) != 0
+    #error "NETLOGG_RING_SIZE has to be a power of two"
+#endif
+
+#if NETLOGG_RING_SIZE < PAGE_SIZE_MIN
+    #error "NETLOGG_RING_SIZE has to be at least a page"
+#endif
+
+
+/**
+ * \brief Bytes of the ring
+ */
+static char     ring[NETLOGG_RING_SIZE] __attribute__( (aligned(PAGE_SIZE_MIN) ) );
+
+
+/**
+ * \brief Next byte to reserve (producers)
+ */
+static uint64_t     ring_tail __attribute__( (aligned(CACHELINE_SIZE) ) )   = 0;
+
+
+/**
+ * \brief Next byte to read (consumer)
+ */
+static uint64_t     ring_head __attribute__( (aligned(CACHELINE_SIZE) ) )   = 0;
+
+
+/**
+ * \brief Position of the record the consumer reads (RING_NONE: none)
+ */
+static uint64_t     ring_reading __attribute__( (aligned(CACHELINE_SIZE) ) )    = RING_NONE;
+
+
+/**
+ * \brief Set by the producer dropping the oldest records (RING_NONE: nobody)
+ */
+static uint64_t     ring_victim __attribute__( (aligned(CACHELINE_SIZE) ) )     = RING_NONE;
+
+
+/**
+ * \brief Set in the consumer thread: it never waits for itself
+ */
+static __thread int     ring_consumer   = 0;
+
+
+/**
+ * \brief Set by the consumer before it waits on the eventfd
+ */
+static int     ring_sleeping __attribute__( (aligned(CACHELINE_SIZE) ) )   = 0;
+
+
+/**
+ * \brief Messages dropped because the ring was full
+ */
+static uint64_t     ring_dropped        = 0;
+
+
+/**
+ * \brief Eventfd used to wake up the consumer
+ */
+static int     ring_evt_fd          = -1;
+
+
+/**
+ * \brief String table written after the ring by netlogg_ring_dump
+ */
+static const char     *ring_strtab  = NULL;
+
+
+/**
+ * \brief Size of the string table
+ */
+static size_t     ring_strtab_len   = 0;
+
+
+
+/**
+ * \brief      Fill the header of a flight recorder file
+ *
+ * \param[out] hdr   The header
+ */
+static void netlogg_ring_rec_hdr(netlogg_rec_hdr *hdr)
+{
+    memset(hdr, 0, sizeof(*hdr) );
+    memcpy(hdr->magic, NETLOGG_REC_MAGIC, sizeof(NETLOGG_REC_MAGIC) );
+    hdr->hdr_size       = NETLOGG_REC_HDR_SIZE;
+    hdr->record_size    = sizeof(netlogg_record);
+    hdr->ring_size      = NETLOGG_RING_SIZE;
+    hdr->strtab_off     = NETLOGG_REC_HDR_SIZE + NETLOGG_RING_SIZE;
+    hdr->strtab_len     = ring_strtab_len;
+    hdr->pid            = getpid();
+}
+
+
+
+/**
+ * \brief      Write a whole buffer (async-signal-safe)
+ *
+ * \param[in]  fd    The file descriptor
+ * \param[in]  buff  The buffer
+ * \param[in]  len   Its length
+ *
+ * \return     0 on success, -1 on error
+ */
+static int netlogg_ring_write(int           fd,
+                              const char    *buff,
+                              size_t        len
+                              )
+{
+    ssize_t     res = 0;
+
+
+    while ( len != 0 )
+    {
+        res = write(fd, buff, len);
+
+        if ( res == -1 )
+        {
+            if ( errno == EINTR )
+            {
+                continue;
+            }
+
+            return (-1);
+        }
+
+        buff    += res;
+        len     -= res;
+    }
+
+    return (0);
+}
+
+
+
+/**
+ * \brief      Write the header, the ring and the string table (async-signal-safe)
+ *
+ * \param[in]  fd    The file descriptor
+ *
+ * \return     0 on success, -1 on error
+ */
+static int netlogg_ring_write_all(int fd)
+{
+    static const char   zeroes[NETLOGG_REC_HDR_SIZE - sizeof(netlogg_rec_hdr)];
+    netlogg_rec_hdr     hdr;
+
+
+    netlogg_ring_rec_hdr(&hdr);
+
+    if ( (netlogg_ring_write(fd, (const char *) &hdr, sizeof(hdr) ) == -1) ||
+         (netlogg_ring_write(fd, zeroes, sizeof(zeroes) ) == -1) ||
+         (netlogg_ring_write(fd, ring, sizeof(ring) ) == -1) ||
+         (netlogg_ring_write(fd, ring_strtab, ring_strtab_len) == -1) )
+    {
+        return (-1);
+    }
+
+    return (0);
+}
+
+
+int netlogg_ring_init(void)
+{
+    ring_consumer   = 1;
+    ring_evt_fd     = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    return (ring_evt_fd);
+}
+
+
+
+/**
+ * \brief      Drop the oldest records not read yet to make room (producer side)
+ *
+ * Waits for the consumer to give back the record it reads, if it is the
+ * oldest one: a single record is rendered meanwhile. A producer of a less
+ * severe level than NETLOGG_ERROR stops at the first critical record.
+ *
+ * \param[in]  target    Position the head has to reach for the record of the producer to fit
+ * \param[in]  critical  The producer may drop the critical records
+ *
+ * \return     1 if the producer can try again, 0 otherwise (nothing could be dropped)
+ */
+static int netlogg_ring_overwrite(uint64_t    target,
+                                  int         critical
+                                  )
+{
+    uint64_t    none    = RING_NONE;
+    uint64_t    head    = 0;
+    uint64_t    nb      = 0;
+    uint32_t    size    = 0;
+    int         i       = 0;
+
+
+    // Only one producer drops at a time, the others wait for the room it makes
+    if ( (__atomic_load_n(&ring_victim, __ATOMIC_RELAXED) != RING_NONE) ||
+         ! __atomic_compare_exchange_n(&ring_victim, &none, 0, 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED) )
+    {
+        sched_yield();
+
+        return (1);
+    }
+
+    // Pairs with the fence of netlogg_ring_peek: either we see the record it reads, or it sees us and waits
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    for ( i = 0; i < RING_YIELDS; i++ )
+    {
+        head = __atomic_load_n(&ring_head, __ATOMIC_ACQUIRE);
+
+        if ( __atomic_load_n(&ring_reading, __ATOMIC_ACQUIRE) != head )
+        {
+            break;
+        }
+
+        sched_yield();
+    }
+
+    // The consumer only moves the head past the record it reads: from here on, the head is ours
+    while ( (i < RING_YIELDS) && (head < target) )
+    {
+        size = __atomic_load_n( (uint32_t *) &ring[head & RING_MASK], __ATOMIC_ACQUIRE);
+
+        // Still filled by its producer, or more important than the new one
+        if ( (size == 0) ||
+             ( ! critical && ! (size & RING_PAD_BIT) && ( ( (netlogg_record *) &ring[head & RING_MASK])->lvl <= NETLOGG_ERROR) ) )
+        {
+            break;
+        }
+
+        nb      += ! (size & RING_PAD_BIT);
+        size    &= ~RING_PAD_BIT;
+        memset(&ring[head & RING_MASK], 0, size);
+        head    += size;
+        __atomic_store_n(&ring_head, head, __ATOMIC_RELEASE);
+    }
+
+    __atomic_store_n(&ring_victim, RING_NONE, __ATOMIC_RELEASE);
+
+    if ( nb != 0 )
+    {
+        __atomic_fetch_add(&ring_dropped, nb, __ATOMIC_RELAXED);
+        netlogg_stats_add(NETLOGG_STAT_RING_OVERWRITES, nb);
+    }
+
+    return ( (i < RING_YIELDS) && (head >= target) );
+}
+
+
+
+/**
+ * \brief      Wait for the consumer to make room (producer side)
+ *
+ * \param      deadline    CLOCK_MONOTONIC time after which the producer gives up, set by the first call
+ * \param[in]  timeout_ns  Longest wait
+ * \param[in]  tries       Times the producer already waited
+ *
+ * \return     1 if the producer can try again, 0 once the deadline is reached
+ */
+static int netlogg_ring_wait(uint64_t   *deadline,
+                             uint64_t   timeout_ns,
+                             uint32_t   tries
+                             )
+{
+    uint64_t            now = 0;
+    struct timespec     ts;
+
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    now = (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+
+    if ( *deadline == 0 )
+    {
+        *deadline = now + timeout_ns;
+    }
+
+    if ( now >= *deadline )
+    {
+        return (0);
+    }
+
+    // A record is rendered in a few microseconds: let the consumer run, then sleep
+    if ( tries < RING_YIELDS )
+    {
+        sched_yield();
+    }
+    else
+    {
+        ts.tv_sec   = 0;
+        ts.tv_nsec  = (*deadline - now < RING_BLOCK_SLEEP_NS) ? *deadline - now : RING_BLOCK_SLEEP_NS;
+        nanosleep(&ts, NULL);
+    }
+
+    return (1);
+}
+
+
+
+netlogg_record* netlogg_ring_reserve(size_t                     len,
+                                     int                        critical,
+                                     Netlogging_backpressure    bp,
+                                     uint64_t                   timeout_ns
+                                     )
+{
+    netlogg_record     *rec = NULL;
+    uint64_t       pos      = 0;
+    uint64_t       pad      = 0;
+    uint64_t       off      = 0;
+    uint64_t       deadline = 0;
+    uint64_t       room     = critical ? NETLOGG_RING_SIZE : NETLOGG_RING_SIZE - NETLOGG_RING_RESERVED;
+    uint32_t       tries    = 0;
+    size_t         need     = RING_ALIGN(sizeof(netlogg_record) + len);
+
+
+    // The consumer would wait for itself
+    bp  = ring_consumer ? NETLOGG_BP_DROP : bp;
+    pos = __atomic_load_n(&ring_tail, __ATOMIC_RELAXED);
+
+    for ( ; ; )
+    {
+        // A record is never split: if it does not fit before the end, the end is skipped
+        off = pos & RING_MASK;
+        pad = (off + need > NETLOGG_RING_SIZE) ? NETLOGG_RING_SIZE - off : 0;
+
+        if ( pos + pad + need - __atomic_load_n(&ring_head, __ATOMIC_ACQUIRE) <= room )
+        {
+            if ( __atomic_compare_exchange_n(&ring_tail, &pos, pos + pad + need, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED) )
+            {
+                break;
+            }
+
+            continue;
+        }
+
+        if ( ( (bp == NETLOGG_BP_OVERWRITE) && (tries++ < RING_YIELDS) && netlogg_ring_overwrite(pos + pad + need - room, critical) ) ||
+             ( (bp == NETLOGG_BP_BLOCK) && netlogg_ring_wait(&deadline, timeout_ns, tries++) ) )
+        {
+            pos = __atomic_load_n(&ring_tail, __ATOMIC_RELAXED);
+            continue;
+        }
+
+        __atomic_fetch_add(&ring_dropped, 1, __ATOMIC_RELAXED);
+
+        return (NULL);
+    }
+
+    if ( pad != 0 )
+    {
+        __atomic_store_n( (uint32_t *) &ring[off], (uint32_t) pad | RING_PAD_BIT, __ATOMIC_RELEASE);
+    }
+
+    if ( deadline != 0 )
+    {
+        netlogg_stats_add(NETLOGG_STAT_RING_WAITS, 1);
+    }
+
+    rec         = (netlogg_record *) &ring[(pos + pad) & RING_MASK];
+    rec->len    = len;
+
+    return (rec);
+}
+
+
+
+void netlogg_ring_commit(netlogg_record *rec)
+{
+    __atomic_store_n(&rec->size, RING_ALIGN(sizeof(netlogg_record) + rec->len), __ATOMIC_RELEASE);
+
+    // Pairs with the fence of netlogg_ring_sleep: either we see the consumer sleeping, or it sees our record
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    if ( __atomic_load_n(&ring_sleeping, __ATOMIC_RELAXED) && __atomic_exchange_n(&ring_sleeping, 0, __ATOMIC_ACQ_REL) )
+    {
+        eventfd_write(ring_evt_fd, 1);
+        netlogg_stats_add(NETLOGG_STAT_SC_EVENTFD_WRITE, 1);
+    }
+}
+
+
+
+netlogg_record* netlogg_ring_peek(void)
+{
+    uint32_t     size   = 0;
+    uint64_t     head   = 0;
+    uint64_t     off    = 0;
+
+
+    for ( ; ; )
+    {
+        head = __atomic_load_n(&ring_head, __ATOMIC_ACQUIRE);
+
+        // Pairs with the fence of netlogg_ring_overwrite: a producer dropping records owns the head
+        __atomic_store_n(&ring_reading, head, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+        if ( __atomic_load_n(&ring_victim, __ATOMIC_ACQUIRE) != RING_NONE )
+        {
+            __atomic_store_n(&ring_reading, RING_NONE, __ATOMIC_RELEASE);
+
+            while ( __atomic_load_n(&ring_victim, __ATOMIC_ACQUIRE) != RING_NONE )
+            {
+                sched_yield();
+            }
+
+            continue;
+        }
+
+        off     = head & RING_MASK;
+        size    = __atomic_load_n( (uint32_t *) &ring[off], __ATOMIC_ACQUIRE);
+
+        if ( size == 0 )
+        {
+            __atomic_store_n(&ring_reading, RING_NONE, __ATOMIC_RELEASE);
+
+            return (NULL);
+        }
+
+        if ( ! (size & RING_PAD_BIT) )
+        {
+            return ( (netlogg_record *) &ring[off]);
+        }
+
+        // Skip the end of the ring left by a producer
+        size &= ~RING_PAD_BIT;
+        memset(&ring[off], 0, size);
+        __atomic_store_n(&ring_head, head + size, __ATOMIC_RELEASE);
+    }
+}
+
+
+
+void netlogg_ring_release(void)
+{
+    uint64_t           head = __atomic_load_n(&ring_head, __ATOMIC_RELAXED);
+    netlogg_record     *rec = (netlogg_record *) &ring[head & RING_MASK];
+    uint32_t           size = rec->size;
+
+
+    memset(rec, 0, size);
+    __atomic_store_n(&ring_head, head + size, __ATOMIC_RELEASE);
+}
+
+
+
+int netlogg_ring_sleep(void)
+{
+    __atomic_store_n(&ring_sleeping, 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    if ( netlogg_ring_peek() != NULL )
+    {
+        __atomic_store_n(&ring_sleeping, 0, __ATOMIC_RELAXED);
+
+        return (1);
+    }
+
+    return (0);
+}
+
+
+
+void netlogg_ring_wake(void)
+{
+    __atomic_store_n(&ring_sleeping, 0, __ATOMIC_RELAXED);
+}
+
+
+
+void netlogg_ring_ack(void)
+{
+    eventfd_t     value = 0;
+
+
+    eventfd_read(ring_evt_fd, &value);
+}
+
+
+
+int netlogg_ring_record(const char     *path,
+                        const char     *strtab,
+                        size_t         strtab_len
+                        )
+{
+    int         fd      = -1;
+    int         err     = 0;
+    void        *addr   = MAP_FAILED;
+
+
+    ring_strtab     = strtab;
+    ring_strtab_len = strtab_len;
+
+    fd              = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0640);
+
+    if ( fd == -1 )
+    {
+        return (-1);
+    }
+
+    // The records already in the ring are copied, then the file replaces the pages of the ring
+    if ( netlogg_ring_write_all(fd) == 0 )
+    {
+        addr = mmap(ring, sizeof(ring), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, NETLOGG_REC_HDR_SIZE);
+    }
+
+    err = errno;
+    close(fd);
+    errno = err;
+
+    return ( (addr == MAP_FAILED) ? -1 : 0);
+}
+
+
+
+int netlogg_ring_dump(int fd)
+{
+    return (netlogg_ring_write_all(fd) );
+}
+
+
+
+uint64_t netlogg_ring_dropped(void)
+{
+    return (__atomic_exchange_n(&ring_dropped, 0, __ATOMIC_RELAXED) );
+}
@@ -0,0 +1,235 @@
+/**
+ * @file netlogg_ring.h
+ * @author hbuyse
+ * @date 16/10/2026
+ *
+ * Lock-free multi-producer / single-consumer ring used to hand the messages
+ * from the application threads over to the netlogging thread.
+ */
+
+
+#ifndef __NETLOGG_RING_H__
+#define __NETLOGG_RING_H__
+
+#include <stdint.h>          // uint32_t, uint64_t
+#include <stddef.h>          // size_t
+
+#include "netlogging.h"          // Netlogging_lvl, Netlogging_backpressure
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#define BUFF_SIZE_MAX         4096
+
+
+/**
+ * \brief Magic number at the beginning of a flight recorder file
+ */
+#define NETLOGG_REC_MAGIC     "NLGREC1"
+
+
+/**
+ * \brief Size of the header of a flight recorder file (the ring follows it)
+ */
+#define NETLOGG_REC_HDR_SIZE  4096
+
+
+/**
+ * \brief Size of the ring in bytes (has to be a power of two)
+ */
+#ifndef NETLOGG_RING_SIZE
+    #define NETLOGG_RING_SIZE     (1024 * 1024)
+#endif
+
+
+/**
+ * \brief Bytes at the end of the ring only used by the messages from NETLOGG_ERROR up to NETLOGG_EMERG
+ *
+ * The noise of the less severe levels fills the ring up to NETLOGG_RING_SIZE -
+ * NETLOGG_RING_RESERVED bytes: the critical messages still find room behind it.
+ */
+#ifndef NETLOGG_RING_RESERVED
+    #define NETLOGG_RING_RESERVED     (NETLOGG_RING_SIZE / 8)
+#endif
+
+
+/**
+ * \brief Record stored in the ring: a fixed header followed by `len` bytes of payload
+ *
+ * The payload holds the raw arguments of the format (see netlogg_fmt_capture),
+ * the text is rendered by the netlogging thread. A message of netlogg_send is
+ * rendered by the caller: format is NULL and the payload holds the file name
+ * (nul terminated) followed by the text (see netlogg_rec_file).
+ */
+typedef struct {
+    uint32_t size;          ///< Size of the record in the ring, written last (0 while the producer fills it)
+    uint32_t len;          ///< Payload length
+    int32_t fd;          ///< Specific file descriptor (-1 for all the clients)
+    uint8_t lvl;          ///< Log level of the record
+    uint8_t reserved[3];          ///< Padding
+    uint64_t ts;          ///< Timestamp (nanoseconds since the Epoch)
+    const char *file;          ///< File of the call site (static string, NULL when format is NULL)
+    const char *format;          ///< Format of the message (static string, NULL: the payload is already rendered)
+    int32_t lineno;          ///< Line of the call site
+    int32_t err;          ///< Value of errno at the call site (for %m)
+    char payload[];          ///< Payload (8 bytes aligned)
+} netlogg_record;
+
+
+/**
+ * \brief      Get the file of a record, copied in its payload when the message was rendered by the caller
+ *
+ * \param[in]  rec   The record
+ *
+ * \return     The file
+ */
+static inline const char* netlogg_rec_file(const netlogg_record *rec)
+{
+    return ( (rec->format != NULL) ? rec->file : rec->payload);
+}
+
+
+/**
+ * \brief Header of a flight recorder file
+ *
+ * It is followed by the bytes of the ring (at NETLOGG_REC_HDR_SIZE), then by
+ * the string table (netlogg_rec_str entries) giving the text behind the file
+ * and format pointers of the records.
+ */
+typedef struct {
+    char magic[8];          ///< NETLOGG_REC_MAGIC
+    uint32_t hdr_size;          ///< Offset of the ring in the file
+    uint32_t record_size;          ///< sizeof(netlogg_record), to detect an incompatible writer
+    uint64_t ring_size;          ///< Size of the ring in bytes
+    uint64_t strtab_off;          ///< Offset of the string table in the file
+    uint64_t strtab_len;          ///< Size of the string table in bytes
+    int32_t pid;          ///< Process which wrote the file
+    int32_t reserved;          ///< Padding
+} netlogg_rec_hdr;
+
+
+/**
+ * \brief Entry of the string table of a flight recorder file (8 bytes aligned)
+ */
+typedef struct {
+    uint64_t ptr;          ///< Address of the string in the process
+    uint32_t len;          ///< Length of the string (without the final '\0')
+    uint32_t size;          ///< Size of the entry
+    char str[];          ///< The string (with its final '\0')
+} netlogg_rec_str;
+
+
+/**
+ * \brief      Create the eventfd used to wake up the consumer (from the consumer thread)
+ *
+ * \return     The eventfd file descriptor (to add in the epoll loop), -1 on error
+ */
+int netlogg_ring_init(void);
+
+
+/**
+ * \brief      Reserve a record in the ring (producer side)
+ *
+ * When the ring is full, NETLOGG_BP_DROP returns at once, NETLOGG_BP_BLOCK
+ * waits for the consumer up to timeout_ns and NETLOGG_BP_OVERWRITE drops the
+ * oldest records not read yet (the non critical ones only, for a non critical
+ * record). The consumer thread itself never waits.
+ *
+ * \param[in]  len         The payload length
+ * \param[in]  critical    The record may use the NETLOGG_RING_RESERVED bytes
+ * \param[in]  bp          What to do when the ring is full (not NETLOGG_BP_LEVEL)
+ * \param[in]  timeout_ns  Longest wait of NETLOGG_BP_BLOCK in nanoseconds
+ *
+ * \return     The record to fill (its len field is already set), NULL if the ring is full (the message is counted as dropped)
+ */
+netlogg_record* netlogg_ring_reserve(size_t len, int critical, Netlogging_backpressure bp, uint64_t timeout_ns);
+
+
+/**
+ * \brief      Publish a record previously reserved (producer side)
+ *
+ * The consumer is woken up through the eventfd only if it is sleeping.
+ *
+ * \param      rec   The record returned by netlogg_ring_reserve
+ */
+void netlogg_ring_commit(netlogg_record *rec);
+
+
+/**
+ * \brief      Get the oldest published record (consumer side)
+ *
+ * \return     The oldest record, NULL if there is nothing to read
+ */
+netlogg_record* netlogg_ring_peek(void);
+
+
+/**
+ * \brief      Give the record returned by netlogg_ring_peek back to the producers (consumer side)
+ */
+void netlogg_ring_release(void);
+
+
+/**
+ * \brief      Tell the producers that the consumer is going to sleep (consumer side)
+ *
+ * \return     1 if some records are already published (do not sleep), 0 otherwise
+ */
+int netlogg_ring_sleep(void);
+
+
+/**
+ * \brief      Tell the producers that the consumer is awake (consumer side)
+ */
+void netlogg_ring_wake(void);
+
+
+/**
+ * \brief      Acknowledge the wake up notification of the eventfd (consumer side)
+ */
+void netlogg_ring_ack(void);
+
+
+/**
+ * \brief      Move the ring into a flight recorder file, so that the records survive the process
+ *
+ * The file is created (or truncated), the header, the records already in the
+ * ring and the string table are written, then the file is mapped over the
+ * ring: the producers keep writing at the same addresses. Call it before the
+ * producers start, the records written during the switch may be lost.
+ *
+ * \param[in]  path        The file (e.g. in /dev/shm)
+ * \param[in]  strtab      The string table (netlogg_rec_str entries)
+ * \param[in]  strtab_len  Size of the string table
+ *
+ * \return     0 on success, -1 on error (errno is set, the ring stays in memory)
+ */
+int netlogg_ring_record(const char *path, const char *strtab, size_t strtab_len);
+
+
+/**
+ * \brief      Write the ring in the flight recorder format (async-signal-safe)
+ *
+ * Only write(2) is used, so that it can be called from a signal handler.
+ *
+ * \param[in]  fd    The file descriptor
+ *
+ * \return     0 on success, -1 on error
+ */
+int netlogg_ring_dump(int fd);
+
+
+/**
+ * \brief      Get and reset the number of messages dropped because the ring was full
+ *
+ * \return     Number of dropped messages since the last call
+ */
+uint64_t netlogg_ring_dropped(void);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif          // __NETLOGG_RING_H__
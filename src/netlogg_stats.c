@@ -0,0 +1,333 @@
+/**
+ * @file netlogg_stats.c
+ * @author hbuyse
+ * @date 16/10/2026
+ *
+ * The blocks of the threads are chained in a list that only grows: a reader
+ * walks it without lock while new threads push their block with a CAS. The
+ * block of a thread that exits is taken over by the next new thread, so that
+ * the counters never go back and the list stays as long as the largest
+ * number of threads alive at once.
+ */
+
+#include <stdio.h>          // snprintf
+#include <stdlib.h>          // calloc
+#include <string.h>          // memset
+#include <inttypes.h>          // PRIu64
+#include <pthread.h>          // pthread_once, pthread_key_create, pthread_setspecific
+
+#include "netlogg_stats.h"
+
+
+/**
+ * \brief Counters of a thread in the list of all the threads
+ */
+typedef struct netlogg_stats_block {
+    netlogg_stats st;          ///< Counters
+    struct netlogg_stats_block *next;          ///< Next block of the list
+    int free;          ///< The thread exited: the block can be taken by a new thread (atomic)
+} netlogg_stats_block;
+
+
+__thread netlogg_stats     *netlogg_stats_self  = NULL;
+
+
+/**
+ * \brief Blocks of all the threads (atomic)
+ */
+static netlogg_stats_block     *stats_blocks    = NULL;
+
+
+/**
+ * \brief Shared by the threads whose block could not be allocated (their updates may be lost)
+ */
+static netlogg_stats_block     stats_fallback;
+
+
+/**
+ * \brief Gives the block of a thread back when it exits
+ */
+static pthread_key_t     stats_key;
+static pthread_once_t    stats_once         = PTHREAD_ONCE_INIT;
+
+
+/**
+ * \brief Name of the levels (labels of the metrics)
+ */
+static const char     *stats_lvls[NETLOGG_LVLS] =
+{
+    "emerg", "alert", "crit", "error", "warn", "notice", "info", "debug"
+};
+
+
+
+/**
+ * \brief      Give the block of an exiting thread to the next new thread
+ *
+ * \param      arg   The block
+ */
+static void netlogg_stats_release(void *arg)
+{
+    netlogg_stats_block     *b = arg;
+
+
+    __atomic_store_n(&b->free, 1, __ATOMIC_RELEASE);
+}
+
+
+
+/**
+ * \brief      Create the key of the blocks (once)
+ */
+static void netlogg_stats_key_init(void)
+{
+    pthread_key_create(&stats_key, netlogg_stats_release);
+}
+
+
+
+netlogg_stats* netlogg_stats_register(void)
+{
+    netlogg_stats_block     *b      = NULL;
+    int                     one     = 1;
+
+
+    pthread_once(&stats_once, netlogg_stats_key_init);
+
+    // Take the block of a thread that exited
+    for ( b = __atomic_load_n(&stats_blocks, __ATOMIC_ACQUIRE); b != NULL; b = b->next )
+    {
+        one = 1;
+
+        if ( __atomic_compare_exchange_n(&b->free, &one, 0, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED) )
+        {
+            break;
+        }
+    }
+
+    if ( b == NULL )
+    {
+        b = calloc(1, sizeof(*b) );
+
+        if ( b == NULL )
+        {
+            netlogg_stats_self = &stats_fallback.st;
+
+            return (netlogg_stats_self);
+        }
+
+        b->next = __atomic_load_n(&stats_blocks, __ATOMIC_RELAXED);
+
+        while ( ! __atomic_compare_exchange_n(&stats_blocks, &b->next, b, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED) )
+        {
+        }
+    }
+
+    pthread_setspecific(stats_key, b);
+    netlogg_stats_self = &b->st;
+
+    return (netlogg_stats_self);
+}
+
+
+
+void netlogg_stats_latency(uint64_t ns)
+{
+    netlogg_stats   *st     = (netlogg_stats_self != NULL) ? netlogg_stats_self : netlogg_stats_register();
+    uint32_t        idx     = 0;
+    int             msb     = 0;
+
+
+    ns = (ns < (1ull << (NETLOGG_STATS_MAX_BIT + 1) ) ) ? ns : (1ull << (NETLOGG_STATS_MAX_BIT + 1) ) - 1;
+
+    // 2^SUB_BITS linear buckets for each power of two
+    if ( ns < (1u << NETLOGG_STATS_SUB_BITS) )
+    {
+        idx = ns;
+    }
+    else
+    {
+        msb = 63 - __builtin_clzll(ns);
+        idx = ( (msb - NETLOGG_STATS_SUB_BITS + 1) << NETLOGG_STATS_SUB_BITS) +
+              (uint32_t) ( (ns >> (msb - NETLOGG_STATS_SUB_BITS) ) - (1u << NETLOGG_STATS_SUB_BITS) );
+    }
+
+    __atomic_store_n(&st->lat[idx], st->lat[idx] + 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&st->lat_count, st->lat_count + 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&st->lat_sum, st->lat_sum + ns, __ATOMIC_RELAXED);
+}
+
+
+
+/**
+ * \brief      Add the counters of a thread to a sum
+ *
+ * \param      sum   The sum
+ * \param[in]  st    The counters of the thread
+ */
+static void netlogg_stats_sum(netlogg_stats         *sum,
+                              const netlogg_stats   *st
+                              )
+{
+    for ( int i = 0; i < NETLOGG_STAT_MAX; i++ )
+    {
+        sum->c[i] += __atomic_load_n(&st->c[i], __ATOMIC_RELAXED);
+    }
+
+    for ( int i = 0; i < NETLOGG_STATS_LAT_BUCKETS; i++ )
+    {
+        sum->lat[i] += __atomic_load_n(&st->lat[i], __ATOMIC_RELAXED);
+    }
+
+    sum->lat_count  += __atomic_load_n(&st->lat_count, __ATOMIC_RELAXED);
+    sum->lat_sum    += __atomic_load_n(&st->lat_sum, __ATOMIC_RELAXED);
+}
+
+
+
+void netlogg_stats_read(netlogg_stats *sum)
+{
+    netlogg_stats_block     *b = NULL;
+
+
+    memset(sum, 0, sizeof(*sum) );
+
+    for ( b = __atomic_load_n(&stats_blocks, __ATOMIC_ACQUIRE); b != NULL; b = b->next )
+    {
+        netlogg_stats_sum(sum, &b->st);
+    }
+
+    netlogg_stats_sum(sum, &stats_fallback.st);
+}
+
+
+
+/**
+ * \brief      Get the highest latency of a bucket of the histogram
+ *
+ * \param[in]  idx   The bucket
+ *
+ * \return     The latency (nanoseconds)
+ */
+static uint64_t netlogg_stats_bucket_max(uint32_t idx)
+{
+    uint32_t    group   = idx >> NETLOGG_STATS_SUB_BITS;
+    uint32_t    sub     = idx & ( (1u << NETLOGG_STATS_SUB_BITS) - 1);
+
+
+    if ( group == 0 )
+    {
+        return (idx);
+    }
+
+    // Group g covers [2^(g + SUB_BITS - 1), 2^(g + SUB_BITS)) in 2^SUB_BITS steps of 2^(g - 1)
+    return ( ( (uint64_t) ( (1u << NETLOGG_STATS_SUB_BITS) + sub + 1) << (group - 1) ) - 1);
+}
+
+
+
+uint64_t netlogg_stats_quantile(const netlogg_stats     *sum,
+                                double                  q
+                                )
+{
+    uint64_t    rank    = 0;
+    uint64_t    seen    = 0;
+
+
+    if ( sum->lat_count == 0 )
+    {
+        return (0);
+    }
+
+    rank = (uint64_t) (q * sum->lat_count);
+    rank = (rank < sum->lat_count) ? rank + 1 : sum->lat_count;
+
+    for ( uint32_t i = 0; i < NETLOGG_STATS_LAT_BUCKETS; i++ )
+    {
+        seen += sum->lat[i];
+
+        if ( seen >= rank )
+        {
+            return (netlogg_stats_bucket_max(i) );
+        }
+    }
+
+    return (netlogg_stats_bucket_max(NETLOGG_STATS_LAT_BUCKETS - 1) );
+}
+
+
+
+size_t netlogg_stats_prometheus(char                    *buff,
+                                size_t                  size,
+                                const netlogg_stats     *sum
+                                )
+{
+    size_t          w       = 0;
+    uint64_t        seen    = 0;
+    uint32_t        idx     = 0;
+
+
+#define PROM(...) \
+    do \
+    { \
+        w   += snprintf(buff + w, size - w, __VA_ARGS__); \
+        w   = (w < size) ? w : size - 1; \
+    } while ( 0 )
+
+    PROM("# HELP netlogging_messages_total Messages logged.\n# TYPE netlogging_messages_total counter\n");
+
+    for ( int l = 0; l < NETLOGG_LVLS; l++ )
+    {
+        PROM("netlogging_messages_total{level=\"%s\"} %" PRIu64 "\n", stats_lvls[l], sum->c[NETLOGG_STAT_MSGS + l]);
+    }
+
+    PROM("# HELP netlogging_bytes_total Bytes of the messages rendered, and given to the clients.\n# TYPE netlogging_bytes_total counter\n");
+    PROM("netlogging_bytes_total{stage=\"rendered\"} %" PRIu64 "\n", sum->c[NETLOGG_STAT_RENDERED_BYTES]);
+    PROM("netlogging_bytes_total{stage=\"sent\"} %" PRIu64 "\n", sum->c[NETLOGG_STAT_SENT_BYTES]);
+
+    PROM("# HELP netlogging_batches_total Batches of messages published to the workers.\n# TYPE netlogging_batches_total counter\n");
+    PROM("netlogging_batches_total %" PRIu64 "\n", sum->c[NETLOGG_STAT_BATCHES]);
+
+    PROM("# HELP netlogging_dropped_total Messages dropped.\n# TYPE netlogging_dropped_total counter\n");
+    PROM("netlogging_dropped_total{reason=\"ring_full\"} %" PRIu64 "\n", sum->c[NETLOGG_STAT_RING_DROPS]);
+    PROM("netlogging_dropped_total{reason=\"overwritten\"} %" PRIu64 "\n", sum->c[NETLOGG_STAT_RING_OVERWRITES]);
+    PROM("netlogging_dropped_total{reason=\"slow_client\"} %" PRIu64 "\n", sum->c[NETLOGG_STAT_CLIENT_DROPS]);
+    PROM("netlogging_dropped_total{reason=\"syslog\"} %" PRIu64 "\n", sum->c[NETLOGG_STAT_SYSLOG_DROPS]);
+    PROM("netlogging_dropped_total{reason=\"file\"} %" PRIu64 "\n", sum->c[NETLOGG_STAT_FILE_DROPS]);
+    PROM("netlogging_dropped_total{reason=\"rate_limit\"} %" PRIu64 "\n", sum->c[NETLOGG_STAT_RATE_DROPS]);
+
+    PROM("# HELP netlogging_ring_waits_total Messages whose producer waited for room in the ring.\n# TYPE netlogging_ring_waits_total counter\n");
+    PROM("netlogging_ring_waits_total %" PRIu64 "\n", sum->c[NETLOGG_STAT_RING_WAITS]);
+
+    PROM("# HELP netlogging_repeated_total Messages sent as \"last message repeated N times\".\n# TYPE netlogging_repeated_total counter\n");
+    PROM("netlogging_repeated_total %" PRIu64 "\n", sum->c[NETLOGG_STAT_REPEATS]);
+
+    PROM("# HELP netlogging_syscalls_total System calls made by the library.\n# TYPE netlogging_syscalls_total counter\n");
+    PROM("netlogging_syscalls_total{call=\"sendmsg\"} %" PRIu64 "\n", sum->c[NETLOGG_STAT_SC_SENDMSG]);
+    PROM("netlogging_syscalls_total{call=\"sendmmsg\"} %" PRIu64 "\n", sum->c[NETLOGG_STAT_SC_SENDMMSG]);
+    PROM("netlogging_syscalls_total{call=\"pwritev\"} %" PRIu64 "\n", sum->c[NETLOGG_STAT_SC_PWRITEV]);
+    PROM("netlogging_syscalls_total{call=\"epoll_wait\"} %" PRIu64 "\n", sum->c[NETLOGG_STAT_SC_EPOLL_WAIT]);
+    PROM("netlogging_syscalls_total{call=\"eventfd_write\"} %" PRIu64 "\n", sum->c[NETLOGG_STAT_SC_EVENTFD_WRITE]);
+
+    // The buckets of the histogram end on powers of two: one Prometheus bucket per power of two from 1us
+    PROM("# HELP netlogging_latency_seconds Time from the ring to the socket of a client (oldest message of each batch).\n"
+         "# TYPE netlogging_latency_seconds histogram\n");
+
+    for ( int bit = 10; bit <= NETLOGG_STATS_MAX_BIT; bit++ )
+    {
+        for ( ; (idx < NETLOGG_STATS_LAT_BUCKETS) && (netlogg_stats_bucket_max(idx) < (1ull << bit) ); idx++ )
+        {
+            seen += sum->lat[idx];
+        }
+
+        PROM("netlogging_latency_seconds_bucket{le=\"%.9g\"} %" PRIu64 "\n", (double) (1ull << bit) / 1e9, seen);
+    }
+
+    PROM("netlogging_latency_seconds_bucket{le=\"+Inf\"} %" PRIu64 "\n", sum->lat_count);
+    PROM("netlogging_latency_seconds_sum %.9f\n", sum->lat_sum / 1e9);
+    PROM("netlogging_latency_seconds_count %" PRIu64 "\n", sum->lat_count);
+
+#undef PROM
+
+    return (w);
+}
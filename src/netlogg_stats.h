@@ -0,0 +1,145 @@
+/**
+ * @file netlogg_stats.h
+ * @author hbuyse
+ * @date 16/10/2026
+ *
+ * Counters of the netlogging library itself. Each thread (producers,
+ * netlogging thread, workers, file thread) updates its own block without any
+ * lock nor atomic read-modify-write; the blocks are only summed when the
+ * counters are read (stats command, metrics endpoint).
+ */
+
+
+#ifndef __NETLOGG_STATS_H__
+#define __NETLOGG_STATS_H__
+
+#include <stdint.h>          // uint64_t
+#include <stddef.h>          // size_t
+
+#include "netlogging.h"          // NETLOGG_LVLS
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * \brief Counters (the messages have one counter per level)
+ */
+typedef enum {
+    NETLOGG_STAT_MSGS = 0,          ///< Messages put in the ring, NETLOGG_LVLS counters (producers)
+    NETLOGG_STAT_RING_DROPS = NETLOGG_STAT_MSGS + NETLOGG_LVLS,          ///< Messages dropped because the ring was full (producers)
+    NETLOGG_STAT_RING_OVERWRITES,          ///< Messages not rendered yet dropped to make room for new ones (NETLOGG_BP_OVERWRITE)
+    NETLOGG_STAT_RING_WAITS,          ///< Messages whose producer waited for room in the ring (NETLOGG_BP_BLOCK)
+    NETLOGG_STAT_RENDERED_BYTES,          ///< Bytes of the rendered messages (netlogging thread)
+    NETLOGG_STAT_BATCHES,          ///< Batches published to the workers (netlogging thread)
+    NETLOGG_STAT_SENT_BYTES,          ///< Bytes given to the sockets of the clients (workers)
+    NETLOGG_STAT_CLIENT_DROPS,          ///< Messages dropped because a client was too slow (workers)
+    NETLOGG_STAT_SYSLOG_DROPS,          ///< Messages dropped because the syslog socket was full or closed
+    NETLOGG_STAT_FILE_DROPS,          ///< Messages dropped because the file was not written fast enough
+    NETLOGG_STAT_RATE_DROPS,          ///< Messages dropped because their call site was over its rate limit (producers)
+    NETLOGG_STAT_REPEATS,          ///< Messages only counted in a "last message repeated" message (netlogging thread)
+    NETLOGG_STAT_SC_SENDMSG,          ///< sendmsg calls (clients)
+    NETLOGG_STAT_SC_SENDMMSG,          ///< sendmmsg calls (syslog)
+    NETLOGG_STAT_SC_PWRITEV,          ///< pwritev calls (file)
+    NETLOGG_STAT_SC_EPOLL_WAIT,          ///< epoll_wait calls (netlogging thread and workers)
+    NETLOGG_STAT_SC_EVENTFD_WRITE,          ///< eventfd_write calls (wake up of the netlogging thread and of the workers)
+    NETLOGG_STAT_MAX
+} netlogg_stat;
+
+
+/**
+ * \brief Latency histogram: 2^NETLOGG_STATS_SUB_BITS buckets per power of two (12.5% precision) up to 2^NETLOGG_STATS_MAX_BIT ns
+ */
+#define NETLOGG_STATS_SUB_BITS      3
+#define NETLOGG_STATS_MAX_BIT       40
+#define NETLOGG_STATS_LAT_BUCKETS   ( (NETLOGG_STATS_MAX_BIT - NETLOGG_STATS_SUB_BITS + 2) << NETLOGG_STATS_SUB_BITS)
+
+
+/**
+ * \brief Counters of a thread, or their sum
+ */
+typedef struct {
+    uint64_t c[NETLOGG_STAT_MAX];          ///< Counters
+    uint64_t lat[NETLOGG_STATS_LAT_BUCKETS];          ///< Latencies from the ring to the socket of a client (nanoseconds)
+    uint64_t lat_count;          ///< Number of latencies
+    uint64_t lat_sum;          ///< Sum of the latencies (nanoseconds)
+} netlogg_stats;
+
+
+/**
+ * \brief Counters of the calling thread (NULL until its first counter)
+ */
+extern __thread netlogg_stats     *netlogg_stats_self;
+
+
+/**
+ * \brief      Get the counters of the calling thread, registered on the first call
+ *
+ * \return     The counters of the thread
+ */
+netlogg_stats* netlogg_stats_register(void);
+
+
+/**
+ * \brief      Add to a counter of the calling thread (only written by this thread: no atomic read-modify-write)
+ *
+ * \param[in]  s     The counter
+ * \param[in]  n     The value added
+ */
+static inline void netlogg_stats_add(netlogg_stat s, uint64_t n) __attribute__( (always_inline) );
+static inline void netlogg_stats_add(netlogg_stat   s,
+                                     uint64_t       n
+                                     )
+{
+    netlogg_stats     *st = (netlogg_stats_self != NULL) ? netlogg_stats_self : netlogg_stats_register();
+
+
+    __atomic_store_n(&st->c[s], st->c[s] + n, __ATOMIC_RELAXED);
+}
+
+
+/**
+ * \brief      Add a latency to the histogram of the calling thread
+ *
+ * \param[in]  ns    The latency (nanoseconds)
+ */
+void netlogg_stats_latency(uint64_t ns);
+
+
+/**
+ * \brief      Sum the counters of all the threads
+ *
+ * \param      sum   The sum
+ */
+void netlogg_stats_read(netlogg_stats *sum);
+
+
+/**
+ * \brief      Get a quantile of the latencies
+ *
+ * \param[in]  sum   The counters
+ * \param[in]  q     The quantile (0.5 for the median)
+ *
+ * \return     The highest latency of the bucket of the quantile (nanoseconds), 0 without latencies
+ */
+uint64_t netlogg_stats_quantile(const netlogg_stats *sum, double q);
+
+
+/**
+ * \brief      Render the counters in the text format of Prometheus
+ *
+ * \param      buff  The buffer
+ * \param[in]  size  The buffer size
+ * \param[in]  sum   The counters
+ *
+ * \return     Number of bytes written in buff (at most size - 1, nul terminated)
+ */
+size_t netlogg_stats_prometheus(char *buff, size_t size, const netlogg_stats *sum);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif          // __NETLOGG_STATS_H__
@@ -0,0 +1,293 @@
+/**
+ * @file netlogg_syslog.c
+ * @author hbuyse
+ * @date 16/10/2026
+ *
+ * Replaces syslog(3) on the netlogging thread: syslog(3) takes the lock of the
+ * libc and blocks on /dev/log when the daemon is late. Here the messages are
+ * copied in a batch buffer and sent with one sendmmsg, without waiting: the
+ * messages the socket does not take are counted and dropped.
+ */
+
+#include <stdio.h>          // snprintf
+#include <stdlib.h>          // abs
+#include <string.h>          // memcpy, strrchr, strncpy
+#include <errno.h>          // errno, EINTR, EAGAIN
+#include <time.h>          // localtime_r, strftime
+#include <unistd.h>          // close, getpid, gethostname
+#include <sys/socket.h>          // socket, connect, sendmmsg
+#include <sys/uio.h>          // struct iovec
+#include <sys/un.h>          // struct sockaddr_un
+
+#include "netlogg_syslog.h"
+#include "netlogg_ring.h"          // BUFF_SIZE_MAX
+#include "netlogg_stats.h"          // netlogg_stats_add
+
+
+#define SYSLOG_BATCH          64          // Datagrams sent by one sendmmsg
+#define SYSLOG_BUFF_SIZE      (64 * 1024)          // Bytes of the messages of a batch
+#define SYSLOG_HDR_MAX        384          // Longest RFC 5424 header (PRI, VERSION, TIMESTAMP, HOSTNAME...)
+#define SYSLOG_FACILITY       LOG_USER
+
+
+/**
+ * \brief Socket connected to NETLOGG_SYSLOG_PATH (-1: not connected)
+ */
+static int     syslog_fd            = -1;
+
+
+/**
+ * \brief Second of the last connection attempt (at most one per second)
+ */
+static time_t     syslog_retry_sec  = 0;
+
+
+/**
+ * \brief HOSTNAME, APP-NAME and PROCID fields, shared by all the messages
+ */
+static char     syslog_ids[256]     = "";
+
+
+/**
+ * \brief Second of the cached timestamp
+ */
+static time_t     syslog_ts_sec     = -1;
+
+
+/**
+ * \brief Date and time of the cached timestamp ("2026-10-16T12:29:39")
+ */
+static char     syslog_ts_buff[32]  = "";
+
+
+/**
+ * \brief Offset to UTC of the cached timestamp ("+02:00")
+ */
+static char     syslog_ts_off[32]   = "";
+
+
+/**
+ * \brief Messages of the current batch
+ */
+static char     syslog_buff[SYSLOG_BUFF_SIZE];
+
+
+/**
+ * \brief Bytes used in syslog_buff
+ */
+static size_t     syslog_used       = 0;
+
+
+/**
+ * \brief Datagrams of the current batch
+ */
+static struct iovec     syslog_iov[SYSLOG_BATCH];
+static struct mmsghdr   syslog_msgs[SYSLOG_BATCH];
+
+
+/**
+ * \brief Number of datagrams in the current batch
+ */
+static uint32_t     syslog_nb       = 0;
+
+
+/**
+ * \brief Messages dropped since the last report
+ */
+static uint64_t     syslog_dropped  = 0;
+
+
+/**
+ * \brief Set while the socket does not take the messages
+ */
+static int     syslog_full          = 0;
+
+
+
+/**
+ * \brief      Connect the socket to the syslog daemon
+ *
+ * \return     0 on success, -1 on error
+ */
+static int netlogg_syslog_connect(void)
+{
+    struct sockaddr_un     addr;
+
+
+    syslog_fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+    if ( syslog_fd == -1 )
+    {
+        return (-1);
+    }
+
+    memset(&addr, 0, sizeof(addr) );
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, NETLOGG_SYSLOG_PATH, sizeof(addr.sun_path) - 1);
+
+    if ( connect(syslog_fd, (struct sockaddr *) &addr, sizeof(addr) ) == -1 )
+    {
+        close(syslog_fd);
+        syslog_fd = -1;
+
+        return (-1);
+    }
+
+    return (0);
+}
+
+
+
+void netlogg_syslog_init(const char *progname)
+{
+    char            hostname[128]   = "-";
+    const char      *app            = strrchr(progname, '/');
+
+
+    app = (app != NULL) ? app + 1 : progname;
+
+    if ( (gethostname(hostname, sizeof(hostname) ) == -1) || (hostname[0] == '\0') )
+    {
+        strcpy(hostname, "-");
+    }
+
+    hostname[sizeof(hostname) - 1] = '\0';
+
+    // APP-NAME is at most 48 characters
+    snprintf(syslog_ids, sizeof(syslog_ids), "%s %.48s %d", hostname, (app[0] != '\0') ? app : "-", (int) getpid() );
+
+    for ( uint32_t i = 0; i < SYSLOG_BATCH; i++ )
+    {
+        syslog_msgs[i].msg_hdr.msg_iov      = &syslog_iov[i];
+        syslog_msgs[i].msg_hdr.msg_iovlen   = 1;
+    }
+}
+
+
+
+void netlogg_syslog_add(Netlogging_lvl  lvl,
+                        uint64_t        ts,
+                        const char      *msg,
+                        size_t          len
+                        )
+{
+    struct tm       info;
+    time_t          sec     = ts / 1000000000ull;
+    char            *buff   = NULL;
+    int             w       = 0;
+    int             off     = 0;
+
+
+    len = (len < BUFF_SIZE_MAX) ? len : BUFF_SIZE_MAX;
+
+    if ( (syslog_nb == SYSLOG_BATCH) || (syslog_used + SYSLOG_HDR_MAX + len > SYSLOG_BUFF_SIZE) )
+    {
+        netlogg_syslog_flush();
+    }
+
+    // The date only changes once per second
+    if ( sec != syslog_ts_sec )
+    {
+        localtime_r(&sec, &info);
+
+        strftime(syslog_ts_buff, sizeof(syslog_ts_buff), "%Y-%m-%dT%H:%M:%S", &info);
+
+        off = info.tm_gmtoff / 60;
+        snprintf(syslog_ts_off, sizeof(syslog_ts_off), "%c%02d:%02d", (off < 0) ? '-' : '+', abs(off) / 60, abs(off) % 60);
+
+        syslog_ts_sec = sec;
+    }
+
+    // <PRI>VERSION TIMESTAMP HOSTNAME APP-NAME PROCID MSGID STRUCTURED-DATA MSG
+    buff    = syslog_buff + syslog_used;
+    w       = snprintf(buff, SYSLOG_HDR_MAX, "<%d>1 %s.%06u%s %s - - ", SYSLOG_FACILITY | lvl, syslog_ts_buff,
+                       (unsigned int) ( (ts % 1000000000ull) / 1000), syslog_ts_off, syslog_ids);
+    w       = (w < SYSLOG_HDR_MAX) ? w : SYSLOG_HDR_MAX - 1;
+
+    memcpy(buff + w, msg, len);
+
+    syslog_iov[syslog_nb].iov_base  = buff;
+    syslog_iov[syslog_nb].iov_len   = w + len;
+    syslog_nb++;
+    syslog_used                     += w + len;
+}
+
+
+
+void netlogg_syslog_flush(void)
+{
+    uint32_t        sent    = 0;
+    int             res     = 0;
+    struct timespec now;
+
+
+    if ( syslog_nb == 0 )
+    {
+        return;
+    }
+
+    if ( syslog_fd == -1 )
+    {
+        clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+
+        if ( now.tv_sec != syslog_retry_sec )
+        {
+            syslog_retry_sec = now.tv_sec;
+            netlogg_syslog_connect();
+        }
+    }
+
+    while ( (syslog_fd != -1) && (sent < syslog_nb) )
+    {
+        res = sendmmsg(syslog_fd, syslog_msgs + sent, syslog_nb - sent, MSG_DONTWAIT | MSG_NOSIGNAL);
+        netlogg_stats_add(NETLOGG_STAT_SC_SENDMMSG, 1);
+
+        if ( res > 0 )
+        {
+            sent += res;
+        }
+        else if ( (res == -1) && (errno == EINTR) )
+        {
+            continue;
+        }
+        else if ( (res == -1) && ( (errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == ENOBUFS) ) )
+        {
+            // The daemon is late: never wait for it
+            break;
+        }
+        else
+        {
+            // The daemon is gone (restarted or stopped): connect again later
+            close(syslog_fd);
+            syslog_fd = -1;
+        }
+    }
+
+    // Counted now, even while the report waits for the daemon to take the messages again
+    if ( sent < syslog_nb )
+    {
+        netlogg_stats_add(NETLOGG_STAT_SYSLOG_DROPS, syslog_nb - sent);
+    }
+
+    syslog_full     = (sent < syslog_nb);
+    syslog_dropped  += syslog_nb - sent;
+    syslog_nb       = 0;
+    syslog_used     = 0;
+}
+
+
+
+uint64_t netlogg_syslog_dropped(void)
+{
+    uint64_t     dropped = syslog_dropped;
+
+
+    if ( syslog_full )
+    {
+        return (0);
+    }
+
+    syslog_dropped = 0;
+
+    return (dropped);
+}
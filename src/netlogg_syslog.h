@@ -0,0 +1,72 @@
+/**
+ * @file netlogg_syslog.h
+ * @author hbuyse
+ * @date 16/10/2026
+ *
+ * Syslog sink of the netlogging thread: the messages are formatted following
+ * RFC 5424 and sent by batches of datagrams to a non-blocking /dev/log socket.
+ */
+
+
+#ifndef __NETLOGG_SYSLOG_H__
+#define __NETLOGG_SYSLOG_H__
+
+#include <stdint.h>          // uint64_t
+#include <stddef.h>          // size_t
+
+#include "netlogging.h"          // Netlogging_lvl
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * \brief Socket of the local syslog daemon
+ */
+#ifndef NETLOGG_SYSLOG_PATH
+    #define NETLOGG_SYSLOG_PATH     "/dev/log"
+#endif
+
+
+/**
+ * \brief      Prepare the syslog sink (the socket is connected when the first message is sent)
+ *
+ * \param[in]  progname  The name of the program (APP-NAME of the messages)
+ */
+void netlogg_syslog_init(const char *progname);
+
+
+/**
+ * \brief      Add a message to the current batch (sent when it is full or by netlogg_syslog_flush)
+ *
+ * \param[in]  lvl   The level of the message
+ * \param[in]  ts    Its timestamp (nanoseconds since the Epoch)
+ * \param[in]  msg   The text of the message
+ * \param[in]  len   Its length
+ */
+void netlogg_syslog_add(Netlogging_lvl lvl, uint64_t ts, const char *msg, size_t len);
+
+
+/**
+ * \brief      Send the current batch without blocking (the messages the socket cannot take are dropped)
+ */
+void netlogg_syslog_flush(void);
+
+
+/**
+ * \brief      Get and reset the number of messages dropped because the socket was full or closed
+ *
+ * Nothing is returned while the socket is still full, so that reporting the
+ * drops does not drop more messages.
+ *
+ * \return     Number of dropped messages since the last call
+ */
+uint64_t netlogg_syslog_dropped(void);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif          // __NETLOGG_SYSLOG_H__
@@ -0,0 +1,307 @@
+/**
+ * @file netlogg_test_allocs.c
+ * @author hbuyse
+ * @date 16/10/2026
+ *
+ * Test run by `make check`: once warmed up, the library sends one million
+ * messages to two clients reading them and to a client that never reads,
+ * without a single call to the allocator. The allocations of the whole
+ * process are counted by wrapping the allocator (see netlogg_allocs.c): the
+ * test itself does not allocate while the messages are sent.
+ *
+ * Environment: TEST_PORT (65433), TEST_MSGS (messages counted, 1000000).
+ */
+
+#include <stdio.h>          // printf, perror
+#include <stdlib.h>          // getenv, atoi
+#include <string.h>          // memchr, strlen
+#include <errno.h>          // errno
+#include <time.h>          // clock_gettime, nanosleep
+#include <unistd.h>          // close
+#include <pthread.h>          // pthread_create
+#include <sched.h>          // sched_yield
+#include <inttypes.h>          // PRIu64
+#include <sys/socket.h>          // socket, connect, recv, send
+#include <netinet/in.h>          // struct sockaddr_in
+#include <arpa/inet.h>          // htons, htonl
+
+#include "netlogging.h"          // netlogg_init, netlogg_send_site
+#include "netlogg_allocs.h"          // netlogg_allocs
+
+
+#define PORT_DFT            65433
+#define MSGS_DFT            1000000
+#define WARMUP_MSGS         100000          // Messages sent before the allocations are counted (pools, queues)
+#define READERS             2          // Clients reading the messages
+#define SETTLE_MS           300          // Time given to the clients to connect and change their level
+#define QUIET_MS            500          // The messages are all sent when the clients received nothing for this long
+#define PAYLOAD             "abcdefghijklmnopqrstuvwxyz0123456789"
+
+
+/**
+ * \brief Client reading the messages in its own thread
+ */
+typedef struct {
+    pthread_t thread;          ///< Thread reading the client
+    int fd;          ///< Connection to the netlogging thread
+    uint64_t msgs;          ///< Lines received (atomic)
+} test_client;
+
+
+/**
+ * \brief Port of the netlogging thread
+ */
+static uint16_t     gPort           = PORT_DFT;
+
+
+/**
+ * \brief Call site of the messages sent without the level checks of NETLOGG
+ */
+static netlogg_site     test_site     = {__FILE__, "test %u %s", __LINE__, NETLOGG_INFO, 0, NETLOGG_BP_LEVEL};
+
+
+
+
+/*
+ *============================================================================
+ * sleep_ms
+ *============================================================================
+ */
+static void sleep_ms(uint32_t ms)
+{
+    struct timespec     ts = {ms / 1000, (ms % 1000) * 1000000l};
+
+
+    while ( (nanosleep(&ts, &ts) == -1) && (errno == EINTR) )
+    {
+    }
+}
+
+
+
+
+/*
+ *============================================================================
+ * env_u32
+ *============================================================================
+ */
+static uint32_t env_u32(const char  *name,
+                        uint32_t    dft
+                        )
+{
+    const char     *val = getenv(name);
+
+
+    return ( (val != NULL) && (atoi(val) > 0) ? (uint32_t) atoi(val) : dft);
+}
+
+
+
+
+/*
+ *============================================================================
+ * client_connect
+ *============================================================================
+ */
+static int client_connect(const char *cmd)
+{
+    struct sockaddr_in  addr;
+    int                 fd  = socket(AF_INET, SOCK_STREAM, 0);
+
+
+    if ( fd == -1 )
+    {
+        return (-1);
+    }
+
+    memset(&addr, 0, sizeof(addr) );
+    addr.sin_family         = AF_INET;
+    addr.sin_port           = htons(gPort);
+    addr.sin_addr.s_addr    = htonl(INADDR_LOOPBACK);
+
+    if ( (connect(fd, (struct sockaddr *) &addr, sizeof(addr) ) == -1) || (send(fd, cmd, strlen(cmd), 0) == -1) )
+    {
+        close(fd);
+
+        return (-1);
+    }
+
+    return (fd);
+}
+
+
+
+
+/*
+ *============================================================================
+ * client_run
+ *============================================================================
+ */
+static void* client_run(void *arg)
+{
+    test_client     *c      = arg;
+    char            buff[64 * 1024];
+    ssize_t         r       = 0;
+    const char      *p      = NULL;
+    uint64_t        lines   = 0;
+
+
+    while ( (r = recv(c->fd, buff, sizeof(buff), 0) ) > 0 )
+    {
+        for ( lines = 0, p = buff; (p = memchr(p, '\n', buff + r - p) ) != NULL; p++ )
+        {
+            lines++;
+        }
+
+        __atomic_add_fetch(&c->msgs, lines, __ATOMIC_RELAXED);
+    }
+
+    return (NULL);
+}
+
+
+
+
+/*
+ *============================================================================
+ * send_all
+ *============================================================================
+ */
+static void send_all(test_client    *readers,
+                     uint32_t       msgs
+                     )
+{
+    uint64_t        total   = 0;
+    uint64_t        prev    = UINT64_MAX;
+    uint32_t        quiet   = 0;
+
+
+    // netlogg_send_site tells when the ring is full: wait for the netlogging thread instead of dropping
+    for ( uint32_t i = 0; i < msgs; i++ )
+    {
+        while ( netlogg_send_site(&test_site, -1, i, PAYLOAD) != 0 )
+        {
+            sched_yield();
+        }
+    }
+
+    // Until the readers received nothing for QUIET_MS
+    while ( quiet < QUIET_MS )
+    {
+        total = 0;
+
+        for ( uint32_t i = 0; i < READERS; i++ )
+        {
+            total += __atomic_load_n(&readers[i].msgs, __ATOMIC_RELAXED);
+        }
+
+        quiet   = (total == prev) ? quiet + 1 : 0;
+        prev    = total;
+        sleep_ms(1);
+    }
+}
+
+
+
+
+/*
+ *============================================================================
+ * main
+ *============================================================================
+ */
+int main(int    argc,
+         char   **argv
+         )
+{
+    pthread_t           th;
+    test_client         readers[READERS];
+    int                 stalled     = -1;
+    uint32_t            msgs        = env_u32("TEST_MSGS", MSGS_DFT);
+    uint64_t            allocs      = 0;
+    uint64_t            received    = 0;
+    Netlogging_args     args        =
+    {
+        .progname   = argv[0],
+        .dft_lvl    = NETLOGG_EMERG          // Keep the messages away from the syslog
+    };
+
+
+    (void) argc;
+
+    gPort       = env_u32("TEST_PORT", PORT_DFT);
+    args.port   = gPort;
+
+    if ( pthread_create(&th, NULL, netlogg_init, &args) != 0 )
+    {
+        perror("pthread_create");
+
+        return (1);
+    }
+
+    sleep_ms(SETTLE_MS);
+
+    memset(readers, 0, sizeof(readers) );
+
+    for ( uint32_t i = 0; i < READERS; i++ )
+    {
+        readers[i].fd = client_connect("loglevel info\r\n");
+
+        if ( (readers[i].fd == -1) || (pthread_create(&readers[i].thread, NULL, client_run, &readers[i]) != 0) )
+        {
+            perror("connect");
+
+            return (1);
+        }
+    }
+
+    // Its output queue fills up and drops the oldest messages
+    stalled = client_connect("loglevel info\r\n");
+
+    if ( stalled == -1 )
+    {
+        perror("connect");
+
+        return (1);
+    }
+
+    sleep_ms(SETTLE_MS);
+
+    // The pools and the queues reach their size
+    send_all(readers, WARMUP_MSGS);
+
+    for ( uint32_t i = 0; i < READERS; i++ )
+    {
+        received -= __atomic_load_n(&readers[i].msgs, __ATOMIC_RELAXED);
+    }
+
+    allocs = netlogg_allocs();
+    send_all(readers, msgs);
+    allocs = netlogg_allocs() - allocs;
+
+    for ( uint32_t i = 0; i < READERS; i++ )
+    {
+        received += __atomic_load_n(&readers[i].msgs, __ATOMIC_RELAXED);
+    }
+
+    printf("%" PRIu32 " messages sent, %" PRIu64 " received by %d clients, %" PRIu64 " allocations\n",
+           msgs, received, READERS, allocs);
+
+    // Nothing received would prove nothing
+    if ( received < (uint64_t) msgs * READERS )
+    {
+        printf("FAIL: the clients did not receive every message\n");
+
+        return (1);
+    }
+
+    if ( allocs != 0 )
+    {
+        printf("FAIL: the library allocated while sending the messages\n");
+
+        return (1);
+    }
+
+    close(stalled);
+
+    return (0);
+}
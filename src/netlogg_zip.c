@@ -0,0 +1,85 @@
+/**
+ * @file netlogg_zip.c
+ * @author hbuyse
+ * @date 16/10/2026
+ *
+ * The fastest level of deflate is used: the messages are compressed by the
+ * netlogging thread (clients) or by the file thread, where the speed matters
+ * more than the last percents of ratio.
+ */
+
+#include <string.h>          // memset
+
+#include "netlogg_zip.h"
+
+
+#define ZIP_LEVEL             Z_BEST_SPEED
+#define ZIP_WINDOW_BITS       (15 + 16)          // Largest window, with a gzip header and trailer
+#define ZIP_MEM_LEVEL         8
+
+
+
+int netlogg_zip_init(netlogg_zip *z)
+{
+    memset(z, 0, sizeof(*z) );
+
+    if ( deflateInit2(&z->zs, ZIP_LEVEL, Z_DEFLATED, ZIP_WINDOW_BITS, ZIP_MEM_LEVEL, Z_DEFAULT_STRATEGY) != Z_OK )
+    {
+        return (-1);
+    }
+
+    z->ready = 1;
+
+    return (0);
+}
+
+
+
+size_t netlogg_zip_bound(netlogg_zip   *z,
+                         size_t        len
+                         )
+{
+    return (deflateBound(&z->zs, len) );
+}
+
+
+
+size_t netlogg_zip_member(netlogg_zip           *z,
+                          char                  *out,
+                          size_t                size,
+                          const struct iovec    *iov,
+                          uint32_t              iovcnt
+                          )
+{
+    int     res = Z_OK;
+
+
+    if ( ! z->ready || (deflateReset(&z->zs) != Z_OK) )
+    {
+        return (0);
+    }
+
+    z->zs.next_out  = (Bytef *) out;
+    z->zs.avail_out = size;
+
+    for ( uint32_t i = 0; i < iovcnt; i++ )
+    {
+        z->zs.next_in   = (Bytef *) iov[i].iov_base;
+        z->zs.avail_in  = iov[i].iov_len;
+
+        while ( z->zs.avail_in != 0 )
+        {
+            if ( (deflate(&z->zs, Z_NO_FLUSH) != Z_OK) || (z->zs.avail_out == 0) )
+            {
+                return (0);
+            }
+        }
+    }
+
+    do
+    {
+        res = deflate(&z->zs, Z_FINISH);
+    } while ( res == Z_OK );
+
+    return ( (res == Z_STREAM_END) ? size - z->zs.avail_out : 0);
+}
@@ -0,0 +1,74 @@
+/**
+ * @file netlogg_zip.h
+ * @author hbuyse
+ * @date 16/10/2026
+ *
+ * Compression of the messages in gzip members: each call gives a complete
+ * member, and gzip members put one after the other are a valid gzip stream.
+ * A reader can then lose whole members (a slow client dropping its oldest
+ * messages, a rotated file) without breaking the stream.
+ */
+
+
+#ifndef __NETLOGG_ZIP_H__
+#define __NETLOGG_ZIP_H__
+
+#include <stdint.h>          // uint32_t
+#include <stddef.h>          // size_t
+#include <sys/uio.h>          // struct iovec
+#include <zlib.h>          // z_stream
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * \brief Compression context (reused for every member, allocated once)
+ */
+typedef struct {
+    z_stream zs;          ///< Deflate stream of zlib
+    int ready;          ///< Set once the stream is initialized
+} netlogg_zip;
+
+
+/**
+ * \brief      Initialize a compression context
+ *
+ * \param      z     The context
+ *
+ * \return     0 on success, -1 on error
+ */
+int netlogg_zip_init(netlogg_zip *z);
+
+
+/**
+ * \brief      Get the largest member produced for some bytes
+ *
+ * \param      z     The context
+ * \param[in]  len   The number of bytes to compress
+ *
+ * \return     The size of the member in the worst case
+ */
+size_t netlogg_zip_bound(netlogg_zip *z, size_t len);
+
+
+/**
+ * \brief      Compress messages in one gzip member
+ *
+ * \param      z       The context
+ * \param      out     The member
+ * \param[in]  size    The size of out (see netlogg_zip_bound)
+ * \param[in]  iov     The messages
+ * \param[in]  iovcnt  The number of messages
+ *
+ * \return     The size of the member, 0 on error
+ */
+size_t netlogg_zip_member(netlogg_zip *z, char *out, size_t size, const struct iovec *iov, uint32_t iovcnt);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif          // __NETLOGG_ZIP_H__
@@ -17,11 +17,24 @@
 #include <unistd.h>             // close
 #include <netdb.h>              // getnameinfo
 #include <errno.h>              // errno
-#include <time.h>               // time_t, struct tm, time, localtime, strftime
-#include <sys/time.h>           // gettimeofday, struct timeval
-#include <syslog.h>               /// openlog, syslog, closelog
+#include <time.h>               // clock_gettime, struct tm, localtime_r, strftime
+#include <inttypes.h>           // PRIu64
+#include <limits.h>             // IOV_MAX
+#include <sys/uio.h>            // struct iovec
+#include <sys/eventfd.h>        // eventfd, eventfd_read, eventfd_write
+#include <pthread.h>            // pthread_create, pthread_mutex_lock
+#include <endian.h>             // htole16, htole32, htole64
 
 #include "netlogging.h"          // Netlogging_lvl
+#include "netlogg_ring.h"          // netlogg_record, netlogg_ring_reserve, netlogg_ring_commit
+#include "netlogg_fmt.h"          // netlogg_fmt_capture, netlogg_fmt_render
+#include "netlogg_syslog.h"          // netlogg_syslog_add, netlogg_syslog_flush
+#include "netlogg_file.h"          // netlogg_file_add, netlogg_file_flush
+#include "netlogg_zip.h"          // netlogg_zip_member
+#include "netlogg_stats.h"          // netlogg_stats_add, netlogg_stats_read
+#include "netlogg_filter.h"          // netlogg_filter_get, netlogg_filter_match
+#include "netlogg_ratelimit.h"          // netlogg_ratelimit_check, netlogg_ratelimit_set
+#include "netlogg_levels.h"          // netlogg_levels_get, netlogg_levels_set
 
 
 #ifndef INET4_ADDRSTRLEN
@@ -30,38 +43,87 @@
 
 #define NBELEMS(e)              (sizeof(e) / sizeof(e[0]) )
 
-#define BUFF_SIZE_MAX         4096
 #define HOSTNAME_MAX_SIZE     256
 #define SERVICE_MAX_SIZE      256
 #define DESCRIPTION_MAX_SIZE  1024
 
-#define NETLOGG_BACK(...)        netlogg_send(__FILE__, __LINE__, __VA_ARGS__)
+#define NETLOGG_BACK(...)        NETLOGG_TO(__VA_ARGS__)
 
 #define MAXEVENTS 64
 
+#define CLIENTS_CHUNK           64          // Client contexts allocated at once by the pool
+#define MAX_CLIENTS_DFT         1024          // Default limit of connected clients
+#define SUB_NONE                UINT32_MAX          // The client is not in a level list
+
+#define OUT_QUEUE_MSGS          1024          // Messages waiting for a slow client (power of two)
+#define OUT_QUEUE_SIZE_DFT      (256 * 1024)          // Bytes waiting for a slow client
+#define OUT_QUEUE_IOV           64          // Messages of the output queue sent by one sendmsg
+
+#define OUT_QUEUE_SLABS         4          // Slabs kept by the output queue of a client before its messages are copied
+
+#define SLAB_SIZE               (128 * 1024)          // Buffer of rendered messages (power of two, it is also its alignment)
+#define SLAB_OF(ptr)            ( (netlogg_slab *) ( (uintptr_t) (ptr) & ~( (uintptr_t) SLAB_SIZE - 1) ) )
+
+#define BATCH_SIZE_DFT          256          // Records rendered before the clients are written
+#define BATCH_BYTES_DFT         (64 * 1024)          // Bytes rendered before the clients are written
+
+#define BATCH_SLABS             4          // Slabs referenced by a batch
+
+#define ZIP_MEMBER_SIZE         (64 * 1024)          // Bytes compressed in one member at most (the batch is published before)
+#define BATCH_ZSLABS            (NETLOGG_LVLS + 1)          // Slabs holding the members of a batch (one per level at most)
+
+#define FRAME_FILE_MAX          255          // Longest file name sent inline in a binary frame
+#define FRAME_SIZE_MAX          (sizeof(netlogg_frame) + FRAME_FILE_MAX + 1 + BUFF_SIZE_MAX)          // Longest binary frame
+
+#define JOBS_CHUNK              64          // Jobs allocated at once in the inbox of a worker
+
+#define HISTORY_MSGS_DFT        16384          // Messages kept in the history
+#define HISTORY_MSGS_MAX        (1u << 24)          // Most messages kept in the history (a power of two)
+#define HISTORY_SIZE_DFT        (8 * 1024 * 1024)          // Bytes of slabs kept by the history
+#define FILE_KEEP_DFT           5          // Rotated files kept
+
+#define BLOCK_TIMEOUT_US_DFT    1000          // Longest wait of a producer for room in the ring (NETLOGG_BP_BLOCK)
+
+#define METRICS_BUFF_SIZE       (64 * 1024)          // Largest answer of the metrics endpoint
+#define METRICS_CONNS_MAX       16          // Connections of the metrics endpoint waiting for their request, the next ones are closed
+#define METRICS_TIMEOUT_MS      2000          // A connection of the metrics endpoint sending no request for this long is closed
+
+#define REPEAT_FLUSH_MS         1000          // Repeats of a message counted before "last message repeated" is sent
+
 
 typedef enum {
     EPOLL_FD_LISTEN = 0,
     EPOLL_FD_RECV,
-    EPOLL_FD_SEND0,
-    EPOLL_FD_SEND1,
-    EPOLL_FD_SEND2,
-    EPOLL_FD_SEND3,
-    EPOLL_FD_SEND4,
-    EPOLL_FD_SEND5,
-    EPOLL_FD_SEND6,
-    EPOLL_FD_SEND7,
-    EPOLL_FD_SEND8,
-    EPOLL_FD_SEND9,
+    EPOLL_FD_METRICS,
     EPOLL_FD_MAX,
 } epoll_evt_t;
 
 
+/**
+ * \brief Refcounted buffer of rendered messages, shared by the batches and the output queues of the clients
+ *
+ * The slabs are SLAB_SIZE aligned: the slab of a message is found from its
+ * address (SLAB_OF).
+ */
+typedef struct netlogg_slab {
+    uint32_t refs;          ///< Batches, queued messages and writer using the slab (atomic)
+    uint32_t used;          ///< Bytes used in data (only changed by the thread writing in the slab)
+    struct netlogg_slab *next;          ///< Next slab in the free list
+    char data[];          ///< Messages
+} netlogg_slab;
+
+
+/**
+ * \brief Message waiting in the output queue of a client
+ */
 typedef struct {
-    int fd;          ///< Specific file descriptor
-    Netlogging_lvl lvl;          ///< Niveau de log du buffer a envoyer
-    char buff[BUFF_SIZE_MAX];          ///< Buffer a envoyer
-} internal_buff;
+    const char *data;          ///< Message (in a slab, referenced until the message is sent)
+    uint32_t len;          ///< Message length
+    uint32_t off;          ///< Bytes already sent
+} out_msg;
+
+
+struct netlogg_worker;
 
 
 /**
@@ -76,6 +138,22 @@ typedef struct epoll_fd_ctx {
     char hostname[HOSTNAME_MAX_SIZE];          ///< Client host name
     char service[SERVICE_MAX_SIZE];          ///< Service name
     Netlogging_lvl lvl;          ///< Loglevel for the client
+    out_msg *out_q;          ///< Output queue of the client (circular, OUT_QUEUE_MSGS messages)
+    uint32_t out_head;          ///< Oldest message of the output queue
+    uint32_t out_count;          ///< Number of messages in the output queue
+    size_t out_bytes;          ///< Bytes waiting in the output queue
+    uint32_t out_slabs;          ///< Slabs kept by the output queue (runs of messages of the same slab)
+    uint64_t dropped;          ///< Messages dropped because the client was too slow
+    uint64_t replay;          ///< Next message of the history to send to the client
+    uint64_t replay_end;          ///< End of the history asked by the client (replay == replay_end: nothing to send)
+    uint32_t events;          ///< Events watched by the epoll loop
+    uint32_t idx;          ///< Index of the client in the array of the connected clients
+    uint32_t sub_idx;          ///< Index of the client in the list of its level (SUB_NONE if not in it)
+    int zip;          ///< The messages are sent compressed (gzip members)
+    int bin;          ///< The messages are sent as binary frames (see netlogg_frame)
+    int filter;          ///< Filter of the messages (see netlogg_filter_get, -1: none)
+    struct epoll_fd_ctx *next;          ///< Next context in the free list of the pool
+    struct netlogg_worker *worker;          ///< Worker owning the client
 } epoll_fd_ctx;
 
 
@@ -86,6 +164,85 @@ typedef struct recv_cmd_t {
 } recv_cmd_t;
 
 
+/**
+ * \brief Message of the history (the bytes stay in their slab)
+ */
+typedef struct {
+    const char *data;          ///< Message (in a slab referenced by the history)
+    uint32_t len;          ///< Message length
+    Netlogging_lvl lvl;          ///< Level of the message
+    uint64_t ts;          ///< Timestamp (nanoseconds since the Epoch)
+} history_msg;
+
+
+/**
+ * \brief Rendered messages published once by the netlogging thread and sent by every worker (read only once published)
+ */
+typedef struct netlogg_batch {
+    uint32_t refs;          ///< Workers that did not send it yet (+1 for the netlogging thread while it publishes it)
+    int fd;          ///< Client of the messages (-1 for all the clients)
+    Netlogging_lvl lvl;          ///< Level of the message when it is for a specific client
+    netlogg_slab *slabs[BATCH_SLABS];          ///< Slabs holding the messages (referenced by the batch)
+    uint32_t nb_slabs;          ///< Number of slabs
+    size_t used;          ///< Bytes of the messages
+    uint32_t count;          ///< Number of messages
+    struct iovec *iov[NETLOGG_LVLS];          ///< Messages wanted by the clients of each level (gBatchSize iovec each)
+    uint32_t iovcnt[NETLOGG_LVLS];          ///< Number of messages in each iov
+    struct iovec ziov[NETLOGG_LVLS];          ///< Messages of each level compressed in one gzip member (iov_len 0: none)
+    uint64_t ts;          ///< Timestamp of the oldest message
+    netlogg_slab *zslabs[BATCH_ZSLABS];          ///< Slabs holding the members (referenced by the batch)
+    uint32_t nb_zslabs;          ///< Number of slabs holding the members
+    int bin;          ///< Each message is also rendered as a binary frame
+    struct iovec *biov[NETLOGG_LVLS];          ///< Binary frames of the messages of iov (iovcnt frames each)
+    uint64_t *fmask;          ///< Filters matched by each message, in the order of iov[NETLOGG_DEBUG] (gBatchSize masks)
+    uint8_t *lvls;          ///< Level of each message, in the order of iov[NETLOGG_DEBUG] (gBatchSize levels)
+    struct netlogg_batch *next;          ///< Next batch in the free list
+} netlogg_batch;
+
+
+/**
+ * \brief Work given to a worker by the netlogging thread
+ */
+typedef struct {
+    netlogg_batch *batch;          ///< Messages to send (NULL for a new connection)
+    int fd;          ///< New connection
+    struct sockaddr_in addr;          ///< Address of the new connection
+} netlogg_job;
+
+
+/**
+ * \brief Thread sending the messages to a shard of the clients with its own epoll loop
+ *
+ * Only the owner thread touches the clients, the level lists and the message
+ * pool. The lock protects the inbox and the array of the clients (read by the
+ * "client list" command of the other workers).
+ */
+typedef struct netlogg_worker {
+    pthread_t thread;          ///< Thread of the worker
+    int local;          ///< The netlogging thread is the worker (no thread, no inbox)
+    int ep_fd;          ///< Epoll file descriptor of the worker
+    epoll_fd_ctx wake;          ///< Eventfd written when a job is added in the inbox
+    pthread_mutex_t lock;          ///< Lock of the inbox and of the array of the clients
+    netlogg_job *jobs;          ///< Inbox
+    uint32_t nb_jobs;          ///< Number of jobs in the inbox
+    uint32_t jobs_size;          ///< Size of the inbox
+    netlogg_job *jobs_run;          ///< Jobs being handled (swapped with the inbox)
+    uint32_t jobs_run_size;          ///< Size of jobs_run
+    uint32_t load;          ///< Clients given to the worker (atomic)
+    epoll_fd_ctx **clients;          ///< Connected clients (dense array, in no particular order)
+    uint32_t nb_clients;          ///< Number of connected clients
+    uint32_t clients_size;          ///< Size of the clients array
+    epoll_fd_ctx *clients_free;          ///< Free client contexts of the pool
+    epoll_fd_ctx *clients_closed;          ///< Client contexts closed during the current epoll loop
+    epoll_fd_ctx **subs[NETLOGG_LVLS];          ///< Connected clients sorted by loglevel
+    uint32_t nb_subs[NETLOGG_LVLS];          ///< Number of clients in each level list
+    uint32_t subs_size[NETLOGG_LVLS];          ///< Size of each level list
+    netlogg_slab *copy;          ///< Slab where the messages are copied when a slow client would keep too many slabs
+    struct iovec *fiov;          ///< Messages of a batch kept by the filter of a client (gBatchSize iovec)
+    struct epoll_event levents[MAXEVENTS];          ///< Events returned by epoll_wait
+} netlogg_worker;
+
+
 /**
  * \brief      Handle the new connections
  *
@@ -104,6 +261,32 @@ static void netlogg_handle_new_connection(struct epoll_fd_ctx *p, unsigned long
 static void netlogg_handle_comm(struct epoll_fd_ctx *p, unsigned long events);
 
 
+/**
+ * \brief      Accept the connections of the metrics endpoint
+ *
+ * \param      p       The epoll context
+ * \param[in]  events  The events
+ */
+static void netlogg_handle_metrics_connection(struct epoll_fd_ctx *p, unsigned long events);
+
+
+/**
+ * \brief      Answer a request of the metrics endpoint (whatever it is) and close the connection
+ *
+ * \param      p       The epoll context of the connection (freed)
+ * \param[in]  events  The events
+ */
+static void netlogg_handle_metrics_scrape(struct epoll_fd_ctx *p, unsigned long events);
+
+
+/**
+ * \brief      Close the connections of the metrics endpoint past their deadline
+ *
+ * \return     Milliseconds before the next deadline, -1 if no connection waits
+ */
+static int netlogg_metrics_expire(void);
+
+
 /**
  * \brief      Send a message to all connected clients
  *
@@ -113,6 +296,139 @@ static void netlogg_handle_comm(struct epoll_fd_ctx *p, unsigned long events);
 static void netlogg_send_to_all_connected_clients(struct epoll_fd_ctx *p, unsigned long events);
 
 
+/**
+ * \brief      Send all the messages published in the ring to the connected clients
+ *
+ * The records are rendered in batches (gBatchSize records or gBatchBytes bytes),
+ * each client gets a batch with a single sendmsg.
+ */
+static void netlogg_drain_ring(void);
+
+
+/**
+ * \brief      Render a record and hand it to the syslog, the history, the file and the current batch
+ *
+ * \param[in]  rec       The record
+ * \param[in]  filtered  Some clients have a filter (the filters are evaluated on the message)
+ */
+static void netlogg_drain_record(const netlogg_record *rec, int filtered);
+
+
+/**
+ * \brief      Tell if a record is the same message as the last one rendered (see gCollapse)
+ *
+ * \param[in]  rec   The record
+ *
+ * \return     1 if it is, 0 otherwise
+ */
+static int netlogg_repeat_same(const netlogg_record *rec);
+
+
+/**
+ * \brief      Render the "last message repeated N times" message of the repeats not reported yet
+ *
+ * \param[in]  filtered  Some clients have a filter
+ */
+static void netlogg_repeat_flush(int filtered);
+
+
+/**
+ * \brief      Add a rendered message to the iovec of each level that wants it
+ *
+ * \param      b     The batch
+ * \param[in]  lvl   The level of the message
+ * \param[in]  buff  The message (in slab_cur)
+ * \param[in]  len   The message length
+ * \param[in]  frame The binary frame of the message (in slab_cur, NULL if the batch has no frames)
+ * \param[in]  flen  The frame length
+ * \param[in]  fmask The filters matched by the message
+ */
+static void netlogg_batch_add(netlogg_batch *b, Netlogging_lvl lvl, char *buff, size_t len, char *frame, size_t flen, uint64_t fmask);
+
+
+/**
+ * \brief      Publish the current batch to the workers with clients (batch_cur is NULL afterwards)
+ */
+static void netlogg_batch_publish(void);
+
+
+/**
+ * \brief      Compress the messages of each level wanted by a compressed client, once per distinct level
+ *
+ * \param      b     The batch (before it is published)
+ */
+static void netlogg_batch_zip(netlogg_batch *b);
+
+
+/**
+ * \brief      Get an empty batch from the pool (allocated only if the pool is empty)
+ *
+ * \return     The batch, NULL on error
+ */
+static netlogg_batch* netlogg_batch_get(void);
+
+
+/**
+ * \brief      Release a reference on a batch, the last one gives it back to the pool
+ *
+ * \param      b     The batch
+ */
+static void netlogg_batch_unref(netlogg_batch *b);
+
+
+/**
+ * \brief      Copy a message in the ring (see netlogg_send and netlogg_send_site)
+ *
+ * \param[in]  deferred  1: only the arguments are copied (static file and format), 0: the caller renders the message
+ * \param[in]  file    The file
+ * \param[in]  lineno  The line number
+ * \param[in]  fd      The client (-1 for all the clients)
+ * \param[in]  lvl     The logging level
+ * \param[in]  bp      What to do when the ring is full (NETLOGG_BP_LEVEL: the policy of the level)
+ * \param      format  The format
+ * \param[in]  ap      List of variable for the format
+ *
+ * \return     Error code
+ */
+static int8_t netlogg_vsend(int deferred, const char *file, const int32_t lineno, const int fd, const Netlogging_lvl lvl,
+                            Netlogging_backpressure bp, const char *format, va_list ap);
+
+
+/**
+ * \brief      Render a record the way it is sent to the clients (newline included, not nul terminated)
+ *
+ * Only called by the netlogging thread: the date is cached and rendered again
+ * when the second changes.
+ *
+ * \param      buff     The buffer
+ * \param[in]  size     The buffer size (at least 64 bytes)
+ * \param[in]  rec      The record
+ * \param      msg_off  Offset of the message itself in buff (after the timestamp, file and level)
+ *
+ * \return     Number of bytes written in buff
+ */
+static size_t netlogg_format(char *buff, size_t size, const netlogg_record *rec, size_t *msg_off);
+
+
+/**
+ * \brief      Render a record as a binary frame (see netlogg_frame)
+ *
+ * \param      buff  The buffer (at least FRAME_SIZE_MAX bytes)
+ * \param[in]  rec   The record
+ * \param[in]  msg   The text of the message, already rendered by netlogg_format
+ * \param[in]  len   Its length (without the newline)
+ *
+ * \return     Number of bytes written in buff
+ */
+static size_t netlogg_frame_render(char *buff, const netlogg_record *rec, const char *msg, size_t len);
+
+
+/**
+ * \brief      Build the file dictionary of the binary clients from the call sites
+ */
+static void netlogg_frame_dict_init(void);
+
+
 /**
  * \brief      Close the specified connection (p->fd)
  *
@@ -203,609 +519,3554 @@ static void handle_loglevel_debug(struct epoll_fd_ctx *p, char *buff, ssize_t re
 
 
 /**
- * \brief      Function that change the command that ask for the connected clients
+ * \brief      Handler of the history command (history N: send the last N messages of the history)
  *
  * \param      p          The epoll context
  * \param      buff       The buffer
  * \param[in]  recv_size  The received size
  */
-static void handle_client_list(struct epoll_fd_ctx *p, char *buff, ssize_t recv_size);
+static void handle_history(struct epoll_fd_ctx *p, char *buff, ssize_t recv_size);
 
 
 /**
- * \brief      Get the number of connected clients
+ * \brief      Handler of the compress gzip command
  *
- * \return     Number of connected clients to the logger
+ * \param      p          The epoll context
+ * \param      buff       The buffer
+ * \param[in]  recv_size  The receive size
  */
-static int32_t netlogg_nb_connected_clients(void);
+static void handle_compress_gzip(struct epoll_fd_ctx *p, char *buff, ssize_t recv_size);
 
 
 /**
- * Variable contenant le nom du programme
+ * \brief      Handler of the compress none command
+ *
+ * \param      p          The epoll context
+ * \param      buff       The buffer
+ * \param[in]  recv_size  The receive size
  */
-static char     *gProgname          = NULL;
+static void handle_compress_none(struct epoll_fd_ctx *p, char *buff, ssize_t recv_size);
 
 
 /**
- * \brief Variable permettant de stocket la valeur du loglevel global
+ * \brief      Handler of the mode binary command
+ *
+ * \param      p          The epoll context
+ * \param      buff       The buffer
+ * \param[in]  recv_size  The receive size
  */
-static Netlogging_lvl     gLvl      = NETLOGG_DEBUG;
+static void handle_mode_binary(struct epoll_fd_ctx *p, char *buff, ssize_t recv_size);
 
 
 /**
- * \brief General epoll file descriptor
+ * \brief      Handler of the mode text command
+ *
+ * \param      p          The epoll context
+ * \param      buff       The buffer
+ * \param[in]  recv_size  The receive size
  */
-static int     ep_fd                = -1;
+static void handle_mode_text(struct epoll_fd_ctx *p, char *buff, ssize_t recv_size);
 
 
 /**
- * \brief Socket where we send the data
+ * \brief      Handler of the stats command
+ *
+ * \param      p          The epoll context
+ * \param      buff       The buffer
+ * \param[in]  recv_size  The receive size
  */
-static int     netlogg_send_fd      = -1;
+static void handle_stats(struct epoll_fd_ctx *p, char *buff, ssize_t recv_size);
 
 
 /**
- * \brief Command that can be send to the program and their handlers
+ * \brief      Only send the messages of a file, or containing a substring, or matching a regular expression
+ *
+ * \param      p          The epoll context
+ * \param      buff       The buffer (filter file=NAME, filter match=TEXT, filter regex=REGEX or filter none)
+ * \param[in]  recv_size  The receive size
  */
-static recv_cmd_t       recv_cmds[] =
-{
-    {.cmd = "\004", .desc = NULL, .handler = handle_exit},
-    {.cmd = "help", .desc = "Show the help", .handler = handle_help},
-    {.cmd = "exit", .desc = "Close the connection", .handler = handle_exit},
-    {.cmd = "quit", .desc = "Close the connection", .handler = handle_exit},
-    {.cmd = "loglevel crit", .desc = "Change the client loglevel to CRIT", .handler = handle_loglevel_crit},
-    {.cmd = "loglevel error", .desc = "Change the client loglevel to ERROR", .handler = handle_loglevel_error},
-    {.cmd = "loglevel notice", .desc = "Change the client loglevel to NOTICE", .handler = handle_loglevel_notice},
-    {.cmd = "loglevel info", .desc = "Change the client loglevel to INFO", .handler = handle_loglevel_info},
-    {.cmd = "loglevel warn", .desc = "Change the client loglevel to WARN", .handler = handle_loglevel_warn},
-    {.cmd = "loglevel debug", .desc = "Change the client loglevel to DEBUG", .handler = handle_loglevel_debug},
-    {.cmd = "client list", .desc = "Show the list of clients", .handler = handle_client_list}
-};
+static void handle_filter(struct epoll_fd_ctx *p, char *buff, ssize_t recv_size);
 
 
-static epoll_fd_ctx     netlogger_ctx[] =
-{
-    [EPOLL_FD_LISTEN]   = {-1, netlogg_handle_new_connection, "netlogg_handle_new_connection", NULL},
-    [EPOLL_FD_RECV]     = {-1, netlogg_send_to_all_connected_clients, "netlogg_send_to_all_connected_clients", NULL},
-    [EPOLL_FD_SEND0]    = {-1, netlogg_handle_comm, "netlogg_handle_comm", NULL},
-    [EPOLL_FD_SEND1]    = {-1, netlogg_handle_comm, "netlogg_handle_comm", NULL},
-    [EPOLL_FD_SEND2]    = {-1, netlogg_handle_comm, "netlogg_handle_comm", NULL},
-    [EPOLL_FD_SEND3]    = {-1, netlogg_handle_comm, "netlogg_handle_comm", NULL},
-    [EPOLL_FD_SEND4]    = {-1, netlogg_handle_comm, "netlogg_handle_comm", NULL},
-    [EPOLL_FD_SEND5]    = {-1, netlogg_handle_comm, "netlogg_handle_comm", NULL},
-    [EPOLL_FD_SEND6]    = {-1, netlogg_handle_comm, "netlogg_handle_comm", NULL},
-    [EPOLL_FD_SEND7]    = {-1, netlogg_handle_comm, "netlogg_handle_comm", NULL},
-    [EPOLL_FD_SEND8]    = {-1, netlogg_handle_comm, "netlogg_handle_comm", NULL},
-    [EPOLL_FD_SEND9]    = {-1, netlogg_handle_comm, "netlogg_handle_comm", NULL}
-};
+/**
+ * \brief      Limit the messages per second of the call sites of a file, of a line or of every site, or show the limits
+ *
+ * \param      p          The epoll context
+ * \param      buff       The buffer (ratelimit FILE[:LINE]|* RATE|off [BURST], or ratelimit alone)
+ * \param[in]  recv_size  The receive size
+ */
+static void handle_ratelimit(struct epoll_fd_ctx *p, char *buff, ssize_t recv_size);
 
 
-void* netlogg_init(void * args)
-{
-    int     res         = -1;
-    int     reuseAddr   = 1;
-    struct epoll_event ep_ev;
-    struct sockaddr_in sock_tcp_in;
-    int     sv[2]       = {-1, -1};
-    Netlogging_args* n_args = (Netlogging_args*) args;
+/**
+ * \brief      Set the less severe level sent by the files matching a pattern, or show the levels
+ *
+ * \param      p          The epoll context
+ * \param      buff       The buffer (setlevel GLOB emerg|alert|crit|error|warn|notice|info|debug|reset, or setlevel alone)
+ * \param[in]  recv_size  The receive size
+ */
+static void handle_setlevel(struct epoll_fd_ctx *p, char *buff, ssize_t recv_size);
 
 
-    // Set global variables
-    gProgname   = strdup(n_args->progname);
-    gLvl        = n_args->dft_lvl;
+/**
+ * \brief      Handler of the since command (since HH:MM:SS: send the messages of the history logged since then)
+ *
+ * \param      p          The epoll context
+ * \param      buff       The buffer
+ * \param[in]  recv_size  The received size
+ */
+static void handle_since(struct epoll_fd_ctx *p, char *buff, ssize_t recv_size);
 
 
-    openlog(NULL, LOG_CONS | LOG_PID | LOG_NDELAY, LOG_USER);
+/**
+ * \brief      Function that change the command that ask for the connected clients
+ *
+ * \param      p          The epoll context
+ * \param      buff       The buffer
+ * \param[in]  recv_size  The received size
+ */
+static void handle_client_list(struct epoll_fd_ctx *p, char *buff, ssize_t recv_size);
 
 
-    // Create epoll file descriptor
-    ep_fd       = epoll_create(EPOLL_FD_MAX);
+/**
+ * \brief      Get the number of connected clients
+ *
+ * \return     Number of connected clients to the logger
+ */
+static int32_t netlogg_nb_connected_clients(void);
 
-    if ( ep_fd == -1 )
-    {
-        NETLOGG(NETLOGG_ERROR, "%s - epoll_create: %m", __FUNCTION__);
-        assert(ep_fd != -1);
-    }
 
-    // Listening socket for the netlogger clients
-    netlogger_ctx[EPOLL_FD_LISTEN].fd = socket(AF_INET, SOCK_STREAM, 0);
-    assert(netlogger_ctx[EPOLL_FD_LISTEN].fd != -1);
+/**
+ * \brief      Get the output queues of all the connected clients
+ *
+ * \param      msgs       Messages waiting
+ * \param      bytes      Bytes waiting
+ * \param      max_bytes  Bytes waiting for the slowest client
+ */
+static void netlogg_queue_depth(uint64_t *msgs, uint64_t *bytes, uint64_t *max_bytes);
 
 
-    // Reuse addr
-    res = setsockopt(netlogger_ctx[EPOLL_FD_LISTEN].fd, SOL_SOCKET, SO_REUSEADDR, (int *) &reuseAddr, sizeof(reuseAddr) );
+/**
+ * \brief      Take a client context from the pool of a worker and add it to its connected clients
+ *
+ * \param      w     The worker
+ *
+ * \return     The client context (fd set to -1), NULL on error
+ */
+static epoll_fd_ctx* netlogg_client_alloc(netlogg_worker *w);
 
-    if ( res == -1 )
-    {
-        NETLOGG(NETLOGG_ERROR, "%s - setsockopt: %m", __FUNCTION__);
-        assert(res != -1);
-    }
 
-    // TCP IP / port / interfaces
-    sock_tcp_in.sin_family      = AF_INET;
-    sock_tcp_in.sin_port        = htons(n_args->port);
-    sock_tcp_in.sin_addr.s_addr = htonl(INADDR_ANY);
+/**
+ * \brief      Set up a new connection in a worker (called by the worker)
+ *
+ * \param      w     The worker
+ * \param[in]  fd    The new connection
+ * \param[in]  addr  The address of the client
+ */
+static void netlogg_client_add(netlogg_worker *w, int fd, const struct sockaddr_in *addr);
 
 
-    // Bind to the port
-    res = bind(netlogger_ctx[EPOLL_FD_LISTEN].fd, (struct sockaddr *) &sock_tcp_in, sizeof(sock_tcp_in) );
+/**
+ * \brief      Get an empty slab from the pool (allocated only if the pool is empty)
+ *
+ * \return     The slab (one reference for the caller), NULL on error
+ */
+static netlogg_slab* netlogg_slab_get(void);
 
-    if ( res == -1 )
-    {
+
+/**
+ * \brief      Release a reference on a slab, the last one gives it back to the pool
+ *
+ * \param      s     The slab
+ */
+static void netlogg_slab_unref(netlogg_slab *s);
+
+
+/**
+ * \brief      Get room for a message in a slab, a new slab replaces the current one when it is full
+ *
+ * \param      s     The slab being written (its reference is the one of the writer)
+ * \param[in]  len   The room needed (a message and its binary frame at most)
+ *
+ * \return     Where to write the message (the used field of the slab is not updated), NULL on error
+ */
+static char* netlogg_slab_reserve(netlogg_slab **s, size_t len);
+
+
+/**
+ * \brief      Give back to the pool the contexts of the clients of a worker closed since the last call
+ *
+ * Called once all the events returned by epoll_wait are handled, so that an
+ * event of a closed client never reaches a context given to a new one.
+ *
+ * \param      w     The worker
+ */
+static void netlogg_client_release(netlogg_worker *w);
+
+
+/**
+ * \brief      Create the epoll loop of a worker and start its thread (unless it is local)
+ *
+ * \param      w      The worker
+ * \param[in]  local  The netlogging thread is the worker
+ */
+static void netlogg_worker_start(netlogg_worker *w, int local);
+
+
+/**
+ * \brief      Epoll loop of a worker thread
+ *
+ * \param      arg   The worker
+ *
+ * \return     Never returns
+ */
+static void* netlogg_worker_run(void *arg);
+
+
+/**
+ * \brief      Add a job in the inbox of a worker and wake it up (called by the netlogging thread)
+ *
+ * \param      w     The worker
+ * \param[in]  job   The job
+ */
+static void netlogg_worker_push(netlogg_worker *w, const netlogg_job *job);
+
+
+/**
+ * \brief      Handle the jobs of the inbox of a worker
+ *
+ * \param      p       The epoll context (wake field of the worker)
+ * \param[in]  events  The events
+ */
+static void netlogg_worker_handle_jobs(struct epoll_fd_ctx *p, unsigned long events);
+
+
+/**
+ * \brief      Send a batch to the clients of a worker that want it
+ *
+ * \param      w     The worker
+ * \param[in]  b     The batch
+ */
+static void netlogg_worker_send(netlogg_worker *w, const netlogg_batch *b);
+
+
+/**
+ * \brief      Keep the messages of a batch that a filtered client wants
+ *
+ * \param[in]  b     The batch
+ * \param[in]  p     The epoll context of the client
+ * \param      fiov  The messages kept (gBatchSize iovec)
+ *
+ * \return     The number of messages kept
+ */
+static uint32_t netlogg_batch_filter(const netlogg_batch *b, const struct epoll_fd_ctx *p, struct iovec *fiov);
+
+
+/**
+ * \brief      Send messages to a client with one sendmsg (a writev that does not raise SIGPIPE) without blocking,
+ *             queue what cannot be sent right now
+ *
+ * \param      p       The epoll context of the client
+ * \param[in]  iov     The messages
+ * \param[in]  iovcnt  The number of messages
+ */
+static void netlogg_client_write(struct epoll_fd_ctx *p, const struct iovec *iov, uint32_t iovcnt);
+
+
+/**
+ * \brief      Add a message at the end of the output queue of a client (applies the overflow policy)
+ *
+ * \param      p     The epoll context of the client
+ * \param[in]  buff  The message
+ * \param[in]  len   The message length
+ * \param[in]  off   Bytes of the message already sent
+ *
+ * The queue keeps a reference on the slab of the message instead of copying
+ * it, unless the client already keeps OUT_QUEUE_SLABS slabs.
+ */
+static void netlogg_client_queue(struct epoll_fd_ctx *p, const char *buff, size_t len, size_t off);
+
+
+/**
+ * \brief      Remove the oldest message of the output queue of a client
+ *
+ * \param      p     The epoll context of the client
+ */
+static void netlogg_client_pop(struct epoll_fd_ctx *p);
+
+
+/**
+ * \brief      Send as much as possible of the output queue of a client (EPOLLOUT)
+ *
+ * \param      p     The epoll context of the client
+ */
+static void netlogg_client_flush(struct epoll_fd_ctx *p);
+
+
+/**
+ * \brief      Queue the next messages of the history asked by a client, as long as its output queue has room
+ *
+ * \param      p     The epoll context of the client
+ */
+static void netlogg_client_replay(struct epoll_fd_ctx *p);
+
+
+/**
+ * \brief      Add a broadcast message in the history (forgets the oldest ones)
+ *
+ * \param[in]  data  The message (in slab_cur)
+ * \param[in]  len   The message length
+ * \param[in]  ts    The timestamp of the message
+ * \param[in]  lvl   The level of the message
+ */
+static void netlogg_history_add(const char *data, size_t len, uint64_t ts, Netlogging_lvl lvl);
+
+
+/**
+ * \brief      Forget the oldest message of the history (history_lock held)
+ */
+static void netlogg_history_pop(void);
+
+
+/**
+ * \brief      Drop the oldest message of the output queue that is not partially sent
+ *
+ * \param      p     The epoll context of the client
+ *
+ * \return     1 if a message was dropped, 0 otherwise
+ */
+static int netlogg_client_drop_oldest(struct epoll_fd_ctx *p);
+
+
+/**
+ * \brief      Change the events watched for a client (EPOLLOUT only while its output queue is not empty)
+ *
+ * \param      p       The epoll context of the client
+ * \param[in]  events  The events
+ */
+static void netlogg_client_watch(struct epoll_fd_ctx *p, uint32_t events);
+
+
+/**
+ * \brief      Change the loglevel of a client
+ *
+ * \param      p     The epoll context of the client
+ * \param[in]  lvl   The new loglevel
+ */
+static void netlogg_client_set_lvl(struct epoll_fd_ctx *p, Netlogging_lvl lvl);
+
+
+/**
+ * \brief      Send (or stop sending) the messages of a client compressed
+ *
+ * \param      p     The epoll context of the client
+ * \param[in]  on    1 to compress the messages, 0 otherwise
+ */
+static void netlogg_client_set_zip(struct epoll_fd_ctx *p, int on);
+
+
+/**
+ * \brief      Send (or stop sending) the messages of a client as binary frames
+ *
+ * \param      p     The epoll context of the client
+ * \param[in]  on    1 to send binary frames, 0 to send text
+ */
+static void netlogg_client_set_bin(struct epoll_fd_ctx *p, int on);
+
+
+/**
+ * \brief      Add a client to the list of its level
+ *
+ * \param      p     The epoll context of the client
+ */
+static void netlogg_subs_add(struct epoll_fd_ctx *p);
+
+
+/**
+ * \brief      Remove a client from the list of its level
+ *
+ * \param      p     The epoll context of the client
+ */
+static void netlogg_subs_del(struct epoll_fd_ctx *p);
+
+
+/**
+ * \brief      Compute again the highest level wanted by the syslog or a connected client (netlogg_max_lvl)
+ */
+static void netlogg_update_max_lvl(void);
+
+
+/**
+ * \brief      Resolve a level of Netlogging_args, where 0 (NETLOGG_EMERG) means dft_lvl like the other fields
+ *
+ * \param[in]  lvl   The level given
+ *
+ * \return     The level to use
+ */
+static Netlogging_lvl netlogg_args_lvl(Netlogging_lvl lvl);
+
+
+/**
+ * \brief      Make the call sites compute their level again (netlogg_lvl_gen)
+ */
+static void netlogg_lvl_gen_bump(void);
+
+
+/**
+ * \brief      Build the string table of the call sites and move the ring into the flight recorder file
+ *
+ * \param[in]  path  The file
+ */
+static void netlogg_recorder_open(const char *path);
+
+
+/**
+ * Variable contenant le nom du programme
+ */
+static char     *gProgname          = NULL;
+
+
+/**
+ * \brief Variable permettant de stocket la valeur du loglevel global
+ */
+static Netlogging_lvl     gLvl      = NETLOGG_DEBUG;
+
+
+/**
+ * \brief Name of the levels as shown to the clients
+ */
+static const char     *lvl_strs[NETLOGG_LVLS] =
+{
+    [NETLOGG_EMERG]     = "\033[31mEMERG\033[0m",
+    [NETLOGG_ALERT]     = "\033[31mALERT\033[0m",
+    [NETLOGG_CRIT]      = "\033[31mCRIT\033[0m",
+    [NETLOGG_ERROR]     = "\033[31mERROR\033[0m",
+    [NETLOGG_WARN]      = "\033[33mWARN\033[0m",
+    [NETLOGG_NOTICE]    = "\033[32mNOTICE\033[0m",
+    [NETLOGG_INFO]      = "\033[32mINFO\033[0m",
+    [NETLOGG_DEBUG]     = "DEBUG"
+};
+
+
+/**
+ * \brief Highest level wanted by the syslog or a connected client (read by NETLOGG before doing anything)
+ */
+int     netlogg_max_lvl             = NETLOGG_DEBUG;
+
+
+uint32_t     netlogg_lvl_gen        = 1;
+
+
+/**
+ * \brief Bytes waiting for a slow client before the overflow policy applies
+ */
+static size_t     gOutQueueSize     = OUT_QUEUE_SIZE_DFT;
+
+
+/**
+ * \brief What to do when the output queue of a client is full
+ */
+static Netlogging_overflow     gOverflow    = NETLOGG_OVERFLOW_DROP_OLDEST;
+
+
+/**
+ * \brief Clock read by the producers (CLOCK_REALTIME_COARSE if the precision of a tick is enough)
+ */
+static clockid_t     gClock         = CLOCK_REALTIME;
+
+
+/**
+ * \brief What a message of each level does when the ring is full, read by the producers (Netlogging_args.backpressure)
+ */
+static Netlogging_backpressure     gBackpressure[NETLOGG_LVLS];
+
+
+/**
+ * \brief Longest wait of a NETLOGG_BP_BLOCK producer in nanoseconds, read by the producers
+ */
+static uint64_t     gBlockTimeout   = BLOCK_TIMEOUT_US_DFT * 1000ull;
+
+
+/**
+ * \brief Second of the date cached in ts_buff (only used by the netlogging thread)
+ */
+static time_t     ts_sec            = -1;
+
+
+/**
+ * \brief Date of the messages of the second ts_sec, up to the dot before the microseconds
+ */
+static char     ts_buff[32];
+
+
+/**
+ * \brief Length of the date in ts_buff
+ */
+static size_t     ts_len            = 0;
+
+
+/**
+ * \brief General epoll file descriptor
+ */
+static int     ep_fd                = -1;
+
+
+/**
+ * \brief Command that can be send to the program and their handlers
+ */
+static recv_cmd_t       recv_cmds[] =
+{
+    {.cmd = "\004", .desc = NULL, .handler = handle_exit},
+    {.cmd = "help", .desc = "Show the help", .handler = handle_help},
+    {.cmd = "exit", .desc = "Close the connection", .handler = handle_exit},
+    {.cmd = "quit", .desc = "Close the connection", .handler = handle_exit},
+    {.cmd = "loglevel crit", .desc = "Change the client loglevel to CRIT", .handler = handle_loglevel_crit},
+    {.cmd = "loglevel error", .desc = "Change the client loglevel to ERROR", .handler = handle_loglevel_error},
+    {.cmd = "loglevel notice", .desc = "Change the client loglevel to NOTICE", .handler = handle_loglevel_notice},
+    {.cmd = "loglevel info", .desc = "Change the client loglevel to INFO", .handler = handle_loglevel_info},
+    {.cmd = "loglevel warn", .desc = "Change the client loglevel to WARN", .handler = handle_loglevel_warn},
+    {.cmd = "loglevel debug", .desc = "Change the client loglevel to DEBUG", .handler = handle_loglevel_debug},
+    {.cmd = "client list", .desc = "Show the list of clients", .handler = handle_client_list},
+    {.cmd = "history", .desc = "Show the last messages (history N)", .handler = handle_history},
+    {.cmd = "since", .desc = "Show the messages logged since a time of the last 24 hours (since HH:MM:SS)", .handler = handle_since},
+    {.cmd = "compress gzip", .desc = "Send the next messages compressed (a stream of gzip members)", .handler = handle_compress_gzip},
+    {.cmd = "compress none", .desc = "Send the next messages as text", .handler = handle_compress_none},
+    {.cmd = "mode binary", .desc = "Send the next messages as binary frames (after the NLGBIN1 line and the file dictionary)", .handler = handle_mode_binary},
+    {.cmd = "mode text", .desc = "Send the next messages as text", .handler = handle_mode_text},
+    {.cmd = "stats", .desc = "Show the counters of the logger (messages, drops, queues, latency)", .handler = handle_stats},
+    {.cmd = "filter", .desc = "Only send the messages of a file, containing a text or matching a regex (filter file=NAME|match=TEXT|regex=REGEX|none)", .handler = handle_filter},
+    {.cmd = "ratelimit", .desc = "Limit the messages per second of each call site of a file or line (ratelimit FILE[:LINE]|* RATE|off [BURST])", .handler = handle_ratelimit},
+    {.cmd = "setlevel", .desc = "Set the less severe level sent by the files matching a pattern (setlevel GLOB LEVEL|reset)", .handler = handle_setlevel}
+};
+
+
+static epoll_fd_ctx     netlogger_ctx[] =
+{
+    [EPOLL_FD_LISTEN]   = {-1, netlogg_handle_new_connection, "netlogg_handle_new_connection", NULL},
+    [EPOLL_FD_RECV]     = {-1, netlogg_send_to_all_connected_clients, "netlogg_send_to_all_connected_clients", NULL},
+    [EPOLL_FD_METRICS]  = {-1, netlogg_handle_metrics_connection, "netlogg_handle_metrics_connection", NULL}
+};
+
+
+/**
+ * \brief Initial state of the context of a request of the metrics endpoint
+ */
+static const epoll_fd_ctx     metrics_ctx_tmpl = {-1, netlogg_handle_metrics_scrape, "netlogg_handle_metrics_scrape", NULL};
+
+
+/**
+ * \brief Connection of the metrics endpoint waiting for its request
+ */
+typedef struct {
+    epoll_fd_ctx ctx;          ///< Context of the connection (first, the handler gets its address)
+    uint64_t deadline_ms;          ///< Time it is closed if no request came (CLOCK_MONOTONIC, 0: free slot)
+} metrics_conn;
+
+
+/**
+ * \brief Connections of the metrics endpoint waiting for their request (only used by the netlogging thread)
+ */
+static metrics_conn     metrics_conns[METRICS_CONNS_MAX];
+static uint32_t     metrics_nb_conns    = 0;
+
+
+/**
+ * \brief Answer of the metrics endpoint (only used by the netlogging thread)
+ */
+static char     metrics_buff[METRICS_BUFF_SIZE];
+
+
+/**
+ * \brief Initial state of the context of a client
+ */
+static const epoll_fd_ctx     client_ctx_tmpl = {-1, netlogg_handle_comm, "netlogg_handle_comm", NULL};
+
+
+/**
+ * \brief Initial state of the inbox context of a worker
+ */
+static const epoll_fd_ctx     worker_ctx_tmpl = {-1, netlogg_worker_handle_jobs, "netlogg_worker_handle_jobs", NULL};
+
+
+/**
+ * \brief Workers sending the messages to the clients
+ */
+static netlogg_worker     *workers      = NULL;
+
+
+/**
+ * \brief Number of workers (a single local one when no worker thread is wanted)
+ */
+static uint32_t     nb_workers          = 0;
+
+
+/**
+ * \brief Number of connected clients of all the workers (atomic)
+ */
+static uint32_t     nb_connected        = 0;
+
+
+/**
+ * \brief Number of clients of each level in all the workers (atomic)
+ */
+static uint32_t     subs_total[NETLOGG_LVLS];
+
+
+/**
+ * \brief Number of compressed clients of each level in all the workers (atomic)
+ */
+static uint32_t     subs_zip[NETLOGG_LVLS];
+
+
+/**
+ * \brief Number of compressed clients (atomic)
+ */
+static uint32_t     zip_clients         = 0;
+
+
+/**
+ * \brief Compression context of the netlogging thread (shared by all the compressed clients)
+ */
+static netlogg_zip     zip;
+
+
+/**
+ * \brief Slab where the netlogging thread writes the compressed members
+ */
+static netlogg_slab     *slab_zip       = NULL;
+
+
+/**
+ * \brief Number of binary clients (atomic)
+ */
+static uint32_t     bin_clients         = 0;
+
+
+/**
+ * \brief Files of the call sites, sorted by address: the file id of a binary frame is the index of its file
+ */
+static const char     **dict_files      = NULL;
+
+
+/**
+ * \brief Number of files in dict_files
+ */
+static uint32_t     nb_dict_files       = 0;
+
+
+/**
+ * \brief NETLOGG_FRAME_HELLO and a NETLOGG_FRAME_FILE frame per file of dict_files (in slabs never released)
+ */
+static struct iovec     *dict_iov       = NULL;
+
+
+/**
+ * \brief Number of entries in dict_iov
+ */
+static uint32_t     nb_dict_iov         = 0;
+
+
+/**
+ * \brief File of the last binary frame and its id (the messages of a file often follow each other)
+ */
+static const char     *dict_last_file   = NULL;
+static uint16_t     dict_last_id        = NETLOGG_FILE_ID_INLINE;
+
+
+/**
+ * \brief Serializes the updates of netlogg_max_lvl made by the workers
+ */
+static pthread_mutex_t     lvl_lock     = PTHREAD_MUTEX_INITIALIZER;
+
+
+/**
+ * \brief Maximum number of connected clients
+ */
+static uint32_t     gMaxClients         = MAX_CLIENTS_DFT;
+
+
+/**
+ * \brief Events returned by epoll_wait
+ */
+static struct epoll_event     levents[MAXEVENTS];
+
+
+/**
+ * \brief Maximum number of records in a batch
+ */
+static uint32_t     gBatchSize          = BATCH_SIZE_DFT;
+
+
+/**
+ * \brief Bytes rendered in a batch before it is sent
+ */
+static size_t     gBatchBytes           = BATCH_BYTES_DFT;
+
+
+/**
+ * \brief Batch being rendered by the netlogging thread
+ */
+static netlogg_batch     *batch_cur     = NULL;
+
+
+/**
+ * \brief The same broadcast message logged again and again is only counted (Netlogging_args.collapse_repeats)
+ */
+static int     gCollapse            = 0;
+
+
+/**
+ * \brief Last broadcast message rendered, to recognize its repeats (netlogging thread)
+ */
+static union {
+    netlogg_record rec;
+    char raw[sizeof(netlogg_record) + BUFF_SIZE_MAX];
+} repeat_last;
+static int          repeat_valid    = 0;
+
+
+/**
+ * \brief Repeats of the last message not reported yet, timestamps of the first and of the last of them
+ */
+static uint64_t     repeat_count    = 0;
+static uint64_t     repeat_since    = 0;
+static uint64_t     repeat_ts       = 0;
+
+
+/**
+ * \brief Slab where the netlogging thread renders the messages
+ */
+static netlogg_slab     *slab_cur       = NULL;
+
+
+/**
+ * \brief Free slabs of the pool
+ */
+static netlogg_slab     *slabs_free     = NULL;
+
+
+/**
+ * \brief Lock of the pool of slabs (given back by the workers)
+ */
+static pthread_mutex_t     slabs_lock   = PTHREAD_MUTEX_INITIALIZER;
+
+
+/**
+ * \brief Free batches of the pool
+ */
+static netlogg_batch     *batches_free  = NULL;
+
+
+/**
+ * \brief Lock of the pool of batches (given back by the workers)
+ */
+static pthread_mutex_t     batches_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+/**
+ * \brief Recent messages kept by the netlogging thread for the clients that connect later (circular)
+ */
+static history_msg     *history         = NULL;
+
+
+/**
+ * \brief Sequence number of the oldest message of the history
+ */
+static uint64_t     history_head        = 0;
+
+
+/**
+ * \brief Sequence number of the next message of the history
+ */
+static uint64_t     history_tail        = 0;
+
+
+/**
+ * \brief Slabs kept by the history (runs of messages of the same slab)
+ */
+static uint32_t     history_slabs       = 0;
+
+
+/**
+ * \brief Lock of the history (written by the netlogging thread, read by the workers)
+ */
+static pthread_mutex_t     history_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+/**
+ * \brief Size of the history in messages (power of two)
+ */
+static uint32_t     gHistoryMsgs        = HISTORY_MSGS_DFT;
+
+
+/**
+ * \brief Slabs kept by the history at most
+ */
+static uint32_t     gHistorySlabs       = HISTORY_SIZE_DFT / SLAB_SIZE;
+
+
+/**
+ * \brief Less severe level kept in the history
+ */
+static Netlogging_lvl     gHistoryLvl   = NETLOGG_DEBUG;
+
+
+/**
+ * \brief Set when the messages are written in a file
+ */
+static int     gFile                    = 0;
+
+
+/**
+ * \brief Less severe level written in the file
+ */
+static Netlogging_lvl     gFileLvl      = NETLOGG_DEBUG;
+
+
+/**
+ * \brief Number of worker threads (0: the netlogging thread sends the messages itself)
+ */
+static uint32_t     gWorkers            = 0;
+
+
+/**
+ * \brief Call sites of the binary (see NETLOGG_TO), used to decode the flight recorder
+ */
+extern const netlogg_site     __start_netlogg_sites[] __attribute__( (weak) );
+extern const netlogg_site     __stop_netlogg_sites[] __attribute__( (weak) );
+
+
+
+void* netlogg_init(void * args)
+{
+    int     res         = -1;
+    int     reuseAddr   = 1;
+    struct epoll_event ep_ev;
+    struct sockaddr_in sock_tcp_in;
+    Netlogging_args* n_args = (Netlogging_args*) args;
+
+
+    // Set global variables
+    gProgname   = strdup(n_args->progname);
+    gLvl        = n_args->dft_lvl;
+    gOverflow   = n_args->overflow;
+    gHistoryLvl = netlogg_args_lvl(n_args->history_lvl);
+    __atomic_store_n(&gClock, n_args->coarse_clock ? CLOCK_REALTIME_COARSE : CLOCK_REALTIME, __ATOMIC_RELAXED);
+    netlogg_update_max_lvl();
+
+    if ( n_args->out_queue_size != 0 )
+    {
+        gOutQueueSize = n_args->out_queue_size;
+    }
+
+    if ( n_args->max_clients != 0 )
+    {
+        gMaxClients = n_args->max_clients;
+    }
+
+    if ( n_args->batch_size != 0 )
+    {
+        // A batch is sent with one sendmsg
+        gBatchSize = (n_args->batch_size < IOV_MAX) ? n_args->batch_size : IOV_MAX;
+    }
+
+    if ( n_args->batch_bytes != 0 )
+    {
+        gBatchBytes = n_args->batch_bytes;
+    }
+
+    gWorkers    = n_args->workers;
+    gCollapse   = n_args->collapse_repeats;
+
+    for ( int l = 0; l < NETLOGG_LVLS; l++ )
+    {
+        __atomic_store_n(&gBackpressure[l], n_args->backpressure[l], __ATOMIC_RELAXED);
+    }
+
+    if ( n_args->block_timeout_us != 0 )
+    {
+        __atomic_store_n(&gBlockTimeout, n_args->block_timeout_us * 1000ull, __ATOMIC_RELAXED);
+    }
+
+    if ( n_args->rate_limit != 0 )
+    {
+        netlogg_ratelimit_set("*", 0, n_args->rate_limit, n_args->rate_burst);
+    }
+
+    // Rounded up to a power of two, at most HISTORY_MSGS_MAX (the count would wrap to 0 above 2^31)
+    if ( n_args->history_msgs != 0 )
+    {
+        for ( gHistoryMsgs = 1; (gHistoryMsgs < n_args->history_msgs) && (gHistoryMsgs < HISTORY_MSGS_MAX); gHistoryMsgs <<= 1 )
+        {
+        }
+    }
+
+    if ( n_args->history_size != 0 )
+    {
+        gHistorySlabs = n_args->history_size / SLAB_SIZE;
+    }
+
+    if ( n_args->recorder_path != NULL )
+    {
+        netlogg_recorder_open(n_args->recorder_path);
+    }
+
+    if ( n_args->file_path != NULL )
+    {
+        gFileLvl    = netlogg_args_lvl(n_args->file_lvl);
+        gFile       = (netlogg_file_init(n_args->file_path, n_args->file_max_size, n_args->file_max_age,
+                                         (n_args->file_keep != 0) ? n_args->file_keep : FILE_KEEP_DFT, n_args->file_sync_ms,
+                                         n_args->file_compress) == 0);
+
+        if ( ! gFile )
+        {
+            NETLOGG(NETLOGG_ERROR, "%s - %s: %m", __FUNCTION__, n_args->file_path);
+        }
+
+        netlogg_update_max_lvl();
+    }
+
+    if ( netlogg_zip_init(&zip) == -1 )
+    {
+        NETLOGG(NETLOGG_ERROR, "%s - deflateInit2 failed, the clients cannot be compressed", __FUNCTION__);
+    }
+
+    netlogg_frame_dict_init();
+
+    // The slab being written is always kept
+    gHistorySlabs   = (gHistorySlabs > 2) ? gHistorySlabs : 2;
+    history         = calloc(gHistoryMsgs, sizeof(*history) );
+    assert(history != NULL);
+
+
+    netlogg_syslog_init(gProgname);
+
+
+    // Create epoll file descriptor
+    ep_fd       = epoll_create(EPOLL_FD_MAX);
+
+    if ( ep_fd == -1 )
+    {
+        NETLOGG(NETLOGG_ERROR, "%s - epoll_create: %m", __FUNCTION__);
+        assert(ep_fd != -1);
+    }
+
+    // Listening socket for the netlogger clients
+    netlogger_ctx[EPOLL_FD_LISTEN].fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    assert(netlogger_ctx[EPOLL_FD_LISTEN].fd != -1);
+
+
+    // Reuse addr
+    res = setsockopt(netlogger_ctx[EPOLL_FD_LISTEN].fd, SOL_SOCKET, SO_REUSEADDR, (int *) &reuseAddr, sizeof(reuseAddr) );
+
+    if ( res == -1 )
+    {
+        NETLOGG(NETLOGG_ERROR, "%s - setsockopt: %m", __FUNCTION__);
+        assert(res != -1);
+    }
+
+    // TCP IP / port / interfaces
+    sock_tcp_in.sin_family      = AF_INET;
+    sock_tcp_in.sin_port        = htons(n_args->port);
+    sock_tcp_in.sin_addr.s_addr = htonl(INADDR_ANY);
+
+
+    // Bind to the port
+    res = bind(netlogger_ctx[EPOLL_FD_LISTEN].fd, (struct sockaddr *) &sock_tcp_in, sizeof(sock_tcp_in) );
+
+    if ( res == -1 )
+    {
         NETLOGG(NETLOGG_ERROR, "%s - bind: %m", __FUNCTION__);
         assert(res != -1);
     }
 
-    // Listen for incoming connection
-    res = listen(netlogger_ctx[EPOLL_FD_LISTEN].fd, 5);
+    // Listen for incoming connection
+    res = listen(netlogger_ctx[EPOLL_FD_LISTEN].fd, SOMAXCONN);
+
+    if ( res == -1 )
+    {
+        NETLOGG(NETLOGG_ERROR, "%s - listen: %m", __FUNCTION__);
+        assert(res != -1);
+    }
+
+    ep_ev.events    = EPOLLIN | EPOLLHUP | EPOLLERR | EPOLLRDHUP;
+    ep_ev.data.ptr  = &netlogger_ctx[EPOLL_FD_LISTEN];
+
+
+    // Ajout du contexte de la socket d'écoute  dans la table des evenements epoll
+    res             = epoll_ctl(ep_fd, EPOLL_CTL_ADD, netlogger_ctx[EPOLL_FD_LISTEN].fd, &ep_ev);
+
+    if ( res == -1 )
+    {
+        NETLOGG(NETLOGG_ERROR, "%s - epoll_ctl: %m", __FUNCTION__);
+        assert(res != -1);
+    }
+
+    // Create the eventfd that wakes us up when the ring is no longer empty
+    netlogger_ctx[EPOLL_FD_RECV].fd = netlogg_ring_init();
+
+    if ( netlogger_ctx[EPOLL_FD_RECV].fd == -1 )
+    {
+        NETLOGG(NETLOGG_ERROR, "%s - eventfd: %m", __FUNCTION__);
+        assert(netlogger_ctx[EPOLL_FD_RECV].fd != -1);
+    }
+
+    ep_ev.events    = EPOLLIN | EPOLLHUP | EPOLLERR | EPOLLRDHUP;
+    ep_ev.data.ptr  = &netlogger_ctx[EPOLL_FD_RECV];
+
+
+    // Ajout du contexte de la socket d'écoute  dans la table des evenements epoll
+    res = epoll_ctl(ep_fd, EPOLL_CTL_ADD, netlogger_ctx[EPOLL_FD_RECV].fd, &ep_ev);
+
+    if ( res == -1 )
+    {
+        NETLOGG(NETLOGG_ERROR, "%s - epoll_ctl: %m", __FUNCTION__);
+        assert(res != -1);
+    }
+
+    // The metrics endpoint is optional: the logger goes on without it
+    if ( n_args->metrics_port != 0 )
+    {
+        sock_tcp_in.sin_port                = htons(n_args->metrics_port);
+        netlogger_ctx[EPOLL_FD_METRICS].fd  = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        ep_ev.events                        = EPOLLIN;
+        ep_ev.data.ptr                      = &netlogger_ctx[EPOLL_FD_METRICS];
+
+        if ( (netlogger_ctx[EPOLL_FD_METRICS].fd == -1) ||
+             (setsockopt(netlogger_ctx[EPOLL_FD_METRICS].fd, SOL_SOCKET, SO_REUSEADDR, &reuseAddr, sizeof(reuseAddr) ) == -1) ||
+             (bind(netlogger_ctx[EPOLL_FD_METRICS].fd, (struct sockaddr *) &sock_tcp_in, sizeof(sock_tcp_in) ) == -1) ||
+             (listen(netlogger_ctx[EPOLL_FD_METRICS].fd, SOMAXCONN) == -1) ||
+             (epoll_ctl(ep_fd, EPOLL_CTL_ADD, netlogger_ctx[EPOLL_FD_METRICS].fd, &ep_ev) == -1) )
+        {
+            NETLOGG(NETLOGG_ERROR, "%s - metrics port %" PRIu16 ": %m", __FUNCTION__, n_args->metrics_port);
+        }
+    }
+
+    // Start the workers, the netlogging thread is the only one when no worker thread is wanted
+    nb_workers  = (gWorkers != 0) ? gWorkers : 1;
+    workers     = calloc(nb_workers, sizeof(*workers) );
+    assert(workers != NULL);
+
+    for ( uint32_t i = 0; i < nb_workers; i++ )
+    {
+        netlogg_worker_start(&workers[i], gWorkers == 0);
+    }
+
+    for ( ; ; )
+    {
+        int     timeout             = -1;
+        int     nb                  = -1;
+        int     expire              = -1;
+
+        // Only go to sleep once the producers have nothing left in the ring
+        while ( netlogg_ring_sleep() )
+        {
+            netlogg_drain_ring();
+        }
+
+        // Come back for the messages the file thread could not take yet
+        if ( gFile && netlogg_file_waiting() )
+        {
+            timeout = NETLOGG_FILE_FLUSH_MS;
+        }
+
+        // Come back to report the repeats of the last message
+        if ( (repeat_count != 0) && ( (timeout == -1) || (timeout > REPEAT_FLUSH_MS) ) )
+        {
+            timeout = REPEAT_FLUSH_MS;
+        }
+
+        // Come back to close the connections of the metrics endpoint that sent nothing
+        expire = netlogg_metrics_expire();
+
+        if ( (expire != -1) && ( (timeout == -1) || (timeout > expire) ) )
+        {
+            timeout = expire;
+        }
+
+        nb      = epoll_wait(ep_fd, levents, MAXEVENTS, timeout);
+        netlogg_stats_add(NETLOGG_STAT_SC_EPOLL_WAIT, 1);
+
+        netlogg_ring_wake();
+
+        if ( nb > 0 )
+        {
+            for (int i = 0; i < nb; ++i)
+            {
+                epoll_fd_ctx     *p = levents[i].data.ptr;
+
+                // Assertions
+                assert(p);
+                assert(p->handler);
+
+
+                // Traitement de l'événement
+                (*p->handler)(p, levents[i].events);
+            }
+
+            if ( workers[0].local )
+            {
+                netlogg_client_release(&workers[0]);
+            }
+        }
+        else if ( nb == 0 )
+        {
+            netlogg_drain_ring();
+            netlogg_file_flush();
+        }
+        else
+        {
+            if ( (nb == -1) && (errno == EINTR) )
+            {
+                NETLOGG(NETLOGG_WARN, "%s: signal intercepté", __FUNCTION__);
+            }
+            else
+            {
+                NETLOGG(NETLOGG_ERROR, "%s: Invalide: %m", __FUNCTION__);
+            }
+        }
+    }
+}
+
+
+int8_t netlogg_send(const char              *file,
+                    const int32_t           lineno,
+                    const int               fd,
+                    const Netlogging_lvl    lvl,
+                    const char              *format,
+                    ...
+                    )
+{
+    int8_t      res = -1;
+    va_list     ap;
+
+
+    va_start(ap, format);
+    res = netlogg_vsend(0, file, lineno, fd, lvl, NETLOGG_BP_LEVEL, format, ap);
+    va_end(ap);
+
+    return (res);
+}
+
+
+
+int8_t netlogg_send_site(const netlogg_site     *site,
+                         const int              fd,
+                         ...
+                         )
+{
+    int8_t      res = -1;
+    va_list     ap;
+
+
+    va_start(ap, fd);
+    res = netlogg_vsend(1, site->file, site->lineno, fd, site->lvl, site->bp, site->format, ap);
+    va_end(ap);
+
+    return (res);
+}
+
+
+
+static int8_t netlogg_vsend(int                     deferred,
+                            const char              *file,
+                            const int32_t           lineno,
+                            const int               fd,
+                            const Netlogging_lvl    lvl,
+                            Netlogging_backpressure bp,
+                            const char              *format,
+                            va_list                 ap
+                            )
+{
+    size_t      len = 0;
+    size_t      flen = 0;
+    int         n = 0;
+    int         err = errno;
+    char        args[BUFF_SIZE_MAX];
+    struct timespec     ts;
+    netlogg_record      *rec = NULL;
+
+
+    // Not a level: it would index the counters and the policies of the levels
+    if ( (unsigned) lvl >= NETLOGG_LVLS )
+    {
+        return (-1);
+    }
+
+    // Nobody wants this message
+    if ( (fd == -1) && ( (int) lvl > __atomic_load_n(&netlogg_max_lvl, __ATOMIC_RELAXED) ) )
+    {
+        return (0);
+    }
+
+    // A site over its rate limit costs neither the copy of the arguments nor a slot of the ring (the buckets keep the static file of the sites)
+    if ( (fd == -1) && deferred && ! netlogg_ratelimit_check(file, lineno) )
+    {
+        netlogg_stats_add(NETLOGG_STAT_RATE_DROPS, 1);
+
+        return (-1);
+    }
+
+    // Get the time
+    clock_gettime(__atomic_load_n(&gClock, __ATOMIC_RELAXED), &ts);
+
+    if ( deferred )
+    {
+        // Only copy the arguments, the message is rendered by the netlogging thread
+        len = netlogg_fmt_capture(args, sizeof(args), format, ap);
+    }
+    else
+    {
+        // The strings of the caller may not outlive the call: the file is copied and the message rendered now
+        flen            = strnlen(file, FRAME_FILE_MAX);
+        memcpy(args, file, flen);
+        args[flen]      = '\0';
+        errno           = err;
+        n               = vsnprintf(args + flen + 1, sizeof(args) - flen - 1, format, ap);
+        len             = flen + 1 + ( (n > 0) ? (size_t) n : 0);
+        len             = (len < sizeof(args) ) ? len : sizeof(args) - 1;
+        file            = NULL;
+        format          = NULL;
+    }
+
+    if ( bp == NETLOGG_BP_LEVEL )
+    {
+        bp = __atomic_load_n(&gBackpressure[lvl], __ATOMIC_RELAXED);
+    }
+
+    // Copy only the useful bytes in the ring and hand the record over to the netlogging thread (the end of the ring is kept for the critical levels)
+    rec = netlogg_ring_reserve(len, lvl <= NETLOGG_ERROR, bp, __atomic_load_n(&gBlockTimeout, __ATOMIC_RELAXED) );
+
+    if ( rec == NULL )
+    {
+        netlogg_stats_add(NETLOGG_STAT_RING_DROPS, 1);
+        errno = err;
+
+        return (-1);
+    }
+
+    rec->fd     = fd;
+    rec->lvl    = lvl;
+    rec->ts     = (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+    rec->file   = file;
+    rec->format = format;
+    rec->lineno = lineno;
+    rec->err    = err;
+    memcpy(rec->payload, args, len);
+
+    netlogg_ring_commit(rec);
+    netlogg_stats_add(NETLOGG_STAT_MSGS + lvl, 1);
+
+    errno = err;
+
+    return (0);
+}
+
+
+
+static size_t netlogg_format(char                   *buff,
+                             size_t                 size,
+                             const netlogg_record   *rec,
+                             size_t                 *msg_off
+                             )
+{
+    size_t      w = 0;
+    size_t      flen = 0;
+    size_t      len = 0;
+    int         i = 0;
+    struct tm   info;
+    time_t      sec = rec->ts / 1000000000ull;
+    uint32_t    usec = (rec->ts % 1000000000ull) / 1000;
+
+
+    // Keep one byte for the final newline
+    size--;
+
+    // The date only changes once per second
+    if ( sec != ts_sec )
+    {
+        localtime_r(&sec, &info);
+
+        ts_len = strftime(ts_buff, sizeof(ts_buff), "%b %d %Y %H:%M:%S.", &info);
+        ts_sec = sec;
+    }
+
+    memcpy(buff, ts_buff, ts_len);
+    w   = ts_len;
+
+    for ( i = 5; i >= 0; i-- )
+    {
+        buff[w + i] = '0' + usec % 10;
+        usec        /= 10;
+    }
+
+    w   += 6;
+
+    // Add the traces informations and the level
+    w   += snprintf(buff + w, size - w, " - %s:%" PRId32 " - %s - ", netlogg_rec_file(rec), rec->lineno,
+                    (rec->lvl < NETLOGG_LVLS) ? lvl_strs[rec->lvl] : "\033[31mUNKNOWN_LVL\033[0m");
+    w   = (w < size) ? w : size - 1;
+
+    *msg_off = w;
+
+    if ( rec->format != NULL )
+    {
+        w   += netlogg_fmt_render(buff + w, size - w, rec->format, rec->payload, rec->len, rec->err);
+    }
+    else
+    {
+        // Rendered by the caller, after the file name
+        flen    = strlen(rec->payload) + 1;
+        len     = (rec->len - flen < size - w) ? rec->len - flen : size - w;
+        memcpy(buff + w, rec->payload + flen, len);
+        w       += len;
+    }
+
+    buff[w++] = '\n';
+
+    return (w);
+}
+
+
+
+/**
+ * \brief      Compare two file names by address (bsearch and qsort of dict_files)
+ */
+static int netlogg_frame_cmp_files(const void   *a,
+                                   const void   *b
+                                   )
+{
+    uintptr_t   fa  = (uintptr_t) *(const char * const *) a;
+    uintptr_t   fb  = (uintptr_t) *(const char * const *) b;
+
+
+    return ( (fa > fb) - (fa < fb) );
+}
+
+
+
+static size_t netlogg_frame_render(char                     *buff,
+                                   const netlogg_record     *rec,
+                                   const char               *msg,
+                                   size_t                   len
+                                   )
+{
+    netlogg_frame   hdr;
+    const char      **found = NULL;
+    size_t          w       = sizeof(hdr);
+    size_t          flen    = 0;
+
+
+    // Most of the messages come from the same file as the previous one
+    if ( rec->file != dict_last_file )
+    {
+        found           = (nb_dict_files != 0) ? bsearch(&rec->file, dict_files, nb_dict_files, sizeof(*dict_files), netlogg_frame_cmp_files) : NULL;
+        dict_last_file  = rec->file;
+        dict_last_id    = (found != NULL) ? (uint16_t) (found - dict_files) : NETLOGG_FILE_ID_INLINE;
+    }
+
+    // Not a call site of the dictionary (netlogg_send called directly): the name comes with the message
+    if ( dict_last_id == NETLOGG_FILE_ID_INLINE )
+    {
+        flen = strnlen(netlogg_rec_file(rec), FRAME_FILE_MAX);
+        memcpy(buff + w, netlogg_rec_file(rec), flen);
+        buff[w + flen]  = '\0';
+        w               += flen + 1;
+    }
+
+    len = (len < BUFF_SIZE_MAX) ? len : BUFF_SIZE_MAX;
+    memcpy(buff + w, msg, len);
+    w   += len;
+
+    hdr.size    = htole32(w);
+    hdr.type    = NETLOGG_FRAME_MSG;
+    hdr.lvl     = rec->lvl;
+    hdr.file_id = htole16(dict_last_id);
+    hdr.lineno  = htole32(rec->lineno);
+    hdr.ts      = htole64(rec->ts);
+    memcpy(buff, &hdr, sizeof(hdr) );
+
+    return (w);
+}
+
+
+
+static void netlogg_frame_dict_init(void)
+{
+    const netlogg_site  *site   = NULL;
+    netlogg_slab        *slab   = NULL;
+    netlogg_slab        *last   = NULL;
+    netlogg_frame       hdr;
+    char                *buff   = NULL;
+    size_t              len     = 0;
+    uint32_t            n       = 0;
+
+
+    dict_files  = malloc( (__stop_netlogg_sites - __start_netlogg_sites + 1) * sizeof(*dict_files) );
+    dict_iov    = malloc( (__stop_netlogg_sites - __start_netlogg_sites + 1) * sizeof(*dict_iov) );
+    assert( (dict_files != NULL) && (dict_iov != NULL) );
+
+    for ( site = __start_netlogg_sites; site < __stop_netlogg_sites; site++ )
+    {
+        dict_files[n++] = site->file;
+    }
+
+    qsort(dict_files, n, sizeof(*dict_files), netlogg_frame_cmp_files);
+
+    // One id per file, NETLOGG_FILE_ID_INLINE excluded
+    for ( uint32_t i = 0; (i < n) && (nb_dict_files < NETLOGG_FILE_ID_INLINE); i++ )
+    {
+        if ( (nb_dict_files == 0) || (dict_files[nb_dict_files - 1] != dict_files[i]) )
+        {
+            dict_files[nb_dict_files++] = dict_files[i];
+        }
+    }
+
+    // The frames are queued like the messages, so they live in slabs: each slab keeps a reference forever
+    for ( uint32_t i = 0; i <= nb_dict_files; i++ )
+    {
+        len     = (i == 0) ? strlen(NETLOGG_FRAME_HELLO) : sizeof(hdr) + strnlen(dict_files[i - 1], FRAME_FILE_MAX);
+        buff    = netlogg_slab_reserve(&slab, len);
+        assert(buff != NULL);
+
+        if ( slab != last )
+        {
+            __atomic_add_fetch(&slab->refs, 1, __ATOMIC_RELAXED);
+            last = slab;
+        }
+
+        if ( i == 0 )
+        {
+            memcpy(buff, NETLOGG_FRAME_HELLO, len);
+        }
+        else
+        {
+            memset(&hdr, 0, sizeof(hdr) );
+            hdr.size    = htole32(len);
+            hdr.type    = NETLOGG_FRAME_FILE;
+            hdr.file_id = htole16(i - 1);
+            memcpy(buff, &hdr, sizeof(hdr) );
+            memcpy(buff + sizeof(hdr), dict_files[i - 1], len - sizeof(hdr) );
+        }
+
+        slab->used                      += len;
+        dict_iov[nb_dict_iov].iov_base  = buff;
+        dict_iov[nb_dict_iov].iov_len   = len;
+        nb_dict_iov++;
+    }
+}
+
+
+
+static int32_t netlogg_nb_connected_clients(void)
+{
+    return (__atomic_load_n(&nb_connected, __ATOMIC_RELAXED) );
+}
+
+
+
+static void netlogg_queue_depth(uint64_t     *msgs,
+                                uint64_t     *bytes,
+                                uint64_t     *max_bytes
+                                )
+{
+    epoll_fd_ctx    *c  = NULL;
+
+
+    *msgs       = 0;
+    *bytes      = 0;
+    *max_bytes  = 0;
+
+    // The queues of the other workers keep changing: only an estimation
+    for ( uint32_t j = 0; j < nb_workers; j++ )
+    {
+        pthread_mutex_lock(&workers[j].lock);
+
+        for ( uint32_t i = 0; i < workers[j].nb_clients; i++ )
+        {
+            c           = workers[j].clients[i];
+            *msgs       += __atomic_load_n(&c->out_count, __ATOMIC_RELAXED);
+            *bytes      += __atomic_load_n(&c->out_bytes, __ATOMIC_RELAXED);
+            *max_bytes  = (__atomic_load_n(&c->out_bytes, __ATOMIC_RELAXED) > *max_bytes) ? __atomic_load_n(&c->out_bytes, __ATOMIC_RELAXED) : *max_bytes;
+        }
+
+        pthread_mutex_unlock(&workers[j].lock);
+    }
+}
+
+
+
+static epoll_fd_ctx* netlogg_client_alloc(netlogg_worker *w)
+{
+    uint32_t        i       = 0;
+    epoll_fd_ctx    *p      = NULL;
+    epoll_fd_ctx    **tmp   = NULL;
+
+
+    // Grow the pool
+    if ( w->clients_free == NULL )
+    {
+        p = malloc(CLIENTS_CHUNK * sizeof(*p) );
+
+        if ( p == NULL )
+        {
+            return (NULL);
+        }
+
+        for ( i = 0; i < CLIENTS_CHUNK; i++ )
+        {
+            memcpy(&p[i], &client_ctx_tmpl, sizeof(client_ctx_tmpl) );
+            p[i].next       = w->clients_free;
+            w->clients_free = &p[i];
+        }
+    }
+
+    pthread_mutex_lock(&w->lock);
+
+    // Grow the array of the connected clients
+    if ( w->nb_clients == w->clients_size )
+    {
+        tmp = realloc(w->clients, (w->clients_size + CLIENTS_CHUNK) * sizeof(*w->clients) );
+
+        if ( tmp == NULL )
+        {
+            pthread_mutex_unlock(&w->lock);
+
+            return (NULL);
+        }
+
+        w->clients      = tmp;
+        w->clients_size += CLIENTS_CHUNK;
+    }
+
+    p               = w->clients_free;
+    w->clients_free = p->next;
+
+    memcpy(p, &client_ctx_tmpl, sizeof(client_ctx_tmpl) );
+    p->sub_idx                      = SUB_NONE;
+    p->worker                       = w;
+    p->idx                          = w->nb_clients;
+    w->clients[w->nb_clients++]     = p;
+
+    pthread_mutex_unlock(&w->lock);
+
+    return (p);
+}
+
+
+
+static void netlogg_client_add(netlogg_worker               *w,
+                               int                          fd,
+                               const struct sockaddr_in     *addr
+                               )
+{
+    struct epoll_event      ep_ev;
+    epoll_fd_ctx            *c = NULL;
+    char                    ipv4_addr[INET4_ADDRSTRLEN];
+
+
+    inet_ntop(AF_INET, &addr->sin_addr, ipv4_addr, sizeof(ipv4_addr) );
+
+    c = netlogg_client_alloc(w);
+
+    if ( c == NULL )
+    {
+        NETLOGG(NETLOGG_ERROR, "Connection from %s rejected: %m", ipv4_addr);
+        close(fd);
+        __atomic_sub_fetch(&w->load, 1, __ATOMIC_RELAXED);
+        __atomic_sub_fetch(&nb_connected, 1, __ATOMIC_RELAXED);
+
+        return;
+    }
+
+    // Update epoll context
+    c->fd           = fd;
+    c->zip          = 0;
+    c->bin          = 0;
+    c->filter       = -1;
+    netlogg_client_set_lvl(c, NETLOGG_DEBUG);
+    c->ipv4_addr    = strdup(ipv4_addr);
+    c->out_q        = calloc(OUT_QUEUE_MSGS, sizeof(out_msg) );
+
+    getnameinfo( (const struct sockaddr *) addr, sizeof(*addr), c->hostname,
+                 sizeof(c->hostname), c->service, sizeof(c->service), 0);
+
+
+    // Create the event struct
+    c->events       = EPOLLIN | EPOLLHUP | EPOLLERR | EPOLLRDHUP;
+    ep_ev.events    = c->events;
+    ep_ev.data.ptr  = c;
+
+    if ( c->out_q == NULL )
+    {
+        NETLOGG(NETLOGG_ERROR, "calloc: %m");
+        netlogg_close_conn(c);
+    }
+    else if ( epoll_ctl(w->ep_fd, EPOLL_CTL_ADD, fd, &ep_ev) == -1 )
+    {
+        NETLOGG(NETLOGG_ERROR, "epoll_ctl: %m");
+        netlogg_close_conn(c);
+    }
+    else
+    {
+        NETLOGG(NETLOGG_DEBUG,
+                "New client %s added in the epoll loop (%s, %s)",
+                c->ipv4_addr,
+                c->hostname,
+                c->service);
+        NETLOGG(NETLOGG_INFO, "%d clients connected", netlogg_nb_connected_clients() );
+
+        // Print the help
+        handle_help(c, NULL, 0);
+    }
+}
+
+
+
+static netlogg_slab* netlogg_slab_get(void)
+{
+    netlogg_slab     *s = NULL;
+
+
+    pthread_mutex_lock(&slabs_lock);
+    s = slabs_free;
+
+    if ( s != NULL )
+    {
+        slabs_free = s->next;
+    }
+
+    pthread_mutex_unlock(&slabs_lock);
+
+    if ( s == NULL )
+    {
+        s = aligned_alloc(SLAB_SIZE, SLAB_SIZE);
+
+        if ( s == NULL )
+        {
+            return (NULL);
+        }
+    }
+
+    s->refs = 1;
+    s->used = 0;
+
+    return (s);
+}
+
+
+
+static void netlogg_slab_unref(netlogg_slab *s)
+{
+    if ( __atomic_sub_fetch(&s->refs, 1, __ATOMIC_ACQ_REL) != 0 )
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&slabs_lock);
+    s->next     = slabs_free;
+    slabs_free  = s;
+    pthread_mutex_unlock(&slabs_lock);
+}
+
+
+
+static char* netlogg_slab_reserve(netlogg_slab     **s,
+                                  size_t           len
+                                  )
+{
+    netlogg_slab     *n = NULL;
+
+
+    if ( (*s == NULL) || ( (*s)->used + len > SLAB_SIZE - sizeof(netlogg_slab) ) )
+    {
+        n = netlogg_slab_get();
+
+        if ( n == NULL )
+        {
+            return (NULL);
+        }
+
+        // The messages of the full slab keep it alive, only the reference of the writer goes away
+        if ( *s != NULL )
+        {
+            netlogg_slab_unref(*s);
+        }
+
+        *s = n;
+    }
+
+    return ( (*s)->data + (*s)->used);
+}
+
+
+
+static void netlogg_client_release(netlogg_worker *w)
+{
+    epoll_fd_ctx    *p = NULL;
+
+
+    while ( w->clients_closed != NULL )
+    {
+        p                   = w->clients_closed;
+        w->clients_closed   = p->next;
+        p->next             = w->clients_free;
+        w->clients_free     = p;
+    }
+}
+
+
+
+static void netlogg_worker_start(netlogg_worker     *w,
+                                 int                local
+                                 )
+{
+    int     res = -1;
+    struct epoll_event ep_ev;
+
+
+    w->local    = local;
+    w->fiov     = malloc(gBatchSize * sizeof(struct iovec) );
+    assert(w->fiov != NULL);
+    pthread_mutex_init(&w->lock, NULL);
+
+    // The local worker shares the epoll loop of the netlogging thread
+    if ( local )
+    {
+        w->ep_fd = ep_fd;
+
+        return;
+    }
+
+    w->ep_fd    = epoll_create1(EPOLL_CLOEXEC);
+    assert(w->ep_fd != -1);
+
+    memcpy(&w->wake, &worker_ctx_tmpl, sizeof(worker_ctx_tmpl) );
+    w->wake.worker  = w;
+    w->wake.fd      = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    assert(w->wake.fd != -1);
+
+    ep_ev.events    = EPOLLIN;
+    ep_ev.data.ptr  = &w->wake;
+
+    res = epoll_ctl(w->ep_fd, EPOLL_CTL_ADD, w->wake.fd, &ep_ev);
+    assert(res != -1);
+
+    res = pthread_create(&w->thread, NULL, netlogg_worker_run, w);
+    assert(res == 0);
+}
+
+
+
+static void* netlogg_worker_run(void *arg)
+{
+    netlogg_worker     *w   = arg;
+    int                nb   = -1;
+
+
+    for ( ; ; )
+    {
+        nb = epoll_wait(w->ep_fd, w->levents, MAXEVENTS, -1);
+        netlogg_stats_add(NETLOGG_STAT_SC_EPOLL_WAIT, 1);
+
+        if ( nb == -1 )
+        {
+            if ( errno != EINTR )
+            {
+                NETLOGG(NETLOGG_ERROR, "%s: Invalide: %m", __FUNCTION__);
+            }
+
+            continue;
+        }
+
+        for ( int i = 0; i < nb; ++i )
+        {
+            epoll_fd_ctx     *p = w->levents[i].data.ptr;
+
+            // Assertions
+            assert(p);
+            assert(p->handler);
+
+
+            // Traitement de l'événement
+            (*p->handler)(p, w->levents[i].events);
+        }
+
+        netlogg_client_release(w);
+    }
+
+    return (NULL);
+}
+
+
+
+static void netlogg_worker_push(netlogg_worker      *w,
+                                const netlogg_job   *job
+                                )
+{
+    netlogg_job     *tmp    = NULL;
+    uint32_t        wake    = 0;
+
+
+    pthread_mutex_lock(&w->lock);
+
+    if ( w->nb_jobs == w->jobs_size )
+    {
+        tmp = realloc(w->jobs, (w->jobs_size + JOBS_CHUNK) * sizeof(*tmp) );
+
+        if ( tmp == NULL )
+        {
+            pthread_mutex_unlock(&w->lock);
+            NETLOGG(NETLOGG_ERROR, "%s - realloc: %m", __FUNCTION__);
+
+            // The job is lost
+            if ( job->batch != NULL )
+            {
+                netlogg_batch_unref(job->batch);
+            }
+            else
+            {
+                close(job->fd);
+                __atomic_sub_fetch(&w->load, 1, __ATOMIC_RELAXED);
+                __atomic_sub_fetch(&nb_connected, 1, __ATOMIC_RELAXED);
+            }
+
+            return;
+        }
+
+        w->jobs         = tmp;
+        w->jobs_size    += JOBS_CHUNK;
+    }
+
+    // Only the first job of the inbox wakes the worker up
+    wake                    = (w->nb_jobs == 0);
+    w->jobs[w->nb_jobs++]   = *job;
+
+    pthread_mutex_unlock(&w->lock);
+
+    if ( wake )
+    {
+        eventfd_write(w->wake.fd, 1);
+        netlogg_stats_add(NETLOGG_STAT_SC_EVENTFD_WRITE, 1);
+    }
+}
+
+
+
+static void netlogg_worker_handle_jobs(struct epoll_fd_ctx  *p,
+                                       unsigned long        events
+                                       )
+{
+    netlogg_worker  *w      = p->worker;
+    netlogg_job     *jobs   = NULL;
+    uint32_t        nb      = 0;
+    uint32_t        size    = 0;
+    uint32_t        i       = 0;
+    eventfd_t       value   = 0;
+
+
+    eventfd_read(p->fd, &value);
+
+    // Take the whole inbox at once, the netlogging thread fills the other array meanwhile
+    pthread_mutex_lock(&w->lock);
+    jobs            = w->jobs;
+    nb              = w->nb_jobs;
+    size            = w->jobs_size;
+    w->jobs         = w->jobs_run;
+    w->jobs_size    = w->jobs_run_size;
+    w->nb_jobs      = 0;
+    pthread_mutex_unlock(&w->lock);
+
+    for ( i = 0; i < nb; i++ )
+    {
+        if ( jobs[i].batch != NULL )
+        {
+            netlogg_worker_send(w, jobs[i].batch);
+            netlogg_batch_unref(jobs[i].batch);
+        }
+        else
+        {
+            netlogg_client_add(w, jobs[i].fd, &jobs[i].addr);
+        }
+    }
+
+    w->jobs_run         = jobs;
+    w->jobs_run_size    = size;
+}
+
+
+
+/**
+ * \brief      Send messages of a batch to a client, add the latency of the oldest message of the batch to the histogram
+ *
+ * \param      p       The epoll context of the client
+ * \param[in]  b       The batch
+ * \param[in]  iov     The messages
+ * \param[in]  iovcnt  The number of messages
+ */
+static void netlogg_batch_write(struct epoll_fd_ctx     *p,
+                                const netlogg_batch     *b,
+                                const struct iovec      *iov,
+                                uint32_t                iovcnt
+                                )
+{
+    struct timespec     ts;
+    uint64_t            now = 0;
+
+
+    netlogg_client_write(p, iov, iovcnt);
+
+    clock_gettime(__atomic_load_n(&gClock, __ATOMIC_RELAXED), &ts);
+    now = (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+
+    netlogg_stats_latency( (now > b->ts) ? now - b->ts : 0);
+}
+
+
+
+static void netlogg_worker_send(netlogg_worker          *w,
+                                const netlogg_batch     *b
+                                )
+{
+    uint32_t    i   = 0;
+    uint32_t    n   = 0;
+    int         l   = 0;
+
+
+    if ( b->fd != -1 )
+    {
+        // Send to a specific connected client
+        for ( i = 0; i < w->nb_clients; i++ )
+        {
+            if ( (w->clients[i]->fd == b->fd) && (b->lvl <= w->clients[i]->lvl) )
+            {
+                if ( w->clients[i]->bin )
+                {
+                    if ( b->bin )
+                    {
+                        netlogg_batch_write(w->clients[i], b, b->biov[b->lvl], b->iovcnt[b->lvl]);
+                    }
+                }
+                else if ( ! w->clients[i]->zip )
+                {
+                    netlogg_batch_write(w->clients[i], b, b->iov[b->lvl], b->iovcnt[b->lvl]);
+                }
+                else if ( b->ziov[b->lvl].iov_len != 0 )
+                {
+                    netlogg_batch_write(w->clients[i], b, &b->ziov[b->lvl], 1);
+                }
+
+                break;
+            }
+        }
+
+        return;
+    }
+
+    // Only visit the clients that want the messages. The lists are parsed backward: a client closed by
+    // netlogg_client_write is replaced by the last one of its list
+    for ( l = NETLOGG_LVLS - 1; l >= 0; l-- )
+    {
+        if ( b->iovcnt[l] != 0 )
+        {
+            for ( i = w->nb_subs[l]; i-- > 0; )
+            {
+                if ( w->subs[l][i]->filter != -1 )
+                {
+                    n = netlogg_batch_filter(b, w->subs[l][i], w->fiov);
+
+                    if ( n != 0 )
+                    {
+                        netlogg_batch_write(w->subs[l][i], b, w->fiov, n);
+                    }
+                }
+                // A batch published before the client asked for compression (or frames) has none: never mix text in the stream
+                else if ( w->subs[l][i]->bin )
+                {
+                    if ( b->bin )
+                    {
+                        netlogg_batch_write(w->subs[l][i], b, b->biov[l], b->iovcnt[l]);
+                    }
+                }
+                else if ( ! w->subs[l][i]->zip )
+                {
+                    netlogg_batch_write(w->subs[l][i], b, b->iov[l], b->iovcnt[l]);
+                }
+                else if ( b->ziov[l].iov_len != 0 )
+                {
+                    netlogg_batch_write(w->subs[l][i], b, &b->ziov[l], 1);
+                }
+            }
+        }
+    }
+}
+
+
+
+static uint32_t netlogg_batch_filter(const netlogg_batch          *b,
+                                     const struct epoll_fd_ctx    *p,
+                                     struct iovec                 *fiov
+                                     )
+{
+    const struct iovec  *iov    = p->bin ? b->biov[NETLOGG_DEBUG] : b->iov[NETLOGG_DEBUG];
+    uint64_t            bit     = 1ull << p->filter;
+    uint32_t            n       = 0;
+
+
+    // A batch published before the client asked for frames has none
+    if ( p->bin && ! b->bin )
+    {
+        return (0);
+    }
+
+    // The debug level has every message of the batch, in order
+    for ( uint32_t i = 0; i < b->count; i++ )
+    {
+        if ( (b->fmask[i] & bit) && (b->lvls[i] <= p->lvl) )
+        {
+            fiov[n++] = iov[i];
+        }
+    }
+
+    return (n);
+}
+
+
+
+static void netlogg_client_set_lvl(struct epoll_fd_ctx    *p,
+                                   Netlogging_lvl         lvl
+                                   )
+{
+    netlogg_subs_del(p);
+    p->lvl = lvl;
+    netlogg_subs_add(p);
+
+    netlogg_update_max_lvl();
+}
+
+
+
+static void netlogg_client_set_zip(struct epoll_fd_ctx    *p,
+                                   int                    on
+                                   )
+{
+    if ( p->zip == on )
+    {
+        return;
+    }
+
+    netlogg_subs_del(p);
+    p->zip = on;
+    netlogg_subs_add(p);
+
+    if ( on )
+    {
+        __atomic_add_fetch(&zip_clients, 1, __ATOMIC_RELAXED);
+    }
+    else
+    {
+        __atomic_sub_fetch(&zip_clients, 1, __ATOMIC_RELAXED);
+    }
+}
+
+
+
+static void netlogg_client_set_bin(struct epoll_fd_ctx    *p,
+                                   int                    on
+                                   )
+{
+    if ( p->bin == on )
+    {
+        return;
+    }
+
+    p->bin = on;
+
+    if ( on )
+    {
+        __atomic_add_fetch(&bin_clients, 1, __ATOMIC_RELAXED);
+    }
+    else
+    {
+        __atomic_sub_fetch(&bin_clients, 1, __ATOMIC_RELAXED);
+    }
+}
+
+
+
+static void netlogg_subs_add(struct epoll_fd_ctx *p)
+{
+    netlogg_worker  *w      = p->worker;
+    epoll_fd_ctx    **tmp   = NULL;
+
+
+    if ( w->nb_subs[p->lvl] == w->subs_size[p->lvl] )
+    {
+        tmp = realloc(w->subs[p->lvl], (w->subs_size[p->lvl] + CLIENTS_CHUNK) * sizeof(*tmp) );
+
+        if ( tmp == NULL )
+        {
+            NETLOGG(NETLOGG_ERROR, "%s - realloc: %m", __FUNCTION__);
+
+            return;
+        }
+
+        w->subs[p->lvl]         = tmp;
+        w->subs_size[p->lvl]    += CLIENTS_CHUNK;
+    }
+
+    p->sub_idx                              = w->nb_subs[p->lvl];
+    w->subs[p->lvl][w->nb_subs[p->lvl]++]   = p;
+    __atomic_add_fetch(&subs_total[p->lvl], 1, __ATOMIC_RELAXED);
+
+    if ( p->zip )
+    {
+        __atomic_add_fetch(&subs_zip[p->lvl], 1, __ATOMIC_RELAXED);
+    }
+}
+
+
+
+static void netlogg_subs_del(struct epoll_fd_ctx *p)
+{
+    netlogg_worker  *w = p->worker;
+
+
+    if ( p->sub_idx == SUB_NONE )
+    {
+        return;
+    }
+
+    // The last client of the list takes its place
+    w->subs[p->lvl][p->sub_idx]             = w->subs[p->lvl][--w->nb_subs[p->lvl]];
+    w->subs[p->lvl][p->sub_idx]->sub_idx    = p->sub_idx;
+    p->sub_idx                              = SUB_NONE;
+    __atomic_sub_fetch(&subs_total[p->lvl], 1, __ATOMIC_RELAXED);
+
+    if ( p->zip )
+    {
+        __atomic_sub_fetch(&subs_zip[p->lvl], 1, __ATOMIC_RELAXED);
+    }
+}
+
+
+
+static Netlogging_lvl netlogg_args_lvl(Netlogging_lvl lvl)
+{
+    if ( lvl == NETLOGG_LVL_EMERG_ONLY )
+    {
+        return (NETLOGG_EMERG);
+    }
+
+    return ( ( (lvl == NETLOGG_EMERG) || ( (unsigned) lvl >= NETLOGG_LVLS) ) ? gLvl : lvl);
+}
+
+
+
+static void netlogg_update_max_lvl(void)
+{
+    int     max = NETLOGG_LVLS - 1;
+
+
+    // The last update always sees the last change of subs_total
+    pthread_mutex_lock(&lvl_lock);
+
+    // Highest level with a client
+    while ( (max >= 0) && (__atomic_load_n(&subs_total[max], __ATOMIC_RELAXED) == 0) )
+    {
+        max--;
+    }
+
+    max = (max > (int) gLvl) ? max : (int) gLvl;
+    max = (max > (int) gHistoryLvl) ? max : (int) gHistoryLvl;
+    max = (gFile && (max < (int) gFileLvl) ) ? (int) gFileLvl : max;
+
+    if ( max != __atomic_load_n(&netlogg_max_lvl, __ATOMIC_RELAXED) )
+    {
+        __atomic_store_n(&netlogg_max_lvl, max, __ATOMIC_RELAXED);
+        netlogg_lvl_gen_bump();
+    }
+
+    pthread_mutex_unlock(&lvl_lock);
+}
+
+
+
+static void netlogg_lvl_gen_bump(void)
+{
+    // The sites never computed have a generation of 0
+    if ( (__atomic_add_fetch(&netlogg_lvl_gen, 1, __ATOMIC_RELEASE) & 0xFFFFFF) == 0 )
+    {
+        __atomic_add_fetch(&netlogg_lvl_gen, 1, __ATOMIC_RELEASE);
+    }
+}
+
+
+
+uint32_t netlogg_site_refresh(netlogg_site *site)
+{
+    uint32_t    gen     = __atomic_load_n(&netlogg_lvl_gen, __ATOMIC_ACQUIRE) & 0xFFFFFF;
+    int         lvl     = netlogg_levels_get(site->file);
+    int         max     = __atomic_load_n(&netlogg_max_lvl, __ATOMIC_RELAXED);
+    uint32_t    word    = (gen << 8) | (uint32_t) ( (lvl < max) ? lvl : max);
+
+
+    // A change made meanwhile has a new generation: the site computes it again on its next call
+    __atomic_store_n(&site->lvl_cache, word, __ATOMIC_RELAXED);
+
+    return (word);
+}
+
+
+
+/**
+ * \brief      Add a string to the string table of the flight recorder
+ *
+ * \param      strtab  The string table (NULL to only compute the size)
+ * \param[in]  off     Offset of the entry in the table
+ * \param[in]  str     The string
+ *
+ * \return     Offset of the next entry
+ */
+static size_t netlogg_recorder_str(char         *strtab,
+                                   size_t       off,
+                                   const char   *str
+                                   )
+{
+    netlogg_rec_str     *e      = NULL;
+    size_t              len     = strlen(str);
+    size_t              size    = (sizeof(netlogg_rec_str) + len + 1 + 7) & ~( (size_t) 7);
+
+
+    if ( strtab != NULL )
+    {
+        e       = (netlogg_rec_str *) (strtab + off);
+        e->ptr  = (uintptr_t) str;
+        e->len  = len;
+        e->size = size;
+        memcpy(e->str, str, len + 1);
+    }
+
+    return (off + size);
+}
+
+
+
+static void netlogg_recorder_open(const char *path)
+{
+    const netlogg_site  *site   = NULL;
+    const char          *file   = NULL;
+    char                *strtab = NULL;
+    size_t              len     = 0;
+
+
+    // First pass for the size, second one to fill the table (the sites of a file follow each other)
+    for ( int pass = 0; pass < 2; pass++ )
+    {
+        len     = 0;
+        file    = NULL;
+
+        for ( site = __start_netlogg_sites; site < __stop_netlogg_sites; site++ )
+        {
+            if ( site->file != file )
+            {
+                file    = site->file;
+                len     = netlogg_recorder_str(strtab, len, file);
+            }
+
+            len = netlogg_recorder_str(strtab, len, site->format);
+        }
+
+        if ( pass == 0 )
+        {
+            strtab = calloc(1, len + 1);
+            assert(strtab != NULL);
+        }
+    }
+
+    // The table is kept for netlogg_recorder_dump
+    if ( netlogg_ring_record(path, strtab, len) == -1 )
+    {
+        NETLOGG(NETLOGG_ERROR, "%s - %s: %m", __FUNCTION__, path);
+    }
+}
+
+
+
+int netlogg_recorder_dump(int fd)
+{
+    return (netlogg_ring_dump(fd) );
+}
+
+
+
+static void netlogg_handle_new_connection(struct epoll_fd_ctx   *p,
+                                          unsigned long         events
+                                          )
+{
+    int     new_fd  = -1;
+    struct sockaddr_in      remote_sockaddr;
+    socklen_t               r_sz = sizeof(remote_sockaddr);
+    uint32_t                i = 0;
+    netlogg_worker          *w = NULL;
+    netlogg_job             job;
+    static const char       too_many[] = "Too many clients connected\n";
+
+
+    for ( ; ; )
+    {
+        /* Accept the new remote connection
+         */
+        r_sz    = sizeof(remote_sockaddr);
+        new_fd  = accept4(p->fd, (struct sockaddr *) &remote_sockaddr, &r_sz, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+        if ( new_fd == -1 )
+        {
+            if ( (errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != ECONNABORTED) )
+            {
+                NETLOGG(NETLOGG_ERROR, "accept: %m");
+            }
+
+            return;
+        }
+
+        NETLOGG(NETLOGG_DEBUG, "Accept new remote connection");
+
+        /* Reject the connection if there are too many clients
+         */
+        if ( netlogg_nb_connected_clients() >= (int32_t) gMaxClients )
+        {
+            NETLOGG(NETLOGG_WARN, "Connection from %s rejected: %" PRId32 " clients connected", inet_ntoa(remote_sockaddr.sin_addr), netlogg_nb_connected_clients() );
+            send(new_fd, too_many, sizeof(too_many) - 1, MSG_NOSIGNAL | MSG_DONTWAIT);
+            close(new_fd);
+            continue;
+        }
+
+        /* Give it to the worker with the fewest clients
+         */
+        w = &workers[0];
+
+        for ( i = 1; i < nb_workers; i++ )
+        {
+            if ( __atomic_load_n(&workers[i].load, __ATOMIC_RELAXED) < __atomic_load_n(&w->load, __ATOMIC_RELAXED) )
+            {
+                w = &workers[i];
+            }
+        }
+
+        __atomic_add_fetch(&w->load, 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&nb_connected, 1, __ATOMIC_RELAXED);
+
+        if ( w->local )
+        {
+            netlogg_client_add(w, new_fd, &remote_sockaddr);
+        }
+        else
+        {
+            job.batch   = NULL;
+            job.fd      = new_fd;
+            job.addr    = remote_sockaddr;
+            netlogg_worker_push(w, &job);
+        }
+    }
+}
+
+
+
+static void netlogg_handle_metrics_connection(struct epoll_fd_ctx   *p,
+                                              unsigned long         events
+                                              )
+{
+    int                     fd  = -1;
+    metrics_conn            *m  = NULL;
+    struct timespec         now;
+    struct epoll_event      ep_ev;
+
+
+    for ( ; ; )
+    {
+        fd = accept4(p->fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+        if ( fd == -1 )
+        {
+            if ( (errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != ECONNABORTED) )
+            {
+                NETLOGG(NETLOGG_ERROR, "%s - accept: %m", __FUNCTION__);
+            }
+
+            return;
+        }
+
+        // A peer opening connections without sending anything does not hold more than METRICS_CONNS_MAX of them
+        if ( metrics_nb_conns == METRICS_CONNS_MAX )
+        {
+            close(fd);
+            continue;
+        }
+
+        for ( m = metrics_conns; m->deadline_ms != 0; m++ )
+        {
+        }
+
+        // Answered once the request is there, so that closing the connection does not reset it
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        memcpy(&m->ctx, &metrics_ctx_tmpl, sizeof(m->ctx) );
+        m->ctx.fd       = fd;
+        ep_ev.events    = EPOLLIN | EPOLLHUP | EPOLLERR | EPOLLRDHUP;
+        ep_ev.data.ptr  = &m->ctx;
+
+        if ( epoll_ctl(ep_fd, EPOLL_CTL_ADD, fd, &ep_ev) == -1 )
+        {
+            NETLOGG(NETLOGG_ERROR, "%s - %m", __FUNCTION__);
+            close(fd);
+            continue;
+        }
+
+        m->deadline_ms = (uint64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000 + METRICS_TIMEOUT_MS;
+        metrics_nb_conns++;
+    }
+}
+
+
+
+/**
+ * \brief      Close a connection of the metrics endpoint and free its slot
+ *
+ * \param      m     The connection
+ */
+static void netlogg_metrics_close(metrics_conn *m)
+{
+    epoll_ctl(ep_fd, EPOLL_CTL_DEL, m->ctx.fd, NULL);
+    close(m->ctx.fd);
+    m->ctx.fd       = -1;
+    m->deadline_ms  = 0;
+    metrics_nb_conns--;
+}
+
+
+
+static int netlogg_metrics_expire(void)
+{
+    uint64_t            now     = 0;
+    uint64_t            next    = UINT64_MAX;
+    struct timespec     ts;
+
+
+    if ( metrics_nb_conns == 0 )
+    {
+        return (-1);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    now = (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+
+    for ( uint32_t i = 0; i < METRICS_CONNS_MAX; i++ )
+    {
+        if ( metrics_conns[i].deadline_ms == 0 )
+        {
+            continue;
+        }
+
+        if ( now >= metrics_conns[i].deadline_ms )
+        {
+            netlogg_metrics_close(&metrics_conns[i]);
+        }
+        else if ( metrics_conns[i].deadline_ms < next )
+        {
+            next = metrics_conns[i].deadline_ms;
+        }
+    }
+
+    return ( (next == UINT64_MAX) ? -1 : (int) (next - now) );
+}
+
+
+
+static void netlogg_handle_metrics_scrape(struct epoll_fd_ctx   *p,
+                                          unsigned long         events
+                                          )
+{
+    netlogg_stats   sum;
+    char            req[1024];
+    uint64_t        msgs        = 0;
+    uint64_t        bytes       = 0;
+    uint64_t        max_bytes   = 0;
+    size_t          w           = 0;
+    size_t          hdr         = 0;
+    char            head[128];
+
+
+    // Any request gets the metrics
+    while ( recv(p->fd, req, sizeof(req), MSG_DONTWAIT) > 0 )
+    {
+    }
+
+    netlogg_stats_read(&sum);
+    netlogg_queue_depth(&msgs, &bytes, &max_bytes);
+
+    w   = netlogg_stats_prometheus(metrics_buff, sizeof(metrics_buff), &sum);
+    w   += snprintf(metrics_buff + w, sizeof(metrics_buff) - w,
+                    "# HELP netlogging_clients Connected clients.\n# TYPE netlogging_clients gauge\nnetlogging_clients %" PRId32 "\n"
+                    "# HELP netlogging_queue_messages Messages waiting in the output queues of the clients.\n# TYPE netlogging_queue_messages gauge\nnetlogging_queue_messages %" PRIu64 "\n"
+                    "# HELP netlogging_queue_bytes Bytes waiting in the output queues of the clients.\n# TYPE netlogging_queue_bytes gauge\nnetlogging_queue_bytes %" PRIu64 "\n"
+                    "# HELP netlogging_queue_bytes_max Bytes waiting for the slowest client.\n# TYPE netlogging_queue_bytes_max gauge\nnetlogging_queue_bytes_max %" PRIu64 "\n",
+                    netlogg_nb_connected_clients(), msgs, bytes, max_bytes);
+    w   = (w < sizeof(metrics_buff) ) ? w : sizeof(metrics_buff) - 1;
+    hdr = snprintf(head, sizeof(head), "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %zu\r\n\r\n", w);
+
+    // A new connection has room for the answer in its socket buffer
+    if ( (send(p->fd, head, hdr, MSG_NOSIGNAL | MSG_DONTWAIT | MSG_MORE) != (ssize_t) hdr) ||
+         (send(p->fd, metrics_buff, w, MSG_NOSIGNAL | MSG_DONTWAIT) != (ssize_t) w) )
+    {
+        NETLOGG(NETLOGG_WARN, "%s - metrics not sent: %m", __FUNCTION__);
+    }
+
+    netlogg_metrics_close( (metrics_conn *) p);
+}
+
+
+
+static void netlogg_handle_comm(struct epoll_fd_ctx *p,
+                                unsigned long       events
+                                )
+{
+    char        buff[BUFF_SIZE_MAX];
+    ssize_t     r = -1;
+
+
+    // Closed by a previous event of the same loop
+    if ( p->fd == -1 )
+    {
+        return;
+    }
+
+    if ( events & EPOLLIN )
+    {
+        r = recv(p->fd, buff, sizeof(buff) - 1, 0);
+
+        if ( (r == -1) && (errno != EAGAIN) && (errno != EWOULDBLOCK) )
+        {
+            NETLOGG(NETLOGG_ERROR, "recv: %m");
+        }
+
+        if ( r == 0 )
+        {
+            NETLOGG(NETLOGG_DEBUG, "No bytes received from %s. We are going to close it.", p->ipv4_addr);
+        }
+        else if ( r > 0 )
+        {
+            uint32_t     i = 0;
+
+
+            buff[r] = 0;
+
+            // Remove carriage return and newline feed if found
+            buff[strcspn(buff, "\r\n")] = 0;
+
+
+            if ( strlen(buff) != 0 )
+            {
+                // Parse all the commands, if found we use the associated function
+                for ( i = 0; i < NBELEMS(recv_cmds); ++i )
+                {
+                    if ( strncmp(recv_cmds[i].cmd, buff, strlen(recv_cmds[i].cmd) ) == 0 )
+                    {
+                        if ( recv_cmds[i].handler != NULL )
+                        {
+                            NETLOGG(NETLOGG_DEBUG, "Receive the command \"%s\" from %s (%s)", buff, p->hostname, p->ipv4_addr);
+                            (*recv_cmds[i].handler)(p, buff, r);
+                        }
+
+                        break;
+                    }
+                }
+
+                // If the command is not known, we trace it as a warning
+                if ( i == NBELEMS(recv_cmds) )
+                {
+                    NETLOGG(NETLOGG_WARN, "Unknown command from %s: %s", p->ipv4_addr, buff);
+                    NETLOGG(NETLOGG_DEBUG, "Receive %zd bytes from %s (fd: %d) - unused", strlen(buff), p->ipv4_addr, p->fd);
+                }
+            }
+        }
+        else if ( p->fd == -1 )
+        {
+            NETLOGG(NETLOGG_ERROR, "p->fd == -1");
+
+            return;
+        }
+    }
+
+    if ( events & EPOLLRDHUP )
+    {
+        NETLOGG(NETLOGG_INFO, "Closing connection (EPOLLRDHUP)");
+        netlogg_close_conn(p);
+    }
+
+    if ( events & EPOLLERR )
+    {
+        NETLOGG(NETLOGG_INFO, "Closing connection (EPOLLERR)");
+        netlogg_close_conn(p);
+    }
+
+    if ( events & EPOLLHUP )
+    {
+        NETLOGG(NETLOGG_INFO, "Closing connection (EPOLLHUP)");
+        netlogg_close_conn(p);
+    }
 
-    if ( res == -1 )
+    if ( (events & EPOLLOUT) && (p->fd != -1) )
     {
-        NETLOGG(NETLOGG_ERROR, "%s - listen: %m", __FUNCTION__);
-        assert(res != -1);
+        netlogg_client_flush(p);
     }
+}
 
-    ep_ev.events    = EPOLLIN | EPOLLHUP | EPOLLERR | EPOLLRDHUP;
-    ep_ev.data.ptr  = &netlogger_ctx[EPOLL_FD_LISTEN];
 
 
-    // Ajout du contexte de la socket d'écoute  dans la table des evenements epoll
-    res             = epoll_ctl(ep_fd, EPOLL_CTL_ADD, netlogger_ctx[EPOLL_FD_LISTEN].fd, &ep_ev);
+static void netlogg_client_write(struct epoll_fd_ctx    *p,
+                                 const struct iovec     *iov,
+                                 uint32_t               iovcnt
+                                 )
+{
+    uint32_t    i       = 0;
+    ssize_t     sent    = 0;
+    struct msghdr   msg;
 
-    if ( res == -1 )
+
+    // Nothing is waiting: try to send everything right now
+    if ( p->out_count == 0 )
     {
-        NETLOGG(NETLOGG_ERROR, "%s - epoll_ctl: %m", __FUNCTION__);
-        assert(res != -1);
+        memset(&msg, 0, sizeof(msg) );
+        msg.msg_iov     = (struct iovec *) iov;
+        msg.msg_iovlen  = iovcnt;
+        sent            = sendmsg(p->fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+        netlogg_stats_add(NETLOGG_STAT_SC_SENDMSG, 1);
+
+        if ( sent == -1 )
+        {
+            if ( (errno != EAGAIN) && (errno != EWOULDBLOCK) )
+            {
+                NETLOGG(NETLOGG_ERROR, "%s - sendmsg: %m", __FUNCTION__);
+                netlogg_close_conn(p);
+
+                return;
+            }
+
+            sent = 0;
+        }
+
+        netlogg_stats_add(NETLOGG_STAT_SENT_BYTES, sent);
+
+        // Skip the messages completely sent
+        while ( (i < iovcnt) && ( (size_t) sent >= iov[i].iov_len) )
+        {
+            sent -= iov[i].iov_len;
+            i++;
+        }
+    }
+
+    // Queue the rest, the first one may be partially sent
+    for ( ; (i < iovcnt) && (p->fd != -1); i++ )
+    {
+        netlogg_client_queue(p, iov[i].iov_base, iov[i].iov_len, sent);
+        sent = 0;
     }
+}
 
-    // Create socket pair
-    res             = socketpair(AF_UNIX, SOCK_STREAM, 0, sv);
 
-    if ( res == -1 )
+
+static void netlogg_client_queue(struct epoll_fd_ctx    *p,
+                                 const char             *buff,
+                                 size_t                 len,
+                                 size_t                 off
+                                 )
+{
+    netlogg_worker  *w      = p->worker;
+    netlogg_slab    *slab   = SLAB_OF(buff);
+    netlogg_slab    *tail   = NULL;
+    char            *copy   = NULL;
+    out_msg         *m      = NULL;
+
+
+    // The client is too slow
+    while ( (p->out_count == OUT_QUEUE_MSGS) || (p->out_bytes + len - off > gOutQueueSize) )
     {
-        NETLOGG(NETLOGG_ERROR, "%s - socketpair: %m", __FUNCTION__);
-        assert(res != -1);
+        if ( gOverflow == NETLOGG_OVERFLOW_DISCONNECT )
+        {
+            NETLOGG(NETLOGG_WARN, "Client %s is too slow (%zu bytes waiting)", p->ipv4_addr, p->out_bytes);
+            netlogg_close_conn(p);
+
+            return;
+        }
+
+        if ( (gOverflow == NETLOGG_OVERFLOW_DROP_NEWEST) || ! netlogg_client_drop_oldest(p) )
+        {
+            p->dropped++;
+            netlogg_stats_add(NETLOGG_STAT_CLIENT_DROPS, 1);
+
+            return;
+        }
+    }
+
+    if ( p->out_count != 0 )
+    {
+        tail = SLAB_OF(p->out_q[(p->out_head + p->out_count - 1) & (OUT_QUEUE_MSGS - 1)].data);
+    }
+
+    // The rare messages of a slow client would keep many slabs alive: copy them next to each other instead
+    if ( (slab != tail) && (p->out_slabs >= OUT_QUEUE_SLABS) )
+    {
+        copy = netlogg_slab_reserve(&w->copy, len);
+
+        if ( copy == NULL )
+        {
+            p->dropped++;
+            netlogg_stats_add(NETLOGG_STAT_CLIENT_DROPS, 1);
+
+            return;
+        }
+
+        memcpy(copy, buff, len);
+        w->copy->used   += len;
+        buff            = copy;
+        slab            = w->copy;
+    }
+
+    if ( slab != tail )
+    {
+        p->out_slabs++;
+    }
+
+    __atomic_add_fetch(&slab->refs, 1, __ATOMIC_RELAXED);
+
+    m       = &p->out_q[(p->out_head + p->out_count) & (OUT_QUEUE_MSGS - 1)];
+    m->data = buff;
+    m->len  = len;
+    m->off  = off;
+
+    p->out_count++;
+    p->out_bytes += len - off;
+
+    netlogg_client_watch(p, p->events | EPOLLOUT);
+}
+
+
+
+static void netlogg_client_flush(struct epoll_fd_ctx *p)
+{
+    uint32_t    i       = 0;
+    uint32_t    n       = 0;
+    ssize_t     sent    = 0;
+    size_t      total   = 0;
+    out_msg     *m      = NULL;
+    struct iovec    iov[OUT_QUEUE_IOV];
+    struct msghdr   msg;
+
+
+    do
+    {
+        while ( p->out_count != 0 )
+        {
+            // Send the oldest messages at once
+            n       = (p->out_count < OUT_QUEUE_IOV) ? p->out_count : OUT_QUEUE_IOV;
+            total   = 0;
+
+            for ( i = 0; i < n; i++ )
+            {
+                m               = &p->out_q[(p->out_head + i) & (OUT_QUEUE_MSGS - 1)];
+                iov[i].iov_base = (char *) m->data + m->off;
+                iov[i].iov_len  = m->len - m->off;
+                total           += iov[i].iov_len;
+            }
+
+            memset(&msg, 0, sizeof(msg) );
+            msg.msg_iov     = iov;
+            msg.msg_iovlen  = n;
+            sent            = sendmsg(p->fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+            netlogg_stats_add(NETLOGG_STAT_SC_SENDMSG, 1);
+
+            if ( sent == -1 )
+            {
+                if ( (errno != EAGAIN) && (errno != EWOULDBLOCK) )
+                {
+                    NETLOGG(NETLOGG_ERROR, "%s - sendmsg: %m", __FUNCTION__);
+                    netlogg_close_conn(p);
+                }
+
+                return;
+            }
+
+            netlogg_stats_add(NETLOGG_STAT_SENT_BYTES, sent);
+
+            p->out_bytes    -= sent;
+            total           -= sent;
+
+            // Free the messages completely sent
+            while ( sent > 0 )
+            {
+                m = &p->out_q[p->out_head];
+
+                if ( (size_t) sent < m->len - m->off )
+                {
+                    m->off += sent;
+                    break;
+                }
+
+                sent -= m->len - m->off;
+                netlogg_client_pop(p);
+            }
+
+            // The socket buffer is full
+            if ( total != 0 )
+            {
+                return;
+            }
+        }
+
+        // Everything is sent: go on with the history asked by the client
+        if ( p->replay != p->replay_end )
+        {
+            netlogg_client_replay(p);
+        }
+    } while ( p->out_count != 0 );
+
+    // Everything is sent: stop watching EPOLLOUT
+    netlogg_client_watch(p, p->events & ~EPOLLOUT);
+}
+
+
+
+static void netlogg_client_replay(struct epoll_fd_ctx *p)
+{
+    history_msg     *h = NULL;
+
+
+    pthread_mutex_lock(&history_lock);
+
+    // The oldest messages asked may be forgotten since
+    if ( p->replay < history_head )
+    {
+        p->replay = history_head;
+    }
+
+    while ( (p->replay < p->replay_end) && (p->fd != -1) )
+    {
+        h = &history[p->replay & (gHistoryMsgs - 1)];
+
+        if ( (p->out_count == OUT_QUEUE_MSGS) || (p->out_bytes + h->len > gOutQueueSize) )
+        {
+            break;
+        }
+
+        if ( h->lvl <= p->lvl )
+        {
+            netlogg_client_queue(p, h->data, h->len, 0);
+        }
+
+        p->replay++;
+    }
+
+    pthread_mutex_unlock(&history_lock);
+}
+
+
+
+static void netlogg_history_add(const char      *data,
+                                size_t          len,
+                                uint64_t        ts,
+                                Netlogging_lvl  lvl
+                                )
+{
+    history_msg     *h      = NULL;
+    netlogg_slab    *slab   = SLAB_OF(data);
+    netlogg_slab    *last   = NULL;
+
+
+    pthread_mutex_lock(&history_lock);
+
+    if ( history_tail - history_head == gHistoryMsgs )
+    {
+        netlogg_history_pop();
+    }
+
+    if ( history_tail != history_head )
+    {
+        last = SLAB_OF(history[(history_tail - 1) & (gHistoryMsgs - 1)].data);
+    }
+
+    // One reference for each run of messages of the same slab
+    if ( slab != last )
+    {
+        __atomic_add_fetch(&slab->refs, 1, __ATOMIC_RELAXED);
+        history_slabs++;
+    }
+
+    h       = &history[history_tail & (gHistoryMsgs - 1)];
+    h->data = data;
+    h->len  = len;
+    h->lvl  = lvl;
+    h->ts   = ts;
+    history_tail++;
+
+    while ( history_slabs > gHistorySlabs )
+    {
+        netlogg_history_pop();
+    }
+
+    pthread_mutex_unlock(&history_lock);
+}
+
+
+
+static void netlogg_history_pop(void)
+{
+    netlogg_slab     *slab = SLAB_OF(history[history_head & (gHistoryMsgs - 1)].data);
+
+
+    // End of a run of messages of the same slab
+    if ( (history_tail - history_head == 1) || (SLAB_OF(history[(history_head + 1) & (gHistoryMsgs - 1)].data) != slab) )
+    {
+        history_slabs--;
+        netlogg_slab_unref(slab);
+    }
+
+    history_head++;
+}
+
+
+
+static void netlogg_client_pop(struct epoll_fd_ctx *p)
+{
+    netlogg_slab     *slab = SLAB_OF(p->out_q[p->out_head].data);
+
+
+    // End of a run of messages of the same slab
+    if ( (p->out_count == 1) || (SLAB_OF(p->out_q[(p->out_head + 1) & (OUT_QUEUE_MSGS - 1)].data) != slab) )
+    {
+        p->out_slabs--;
+    }
+
+    netlogg_slab_unref(slab);
+
+    p->out_q[p->out_head].data  = NULL;
+    p->out_head                 = (p->out_head + 1) & (OUT_QUEUE_MSGS - 1);
+    p->out_count--;
+}
+
+
+
+static int netlogg_client_drop_oldest(struct epoll_fd_ctx *p)
+{
+    out_msg         *head   = NULL;
+    out_msg         *victim = NULL;
+    netlogg_slab    *prev   = NULL;
+    netlogg_slab    *slab   = NULL;
+    netlogg_slab    *next   = NULL;
+    int             runs    = 0;
+
+
+    if ( p->out_count == 0 )
+    {
+        return (0);
+    }
+
+    head    = &p->out_q[p->out_head];
+    victim  = head;
+
+    // The message being sent cannot be cut: drop the next one and move the head in its place
+    if ( head->off != 0 )
+    {
+        if ( p->out_count == 1 )
+        {
+            return (0);
+        }
+
+        victim = &p->out_q[(p->out_head + 1) & (OUT_QUEUE_MSGS - 1)];
+    }
+
+    p->out_bytes -= victim->len - victim->off;
+    p->dropped++;
+    netlogg_stats_add(NETLOGG_STAT_CLIENT_DROPS, 1);
+
+    if ( victim == head )
+    {
+        netlogg_client_pop(p);
+
+        return (1);
+    }
+
+    // Remove the second message: count again the runs of messages of the same slab around it
+    prev    = SLAB_OF(head->data);
+    slab    = SLAB_OF(victim->data);
+    next    = (p->out_count > 2) ? SLAB_OF(p->out_q[(p->out_head + 2) & (OUT_QUEUE_MSGS - 1)].data) : NULL;
+    runs    = (int) (slab != prev) + (int) ( (next != NULL) && (next != slab) ) - (int) ( (next != NULL) && (next != prev) );
+
+    p->out_slabs    -= runs;
+    netlogg_slab_unref(slab);
+
+    *victim     = *head;
+    head->data  = NULL;
+    p->out_head = (p->out_head + 1) & (OUT_QUEUE_MSGS - 1);
+    p->out_count--;
+
+    return (1);
+}
+
+
+
+static void netlogg_client_watch(struct epoll_fd_ctx    *p,
+                                 uint32_t               events
+                                 )
+{
+    struct epoll_event      ep_ev;
+
+
+    if ( (events == p->events) || (p->fd == -1) )
+    {
+        return;
+    }
+
+    ep_ev.events    = events;
+    ep_ev.data.ptr  = p;
+
+    if ( epoll_ctl(p->worker->ep_fd, EPOLL_CTL_MOD, p->fd, &ep_ev) == -1 )
+    {
+        NETLOGG(NETLOGG_ERROR, "epoll_ctl: %m");
     }
     else
     {
-        netlogger_ctx[EPOLL_FD_RECV].fd = sv[1];
-        netlogg_send_fd = sv[0];
+        p->events = events;
     }
+}
 
-    ep_ev.events    = EPOLLIN | EPOLLHUP | EPOLLERR | EPOLLRDHUP;
-    ep_ev.data.ptr  = &netlogger_ctx[EPOLL_FD_RECV];
 
 
-    // Ajout du contexte de la socket d'écoute  dans la table des evenements epoll
-    res = epoll_ctl(ep_fd, EPOLL_CTL_ADD, netlogger_ctx[EPOLL_FD_RECV].fd, &ep_ev);
+static void netlogg_send_to_all_connected_clients(struct epoll_fd_ctx   *p,
+                                                  unsigned long         events
+                                                  )
+{
+    if ( events & EPOLLERR )
+    {
+        assert(! "EPOLLERR");
+    }
+
+    if ( events & EPOLLHUP )
+    {
+        assert(! "EPOLLHUP");
+    }
+
+    if ( events & EPOLLIN )
+    {
+        // Acknowledge the wake up and read everything published in the ring
+        netlogg_ring_ack();
+        netlogg_drain_ring();
+    }
+
+    if ( events & EPOLLOUT )
+    {
+        assert(! "EPOLLOUT");
+    }
+}
+
+
+
+static void netlogg_drain_ring(void)
+{
+    uint64_t        dropped     = 0;
+    netlogg_record  *rec        = NULL;
+    int             filtered    = netlogg_filter_active();
+    int             err         = 0;
+    struct timespec ts;
+
+
+    while ( (rec = netlogg_ring_peek() ) != NULL )
+    {
+        if ( gCollapse && (rec->fd == -1) )
+        {
+            // The same message again: only counted, reported at least every REPEAT_FLUSH_MS
+            if ( netlogg_repeat_same(rec) )
+            {
+                repeat_since    = (repeat_count == 0) ? rec->ts : repeat_since;
+                repeat_ts       = rec->ts;
+                repeat_count++;
+                netlogg_ring_release();
+
+                if ( repeat_ts - repeat_since >= REPEAT_FLUSH_MS * 1000000ull )
+                {
+                    netlogg_repeat_flush(filtered);
+                }
+
+                continue;
+            }
+
+            netlogg_repeat_flush(filtered);
+            memcpy(&repeat_last.rec, rec, sizeof(*rec) + rec->len);
+            repeat_valid = 1;
+        }
+
+        netlogg_drain_record(rec, filtered);
 
-    if ( res == -1 )
+        // Give the slot back to the producers, the message is rendered
+        netlogg_ring_release();
+    }
+
+    // The message is not repeated anymore
+    if ( repeat_count != 0 )
     {
-        NETLOGG(NETLOGG_ERROR, "%s - epoll_ctl: %m", __FUNCTION__);
-        assert(res != -1);
+        clock_gettime(__atomic_load_n(&gClock, __ATOMIC_RELAXED), &ts);
+
+        if ( (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec - repeat_since >= REPEAT_FLUSH_MS * 1000000ull )
+        {
+            netlogg_repeat_flush(filtered);
+        }
     }
 
-    for ( ; ; )
+    netlogg_batch_publish();
+    netlogg_syslog_flush();
+
+    if ( gFile )
     {
-        int     timeout             = -1;
-        struct epoll_event *levents = NULL;
-        int     nb                  = -1;
+        netlogg_file_flush();
+    }
 
-        levents = calloc (MAXEVENTS, sizeof(struct epoll_event));;
-        nb      = epoll_wait(ep_fd, levents, MAXEVENTS, timeout);
+    dropped = netlogg_ring_dropped();
 
-        if ( nb > 0 )
-        {
-            for (int i = 0; i < nb; ++i)
-            {
-                epoll_fd_ctx     *p = levents[i].data.ptr;
+    if ( dropped != 0 )
+    {
+        NETLOGG(NETLOGG_WARN, "%" PRIu64 " messages dropped (ring full)", dropped);
+    }
 
-                // Assertions
-                assert(p);
-                assert(p->handler);
+    dropped = netlogg_syslog_dropped();
 
+    if ( dropped != 0 )
+    {
+        NETLOGG(NETLOGG_WARN, "%" PRIu64 " messages dropped (syslog socket full or closed)", dropped);
+    }
 
-                // Traitement de l'événement
-                (*p->handler)(p, levents[i].events);
-            }
-        }
-        else if ( nb == 0 )
+    // Reported once per change: the report of a failing file goes to the file too
+    if ( gFile && netlogg_file_state(&err) )
+    {
+        if ( err != 0 )
         {
-            NETLOGG(NETLOGG_WARN, "%s: Timeout", __FUNCTION__);
+            NETLOGG(NETLOGG_ERROR, "%s: %s, messages dropped until it is written again", netlogg_file_path(), strerror(err) );
         }
         else
         {
-            if ( (nb == -1) && (errno == EINTR) )
-            {
-                NETLOGG(NETLOGG_WARN, "%s: signal intercepté", __FUNCTION__);
-            }
-            else
-            {
-                NETLOGG(NETLOGG_ERROR, "%s: Invalide: %m", __FUNCTION__);
-            }
+            NETLOGG(NETLOGG_NOTICE, "%s: written again", netlogg_file_path() );
         }
+    }
 
-        // Free the pointer
-        levents = realloc(levents, 0);
+    dropped = gFile ? netlogg_file_dropped() : 0;
+
+    if ( dropped != 0 )
+    {
+        NETLOGG(NETLOGG_WARN, "%" PRIu64 " messages dropped (file not written fast enough or failing)", dropped);
     }
 }
 
 
-int8_t netlogg_send(const char              *file,
-                    const int32_t           lineno,
-                    const int               fd,
-                    const Netlogging_lvl    lvl,
-                    const char              *format,
-                    ...
-                    )
+
+static void netlogg_drain_record(const netlogg_record     *rec,
+                                 int                      filtered
+                                 )
 {
-    ssize_t     send_bytes          = -1;
-    int         w = -1;
-    va_list     ap, ap_dup;
+    char            *buff       = NULL;
+    char            *frame      = NULL;
+    size_t          len         = 0;
+    size_t          flen        = 0;
+    size_t          msg_off     = 0;
+    int             bin         = 0;
+    uint64_t        fmask       = 0;
 
-    // Time vars
-    struct tm *info;
-    struct timeval tval;
 
-    // Initiate the internal struct
-    internal_buff internal_msg = {
-        .fd = fd,
-        .lvl = lvl,
-        .buff = {0}
-    };
+    // A message for a specific client has its own batch, so that the order of the messages is kept
+    if ( (rec->fd != -1) && (batch_cur != NULL) )
+    {
+        netlogg_batch_publish();
+    }
 
-    // Get the time
-    gettimeofday(&tval, NULL);
-    info = localtime( &tval.tv_sec );
+    // The frames of a binary client start with the next batch
+    if ( (batch_cur != NULL) && ! batch_cur->bin && (__atomic_load_n(&bin_clients, __ATOMIC_RELAXED) != 0) )
+    {
+        netlogg_batch_publish();
+    }
 
-    w = strftime(internal_msg.buff, sizeof(internal_msg.buff), "%b %d %Y %H:%M:%S", info);
+    // The frame is rendered right after the text
+    bin     = (batch_cur != NULL) ? batch_cur->bin : (__atomic_load_n(&bin_clients, __ATOMIC_RELAXED) != 0);
+    buff    = netlogg_slab_reserve(&slab_cur, BUFF_SIZE_MAX + (bin ? FRAME_SIZE_MAX : 0) );
 
-    // Add the traces informations
-    w += snprintf(internal_msg.buff + w, sizeof(internal_msg.buff) - w, ".%06ld - %s:%d - ", tval.tv_usec, file, lineno);
+    // A batch only references a few slabs
+    if ( (batch_cur != NULL) && (batch_cur->nb_slabs == BATCH_SLABS) && (batch_cur->slabs[BATCH_SLABS - 1] != slab_cur) )
+    {
+        netlogg_batch_publish();
+    }
 
-    // Add the level in the traces
-    switch ( lvl )
+    if ( batch_cur == NULL )
     {
-        case NETLOGG_EMERG:
-            w   += snprintf(internal_msg.buff + w, sizeof(internal_msg.buff) - w, "\033[31mEMERG\033[0m - ");
-            break;
+        batch_cur = netlogg_batch_get();
 
-        case NETLOGG_ALERT:
-            w   += snprintf(internal_msg.buff + w, sizeof(internal_msg.buff) - w, "\033[31mALERT\033[0m - ");
-            break;
+        if ( batch_cur != NULL )
+        {
+            batch_cur->bin = bin;
+        }
+    }
 
-        case NETLOGG_CRIT:
-            w   += snprintf(internal_msg.buff + w, sizeof(internal_msg.buff) - w, "\033[31mCRIT\033[0m - ");
-            break;
+    if ( (buff == NULL) || (batch_cur == NULL) )
+    {
+        NETLOGG(NETLOGG_ERROR, "%s - malloc: %m", __FUNCTION__);
 
-        case NETLOGG_ERROR:
-            w   += snprintf(internal_msg.buff + w, sizeof(internal_msg.buff) - w, "\033[31mERROR\033[0m - ");
-            break;
+        return;
+    }
 
-        case NETLOGG_WARN:
-            w   += snprintf(internal_msg.buff + w, sizeof(internal_msg.buff) - w, "\033[33mWARN\033[0m - ");
-            break;
+    len             = netlogg_format(buff, BUFF_SIZE_MAX, rec, &msg_off);
+    frame           = bin ? buff + len : NULL;
+    flen            = bin ? netlogg_frame_render(frame, rec, buff + msg_off, len - 1 - msg_off) : 0;
+    slab_cur->used  += len + flen;
+    netlogg_stats_add(NETLOGG_STAT_RENDERED_BYTES, len);
 
-        case NETLOGG_NOTICE:
-            w   += snprintf(internal_msg.buff + w, sizeof(internal_msg.buff) - w, "\033[32mNOTICE\033[0m - ");
-            break;
+    // Each filter used by some clients is evaluated once, whatever the number of its clients
+    fmask           = (filtered && (rec->fd == -1) ) ? netlogg_filter_match(netlogg_rec_file(rec), buff + msg_off, len - 1 - msg_off) : 0;
 
-        case NETLOGG_INFO:
-            w   += snprintf(internal_msg.buff + w, sizeof(internal_msg.buff) - w, "\033[32mINFO\033[0m - ");
-            break;
+    // Send a message to the syslog only if it is not for a special socket and if the loglevel is higher than the
+    // default one
+    if ( (rec->fd == -1) && (rec->lvl <= gLvl) )
+    {
+        netlogg_syslog_add(rec->lvl, rec->ts, buff + msg_off, len - 1 - msg_off);
+    }
 
-        case NETLOGG_DEBUG:
-            w   += snprintf(internal_msg.buff + w, sizeof(internal_msg.buff) - w, "DEBUG - ");
-            break;
+    if ( (rec->fd == -1) && (rec->lvl <= gHistoryLvl) )
+    {
+        netlogg_history_add(buff, len, rec->ts, rec->lvl);
+    }
 
-        default:
-            w   += snprintf(internal_msg.buff + w, sizeof(internal_msg.buff) - w, "\033[31mUNKNOWN_LVL\033[0m - ");
+    if ( gFile && (rec->fd == -1) && (rec->lvl <= gFileLvl) )
+    {
+        netlogg_file_add(buff, len);
     }
 
-    // Beginning of the variable list
-    va_start(ap, format);
+    batch_cur->fd   = rec->fd;
+    batch_cur->lvl  = rec->lvl;
+    batch_cur->ts   = ( (batch_cur->count == 0) || (rec->ts < batch_cur->ts) ) ? rec->ts : batch_cur->ts;
+    netlogg_batch_add(batch_cur, rec->lvl, buff, len, frame, flen, fmask);
 
-    // Send a message to the syslog only if it is not for a special socket and if the loglevel is higher than the
-    // default one
-    if ( (fd == -1) && (lvl <= gLvl) )
+    // A batch compressed for some clients has to fit in one member
+    if ( (rec->fd != -1) || (batch_cur->count == gBatchSize) || (batch_cur->used >= gBatchBytes) ||
+         ( (batch_cur->used >= ZIP_MEMBER_SIZE) && (__atomic_load_n(&zip_clients, __ATOMIC_RELAXED) != 0) ) )
     {
-        va_copy(ap_dup, ap);
-        vsyslog(lvl, format, ap_dup);
-        va_end(ap_dup);
+        netlogg_batch_publish();
     }
+}
+
+
+
+static int netlogg_repeat_same(const netlogg_record *rec)
+{
+    const netlogg_record     *last = &repeat_last.rec;
+
+
+    // The arguments are compared as captured: the same bytes render the same message
+    return (repeat_valid && (rec->file == last->file) && (rec->lineno == last->lineno) && (rec->format == last->format) &&
+            (rec->lvl == last->lvl) && (rec->err == last->err) && (rec->len == last->len) &&
+            (memcmp(rec->payload, last->payload, rec->len) == 0) );
+}
+
+
+
+/**
+ * \brief      Capture the arguments of a message rendered by the netlogging thread itself
+ *
+ * \param      args    The buffer
+ * \param[in]  size    The buffer size
+ * \param[in]  format  The format
+ * \param[in]  ...     List of variable for the format
+ *
+ * \return     Number of bytes used in args
+ */
+static size_t netlogg_repeat_capture(char           *args,
+                                     size_t         size,
+                                     const char     *format,
+                                     ...
+                                     )
+{
+    size_t      len = 0;
+    va_list     ap;
 
-    // Prepare the message for the sockets
-    w   += vsnprintf(internal_msg.buff + w, sizeof(internal_msg.buff) - w, format, ap);
 
-    // Ending of the variable list
+    va_start(ap, format);
+    len = netlogg_fmt_capture(args, size, format, ap);
     va_end(ap);
 
-    w   += snprintf(internal_msg.buff + w, sizeof(internal_msg.buff) - w, "\n");
+    return (len);
+}
+
 
-    // Send to a connected client
-    send_bytes = send(netlogg_send_fd, &internal_msg, sizeof(internal_msg), 0);
 
-    if ( send_bytes == -1 )
+static void netlogg_repeat_flush(int filtered)
+{
+    union {
+        netlogg_record rec;
+        char raw[sizeof(netlogg_record) + 64];
+    } msg;
+
+
+    if ( repeat_count == 0 )
     {
-        syslog(LOG_ERR, "%s - send: %m\n", __FUNCTION__);
+        return;
     }
 
-    return (0);
+    // Same site and level as the repeated message
+    memcpy(&msg.rec, &repeat_last.rec, sizeof(msg.rec) );
+    msg.rec.ts      = repeat_ts;
+    msg.rec.format  = "last message repeated %" PRIu64 " times";
+    msg.rec.len     = netlogg_repeat_capture(msg.rec.payload, sizeof(msg) - sizeof(msg.rec), msg.rec.format, repeat_count);
+
+    netlogg_drain_record(&msg.rec, filtered);
+    netlogg_stats_add(NETLOGG_STAT_REPEATS, repeat_count);
+    repeat_count = 0;
 }
 
 
 
-static int32_t netlogg_nb_connected_clients(void)
+static void netlogg_batch_add(netlogg_batch     *b,
+                              Netlogging_lvl    lvl,
+                              char              *buff,
+                              size_t            len,
+                              char              *frame,
+                              size_t            flen,
+                              uint64_t          fmask
+                              )
 {
-    uint8_t         i = 0;
-    uint32_t        nb_connected_clients = 0;
+    int     l = 0;
 
 
-    // Parse all possible communication socket
-    for ( i = EPOLL_FD_SEND0; i <= EPOLL_FD_SEND9; i++ )
+    // The batch keeps the slab alive until every worker sent it
+    if ( (b->nb_slabs == 0) || (b->slabs[b->nb_slabs - 1] != slab_cur) )
+    {
+        __atomic_add_fetch(&slab_cur->refs, 1, __ATOMIC_RELAXED);
+        b->slabs[b->nb_slabs++] = slab_cur;
+    }
+
+    // The clients of the workers are not known here: every level that wants the message gets it
+    for ( l = lvl; l < NETLOGG_LVLS; l++ )
     {
-        if ( netlogger_ctx[i].fd != -1 )
+        b->iov[l][b->iovcnt[l]].iov_base   = buff;
+        b->iov[l][b->iovcnt[l]].iov_len    = len;
+
+        if ( frame != NULL )
         {
-            nb_connected_clients++;
+            b->biov[l][b->iovcnt[l]].iov_base  = frame;
+            b->biov[l][b->iovcnt[l]].iov_len   = flen;
         }
+
+        b->iovcnt[l]++;
     }
 
-    return (nb_connected_clients);
+    b->fmask[b->count]  = fmask;
+    b->lvls[b->count]   = lvl;
+    b->used             += len;
+    b->count++;
 }
 
 
 
-static void netlogg_handle_new_connection(struct epoll_fd_ctx   *p,
-                                          unsigned long         events
-                                          )
+static void netlogg_batch_publish(void)
 {
-    uint8_t     i   = 0;
-    int     new_fd  = -1;
-    struct sockaddr_in      remote_sockaddr;
-    socklen_t               r_sz = sizeof(remote_sockaddr);
-    struct epoll_event      ep_ev;
+    uint32_t        i   = 0;
+    netlogg_batch   *b  = batch_cur;
+    netlogg_job     job;
 
 
-    /* Accept the new remote connection
-     */
-    new_fd = accept(p->fd, (struct sockaddr *) &remote_sockaddr, &r_sz);
-
-    if ( new_fd == -1 )
+    if ( b == NULL )
     {
-        NETLOGG(NETLOGG_ERROR, "accept: %m");
-        assert(new_fd != -1);
+        return;
     }
-    else
+
+    batch_cur   = NULL;
+    b->refs     = 1;
+    job.batch   = b;
+    netlogg_stats_add(NETLOGG_STAT_BATCHES, 1);
+
+    if ( __atomic_load_n(&zip_clients, __ATOMIC_RELAXED) != 0 )
     {
-        NETLOGG(NETLOGG_DEBUG, "Accept new remote connection");
+        netlogg_batch_zip(b);
     }
 
-    /* Check for empty socket
-     */
-    for ( i = EPOLL_FD_SEND0; i <= EPOLL_FD_SEND9; i++ )
+    // The batch is never written again: the workers read it at the same time
+    for ( i = 0; i < nb_workers; i++ )
     {
-        if ( netlogger_ctx[i].fd == -1 )
+        if ( __atomic_load_n(&workers[i].load, __ATOMIC_RELAXED) == 0 )
         {
-            // Update epoll context
-            netlogger_ctx[i].fd         = new_fd;
-            netlogger_ctx[i].lvl        = NETLOGG_DEBUG;
-            netlogger_ctx[i].ipv4_addr  = strdup(inet_ntoa(remote_sockaddr.sin_addr) );
-
-            getnameinfo( (const struct sockaddr *) &remote_sockaddr, sizeof(remote_sockaddr), netlogger_ctx[i].hostname,
-                         sizeof(netlogger_ctx[i].hostname), netlogger_ctx[i].service, sizeof(netlogger_ctx[i].service), 0);
-
-
-            // Create the event struct
-            ep_ev.events    = EPOLLIN | EPOLLHUP | EPOLLERR | EPOLLRDHUP;
-            ep_ev.data.ptr  = &netlogger_ctx[i];
-
-            if ( epoll_ctl(ep_fd, EPOLL_CTL_ADD, new_fd, &ep_ev) == -1 )
-            {
-                NETLOGG(NETLOGG_ERROR, "epoll_ctl: %m");
-                netlogg_close_conn(&netlogger_ctx[i]);
-            }
-            else
-            {
-                NETLOGG(NETLOGG_DEBUG,
-                        "New client %s added in the epoll loop (%s, %s)",
-                        netlogger_ctx[i].ipv4_addr,
-                        netlogger_ctx[i].hostname,
-                        netlogger_ctx[i].service);
-                NETLOGG(NETLOGG_INFO, "%d clients connected", netlogg_nb_connected_clients() );
-
-                // Print the help
-                handle_help(&netlogger_ctx[i], NULL, 0);
-            }
+            continue;
+        }
 
-            break;
+        if ( workers[i].local )
+        {
+            netlogg_worker_send(&workers[i], b);
+        }
+        else
+        {
+            __atomic_add_fetch(&b->refs, 1, __ATOMIC_RELAXED);
+            netlogg_worker_push(&workers[i], &job);
         }
     }
+
+    netlogg_batch_unref(b);
 }
 
 
 
-static void netlogg_handle_comm(struct epoll_fd_ctx *p,
-                                unsigned long       events
-                                )
+static void netlogg_batch_zip(netlogg_batch *b)
 {
-    char        buff[BUFF_SIZE_MAX] = {0};
-    ssize_t     r = -1;
+    int         l       = 0;
+    char        *buff   = NULL;
+    size_t      size    = 0;
+    size_t      len     = 0;
+    uint32_t    wanted  = 0;
 
 
-    if ( events & EPOLLIN )
+    for ( l = 0; l < NETLOGG_LVLS; l++ )
     {
-        r = recv(p->fd, buff, sizeof(buff), 0);
+        // A message for a specific client only has its level, the others are wanted by compressed clients
+        wanted = (b->fd != -1) ? (l == (int) b->lvl) : __atomic_load_n(&subs_zip[l], __ATOMIC_RELAXED);
 
-        if ( r == -1 )
+        if ( (b->iovcnt[l] == 0) || (wanted == 0) )
         {
-            NETLOGG(NETLOGG_ERROR, "recv: %m");
+            continue;
         }
 
-        if ( r == 0 )
+        // The same messages as the previous level: the same member
+        if ( (l > 0) && (b->iovcnt[l] == b->iovcnt[l - 1]) && (b->ziov[l - 1].iov_len != 0) )
         {
-            NETLOGG(NETLOGG_DEBUG, "No bytes received from %s. We are going to close it.", p->ipv4_addr);
+            b->ziov[l] = b->ziov[l - 1];
+            continue;
         }
-        else if ( r > 0 )
-        {
-            uint32_t     i = 0;
-
-
-            // Remove carriage return and newline feed if found
-            buff[strcspn(buff, "\r\n")] = 0;
-
-
-            if ( strlen(buff) != 0 )
-            {
-                // Parse all the commands, if found we use the associated function
-                for ( i = 0; i < NBELEMS(recv_cmds); ++i )
-                {
-                    if ( strncmp(recv_cmds[i].cmd, buff, strlen(recv_cmds[i].cmd) ) == 0 )
-                    {
-                        if ( recv_cmds[i].handler != NULL )
-                        {
-                            NETLOGG(NETLOGG_DEBUG, "Receive the command \"%s\" from %s (%s)", buff, p->hostname, p->ipv4_addr);
-                            (*recv_cmds[i].handler)(p, buff, r);
-                        }
 
-                        break;
-                    }
-                }
+        // Only a batch started before the first compressed client can be larger than a slab
+        size    = netlogg_zip_bound(&zip, b->used);
+        buff    = (size <= SLAB_SIZE - sizeof(netlogg_slab) ) ? netlogg_slab_reserve(&slab_zip, size) : NULL;
+        len     = (buff != NULL) ? netlogg_zip_member(&zip, buff, size, b->iov[l], b->iovcnt[l]) : 0;
 
-                // If the command is not known, we trace it as a warning
-                if ( i == NBELEMS(recv_cmds) )
-                {
-                    NETLOGG(NETLOGG_WARN, "Unknown command from %s: %s", p->ipv4_addr, buff);
-                    NETLOGG(NETLOGG_DEBUG, "Receive %zd bytes from %s (fd: %d) - unused", strlen(buff), p->ipv4_addr, p->fd);
-                }
-            }
-        }
-        else if ( p->fd == -1 )
+        if ( len == 0 )
         {
-            NETLOGG(NETLOGG_ERROR, "p->fd == -1");
-
-            return;
+            NETLOGG(NETLOGG_ERROR, "%s - %zu bytes not compressed", __FUNCTION__, b->used);
+            continue;
         }
-    }
 
-    if ( events & EPOLLRDHUP )
-    {
-        NETLOGG(NETLOGG_INFO, "Closing connection (EPOLLRDHUP)");
-        netlogg_close_conn(p);
-    }
+        slab_zip->used  += len;
 
-    if ( events & EPOLLERR )
-    {
-        NETLOGG(NETLOGG_INFO, "Closing connection (EPOLLERR)");
-        netlogg_close_conn(p);
-    }
+        // The batch keeps the slab alive until every worker sent it
+        if ( (b->nb_zslabs == 0) || (b->zslabs[b->nb_zslabs - 1] != slab_zip) )
+        {
+            __atomic_add_fetch(&slab_zip->refs, 1, __ATOMIC_RELAXED);
+            b->zslabs[b->nb_zslabs++] = slab_zip;
+        }
 
-    if ( events & EPOLLHUP )
-    {
-        NETLOGG(NETLOGG_INFO, "Closing connection (EPOLLHUP)");
-        netlogg_close_conn(p);
+        b->ziov[l].iov_base = buff;
+        b->ziov[l].iov_len  = len;
     }
-
-    assert(! (events & EPOLLOUT) );
 }
 
 
 
-static void netlogg_send_to_all_connected_clients(struct epoll_fd_ctx   *p,
-                                                  unsigned long         events
-                                                  )
+static netlogg_batch* netlogg_batch_get(void)
 {
-    uint8_t     i           = 0;
-    ssize_t     recv_size   = -1;
-    ssize_t     send_size   = -1;
+    int             l   = 0;
+    netlogg_batch   *b  = NULL;
 
 
-    if ( events & EPOLLERR )
-    {
-        assert(! "EPOLLERR");
-    }
+    pthread_mutex_lock(&batches_lock);
+    b = batches_free;
 
-    if ( events & EPOLLHUP )
+    if ( b != NULL )
     {
-        assert(! "EPOLLHUP");
+        batches_free = b->next;
     }
 
-    if ( events & EPOLLIN )
+    pthread_mutex_unlock(&batches_lock);
+
+    if ( b == NULL )
     {
-        internal_buff internal_msg;
+        b = calloc(1, sizeof(*b) );
 
+        if ( b == NULL )
+        {
+            return (NULL);
+        }
 
-        // Lecture des événements notifiés
-        recv_size = recv(p->fd, &internal_msg, sizeof(internal_msg), 0);
+        // The text of the messages, then their binary frames
+        b->iov[0]   = malloc(2 * NETLOGG_LVLS * gBatchSize * sizeof(struct iovec) );
+        b->fmask    = malloc(gBatchSize * (sizeof(*b->fmask) + sizeof(*b->lvls) ) );
 
-        if ( recv_size == -1 )
+        if ( (b->iov[0] == NULL) || (b->fmask == NULL) )
         {
-            NETLOGG(NETLOGG_ERROR, "%s - recv: %m\n", __FUNCTION__);
+            free(b->iov[0]);
+            free(b->fmask);
+            free(b);
+
+            return (NULL);
         }
-        else if ( recv_size == 0 )
+
+        b->lvls = (uint8_t *) (b->fmask + gBatchSize);
+
+        for ( l = 0; l < NETLOGG_LVLS; l++ )
         {
-            assert(recv_size == 0);
+            b->iov[l]   = b->iov[0] + l * gBatchSize;
+            b->biov[l]  = b->iov[0] + (NETLOGG_LVLS + l) * gBatchSize;
         }
-        else
-        {
-            if ( internal_msg.fd == -1 )
-            {
-                // Parse all possible communication socket
-                for ( i = EPOLL_FD_SEND0; i <= EPOLL_FD_SEND9; i++ )
-                {
-                    if ( (netlogger_ctx[i].fd != -1) && (internal_msg.lvl <= netlogger_ctx[i].lvl))
-                    {
-                        // Send to a connected client
-                        send_size = send(netlogger_ctx[i].fd, internal_msg.buff, strlen(internal_msg.buff), 0);
+    }
 
-                        if ( send_size == -1 )
-                        {
-                            NETLOGG(NETLOGG_ERROR, "%s - send: %m\n", __FUNCTION__);
-                        }
-                        else if ( (size_t) send_size != strlen(internal_msg.buff) )
-                        {
-                            NETLOGG(NETLOGG_ERROR, "%s - send: send_size (%zd) != recv_size (%zd)\n", __FUNCTION__, send_size, recv_size);
-                        }
-                    }
-                }
-            }
-            else
-            {
-                // Parse all possible communication socket
-                for ( i = EPOLL_FD_SEND0; i <= EPOLL_FD_SEND9; i++ )
-                {
-                    if ( (netlogger_ctx[i].fd == internal_msg.fd) && (netlogger_ctx[i].fd != -1) && (internal_msg.lvl <= netlogger_ctx[i].lvl))
-                    {
-                        // Send to a specific connected client
-                        send_size = send(netlogger_ctx[i].fd, internal_msg.buff, strlen(internal_msg.buff), 0);
+    b->fd       = -1;
+    b->bin      = 0;
+    b->nb_slabs = 0;
+    b->used     = 0;
+    b->count    = 0;
+    memset(b->iovcnt, 0, sizeof(b->iovcnt) );
+    b->nb_zslabs    = 0;
+    memset(b->ziov, 0, sizeof(b->ziov) );
 
-                        if ( send_size == -1 )
-                        {
-                            NETLOGG(NETLOGG_ERROR, "%s - send: %m\n", __FUNCTION__);
-                        }
-                        else if ( (size_t) send_size != strlen(internal_msg.buff) )
-                        {
-                            NETLOGG(NETLOGG_ERROR, "%s - send: send_size (%zd) != recv_size (%zd)\n", __FUNCTION__, send_size, recv_size);
-                        }
-                    }
-                }
-            }
-        }
+    return (b);
+}
+
+
+
+static void netlogg_batch_unref(netlogg_batch *b)
+{
+    uint32_t     i = 0;
+
+
+    if ( __atomic_sub_fetch(&b->refs, 1, __ATOMIC_ACQ_REL) != 0 )
+    {
+        return;
     }
 
-    if ( events & EPOLLOUT )
+    // The messages still queued for slow clients keep their slab
+    for ( i = 0; i < b->nb_slabs; i++ )
     {
-        assert(! "EPOLLOUT");
+        netlogg_slab_unref(b->slabs[i]);
+    }
+
+    for ( i = 0; i < b->nb_zslabs; i++ )
+    {
+        netlogg_slab_unref(b->zslabs[i]);
     }
+
+    pthread_mutex_lock(&batches_lock);
+    b->next         = batches_free;
+    batches_free    = b;
+    pthread_mutex_unlock(&batches_lock);
 }
 
 
 
 static void netlogg_close_conn(epoll_fd_ctx *p)
 {
+    netlogg_worker     *w = p->worker;
+
+
     if ( p->fd != -1 )
     {
         // Suppression de la socket de la boucle epoll
-        if ( epoll_ctl(ep_fd, EPOLL_CTL_DEL, p->fd, NULL) == -1 )
+        if ( epoll_ctl(p->worker->ep_fd, EPOLL_CTL_DEL, p->fd, NULL) == -1 )
         {
             NETLOGG(NETLOGG_ERROR, "epoll_ctl: %m");
         }
@@ -816,6 +4077,7 @@ static void netlogg_close_conn(epoll_fd_ctx *p)
 
 
         // Update epoll context
+        pthread_mutex_lock(&w->lock);
         p->fd = -1;
 
         if ( p->ipv4_addr != NULL )
@@ -823,6 +4085,47 @@ static void netlogg_close_conn(epoll_fd_ctx *p)
             free(p->ipv4_addr);
             p->ipv4_addr = NULL;
         }
+
+        // Forget the messages not sent
+        if ( p->out_q != NULL )
+        {
+            while ( p->out_count != 0 )
+            {
+                netlogg_client_pop(p);
+            }
+
+            free(p->out_q);
+            p->out_q = NULL;
+        }
+
+        p->out_bytes    = 0;
+        p->out_slabs    = 0;
+        p->replay       = 0;
+        p->replay_end   = 0;
+        p->events       = 0;
+
+        // Remove it from the connected clients, the last one takes its place
+        netlogg_client_set_zip(p, 0);
+        netlogg_client_set_bin(p, 0);
+        netlogg_subs_del(p);
+
+        if ( p->filter != -1 )
+        {
+            netlogg_filter_put(p->filter);
+            p->filter = -1;
+        }
+
+        w->clients[p->idx]      = w->clients[--w->nb_clients];
+        w->clients[p->idx]->idx = p->idx;
+        pthread_mutex_unlock(&w->lock);
+
+        p->next             = w->clients_closed;
+        w->clients_closed   = p;
+
+        __atomic_sub_fetch(&w->load, 1, __ATOMIC_RELAXED);
+        __atomic_sub_fetch(&nb_connected, 1, __ATOMIC_RELAXED);
+
+        netlogg_update_max_lvl();
     }
     else
     {
@@ -873,7 +4176,7 @@ static void handle_loglevel_crit(struct epoll_fd_ctx    *p,
 {
     NETLOGG_BACK(p->fd, NETLOGG_INFO, "Changing loglevel to \033[1mCRIT\033[0m (from %s)", p->ipv4_addr);
 
-    p->lvl = NETLOGG_CRIT;
+    netlogg_client_set_lvl(p, NETLOGG_CRIT);
 }
 
 
@@ -885,7 +4188,7 @@ static void handle_loglevel_error(struct epoll_fd_ctx   *p,
 {
     NETLOGG_BACK(p->fd, NETLOGG_INFO, "Changing loglevel to \033[1mERROR\033[0m (from %s)", p->ipv4_addr);
 
-    p->lvl = NETLOGG_ERROR;
+    netlogg_client_set_lvl(p, NETLOGG_ERROR);
 }
 
 
@@ -897,7 +4200,7 @@ static void handle_loglevel_notice(struct epoll_fd_ctx    *p,
 {
     NETLOGG_BACK(p->fd, NETLOGG_INFO, "Changing loglevel to \033[1mINFO\033[0m (from %s)", p->ipv4_addr);
 
-    p->lvl = NETLOGG_NOTICE;
+    netlogg_client_set_lvl(p, NETLOGG_NOTICE);
 }
 
 
@@ -909,7 +4212,7 @@ static void handle_loglevel_info(struct epoll_fd_ctx    *p,
 {
     NETLOGG_BACK(p->fd, NETLOGG_INFO, "Changing loglevel to \033[1mINFO\033[0m (from %s)", p->ipv4_addr);
 
-    p->lvl = NETLOGG_INFO;
+    netlogg_client_set_lvl(p, NETLOGG_INFO);
 }
 
 
@@ -921,7 +4224,7 @@ static void handle_loglevel_warn(struct epoll_fd_ctx    *p,
 {
     NETLOGG_BACK(p->fd, NETLOGG_INFO, "Changing loglevel to \033[1mWARN\033[0m (from %s)", p->ipv4_addr);
 
-    p->lvl = NETLOGG_WARN;
+    netlogg_client_set_lvl(p, NETLOGG_WARN);
 }
 
 
@@ -933,7 +4236,7 @@ static void handle_loglevel_debug(struct epoll_fd_ctx   *p,
 {
     NETLOGG_BACK(p->fd, NETLOGG_INFO, "Changing loglevel to \033[1mDEBUG\033[0m (from %s)", p->ipv4_addr);
 
-    p->lvl = NETLOGG_DEBUG;
+    netlogg_client_set_lvl(p, NETLOGG_DEBUG);
 }
 
 
@@ -943,16 +4246,503 @@ static void handle_client_list(struct epoll_fd_ctx  *p,
                                ssize_t              recv_size
                                )
 {
-    epoll_evt_t     i = EPOLL_FD_SEND0;
+    uint32_t        i   = 0;
+    uint32_t        j   = 0;
+    uint32_t        n   = 0;
+    epoll_fd_ctx    *c  = NULL;
 
 
     NETLOGG_BACK(p->fd, NETLOGG_INFO, "Clients list asked by %s: %d clients connected", p->ipv4_addr, netlogg_nb_connected_clients() );
 
-    for ( i = EPOLL_FD_SEND0; i <= EPOLL_FD_SEND9; i++ )
+    // The clients of the other workers keep changing: the counters are only an estimation
+    for ( j = 0; j < nb_workers; j++ )
+    {
+        pthread_mutex_lock(&workers[j].lock);
+
+        for ( i = 0; i < workers[j].nb_clients; i++ )
+        {
+            c = workers[j].clients[i];
+            NETLOGG_BACK(p->fd, NETLOGG_INFO, "Client %" PRIu32 ": %s (%s:%s) - worker %" PRIu32 " - %zu bytes waiting, %" PRIu64 " messages dropped", ++n, c->hostname, c->ipv4_addr, c->service, j,
+                         __atomic_load_n(&c->out_bytes, __ATOMIC_RELAXED), __atomic_load_n(&c->dropped, __ATOMIC_RELAXED) );
+        }
+
+        pthread_mutex_unlock(&workers[j].lock);
+    }
+}
+
+
+
+static void handle_history(struct epoll_fd_ctx  *p,
+                           char                 *buff,
+                           ssize_t              recv_size
+                           )
+{
+    unsigned int     n = 0;
+
+
+    if ( sscanf(buff, "history %u", &n) != 1 )
+    {
+        NETLOGG_BACK(p->fd, NETLOGG_INFO, "Usage: history N");
+
+        return;
+    }
+
+    // The history is kept as text
+    if ( p->zip )
+    {
+        NETLOGG_BACK(p->fd, NETLOGG_INFO, "The history is not available on a compressed connection (compress none first)");
+
+        return;
+    }
+
+    if ( p->bin )
+    {
+        NETLOGG_BACK(p->fd, NETLOGG_INFO, "The history is not available on a binary connection (mode text first)");
+
+        return;
+    }
+
+    if ( p->filter != -1 )
+    {
+        NETLOGG_BACK(p->fd, NETLOGG_INFO, "The history is not filtered (filter none first)");
+
+        return;
+    }
+
+    pthread_mutex_lock(&history_lock);
+    p->replay_end   = history_tail;
+    p->replay       = (history_tail - history_head > n) ? history_tail - n : history_head;
+    pthread_mutex_unlock(&history_lock);
+
+    NETLOGG_BACK(p->fd, NETLOGG_INFO, "Sending the last %" PRIu64 " messages of the history (from %s)", p->replay_end - p->replay, p->ipv4_addr);
+
+    // The rest is sent when the output queue has room
+    netlogg_client_replay(p);
+    netlogg_client_flush(p);
+}
+
+
+
+static void handle_since(struct epoll_fd_ctx    *p,
+                         char                   *buff,
+                         ssize_t                recv_size
+                         )
+{
+    int         hour    = 0;
+    int         min     = 0;
+    int         sec     = 0;
+    time_t      now     = time(NULL);
+    time_t      since   = 0;
+    uint64_t    ts      = 0;
+    uint64_t    lo      = 0;
+    uint64_t    hi      = 0;
+    uint64_t    mid     = 0;
+    struct tm   info;
+
+
+    if ( (sscanf(buff, "since %d:%d:%d", &hour, &min, &sec) != 3) || (hour < 0) || (hour > 23) || (min < 0) || (min > 59) || (sec < 0) || (sec > 60) )
+    {
+        NETLOGG_BACK(p->fd, NETLOGG_INFO, "Usage: since HH:MM:SS");
+
+        return;
+    }
+
+    // The history is kept as text
+    if ( p->zip )
+    {
+        NETLOGG_BACK(p->fd, NETLOGG_INFO, "The history is not available on a compressed connection (compress none first)");
+
+        return;
+    }
+
+    if ( p->bin )
+    {
+        NETLOGG_BACK(p->fd, NETLOGG_INFO, "The history is not available on a binary connection (mode text first)");
+
+        return;
+    }
+
+    if ( p->filter != -1 )
+    {
+        NETLOGG_BACK(p->fd, NETLOGG_INFO, "The history is not filtered (filter none first)");
+
+        return;
+    }
+
+    // Today at this time, or yesterday if it is not past yet
+    localtime_r(&now, &info);
+    info.tm_hour    = hour;
+    info.tm_min     = min;
+    info.tm_sec     = sec;
+    info.tm_isdst   = -1;
+    since           = mktime(&info);
+
+    if ( since > now )
+    {
+        since -= 24 * 3600;
+    }
+
+    ts = (uint64_t) since * 1000000000ull;
+
+    // First message of the history logged since then
+    pthread_mutex_lock(&history_lock);
+    lo  = history_head;
+    hi  = history_tail;
+
+    while ( lo < hi )
+    {
+        mid = lo + (hi - lo) / 2;
+
+        if ( history[mid & (gHistoryMsgs - 1)].ts < ts )
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    p->replay       = lo;
+    p->replay_end   = history_tail;
+    pthread_mutex_unlock(&history_lock);
+
+    NETLOGG_BACK(p->fd, NETLOGG_INFO, "Sending the %" PRIu64 " messages of the history logged since %02d:%02d:%02d (from %s)", p->replay_end - p->replay, hour, min, sec, p->ipv4_addr);
+
+    // The rest is sent when the output queue has room
+    netlogg_client_replay(p);
+    netlogg_client_flush(p);
+}
+
+
+
+static void handle_compress_gzip(struct epoll_fd_ctx    *p,
+                                 char                   *buff,
+                                 ssize_t                recv_size
+                                 )
+{
+    if ( ! zip.ready )
+    {
+        NETLOGG_BACK(p->fd, NETLOGG_INFO, "Compression is not available");
+
+        return;
+    }
+
+    if ( p->bin )
+    {
+        NETLOGG_BACK(p->fd, NETLOGG_INFO, "The binary frames are not compressed (mode text first)");
+
+        return;
+    }
+
+    // The members are compressed once per level for all the clients
+    if ( p->filter != -1 )
+    {
+        NETLOGG_BACK(p->fd, NETLOGG_INFO, "The filtered messages are not compressed (filter none first)");
+
+        return;
+    }
+
+    // The answer is the first member of the stream
+    netlogg_client_set_zip(p, 1);
+
+    NETLOGG_BACK(p->fd, NETLOGG_INFO, "Sending the messages compressed with gzip (from %s)", p->ipv4_addr);
+}
+
+
+
+static void handle_compress_none(struct epoll_fd_ctx    *p,
+                                 char                   *buff,
+                                 ssize_t                recv_size
+                                 )
+{
+    netlogg_client_set_zip(p, 0);
+
+    NETLOGG_BACK(p->fd, NETLOGG_INFO, "Sending the messages as text (from %s)", p->ipv4_addr);
+}
+
+
+
+static void handle_mode_binary(struct epoll_fd_ctx  *p,
+                               char                 *buff,
+                               ssize_t              recv_size
+                               )
+{
+    if ( p->zip )
+    {
+        NETLOGG_BACK(p->fd, NETLOGG_INFO, "The binary frames are not compressed (compress none first)");
+
+        return;
+    }
+
+    if ( p->bin )
+    {
+        return;
+    }
+
+    // The dictionary is sent before any frame, at most IOV_MAX frames by sendmsg
+    for ( uint32_t i = 0; (i < nb_dict_iov) && (p->fd != -1); i += IOV_MAX )
+    {
+        netlogg_client_write(p, dict_iov + i, (nb_dict_iov - i < IOV_MAX) ? nb_dict_iov - i : IOV_MAX);
+    }
+
+    if ( p->fd == -1 )
+    {
+        return;
+    }
+
+    // The answer is the first message frame
+    netlogg_client_set_bin(p, 1);
+
+    NETLOGG_BACK(p->fd, NETLOGG_INFO, "Sending the messages as binary frames, %" PRIu32 " files in the dictionary (from %s)", nb_dict_files, p->ipv4_addr);
+}
+
+
+
+static void handle_mode_text(struct epoll_fd_ctx    *p,
+                             char                   *buff,
+                             ssize_t                recv_size
+                             )
+{
+    netlogg_client_set_bin(p, 0);
+
+    NETLOGG_BACK(p->fd, NETLOGG_INFO, "Sending the messages as text (from %s)", p->ipv4_addr);
+}
+
+
+
+static void handle_stats(struct epoll_fd_ctx    *p,
+                         char                   *buff,
+                         ssize_t                recv_size
+                         )
+{
+    netlogg_stats   sum;
+    uint64_t        msgs        = 0;
+    uint64_t        bytes       = 0;
+    uint64_t        max_bytes   = 0;
+
+
+    netlogg_stats_read(&sum);
+    netlogg_queue_depth(&msgs, &bytes, &max_bytes);
+
+    NETLOGG_BACK(p->fd, NETLOGG_INFO, "Messages: EMERG %" PRIu64 ", ALERT %" PRIu64 ", CRIT %" PRIu64 ", ERROR %" PRIu64 ", WARN %" PRIu64 ", NOTICE %" PRIu64 ", INFO %" PRIu64 ", DEBUG %" PRIu64,
+                 sum.c[NETLOGG_STAT_MSGS + NETLOGG_EMERG], sum.c[NETLOGG_STAT_MSGS + NETLOGG_ALERT], sum.c[NETLOGG_STAT_MSGS + NETLOGG_CRIT],
+                 sum.c[NETLOGG_STAT_MSGS + NETLOGG_ERROR], sum.c[NETLOGG_STAT_MSGS + NETLOGG_WARN], sum.c[NETLOGG_STAT_MSGS + NETLOGG_NOTICE],
+                 sum.c[NETLOGG_STAT_MSGS + NETLOGG_INFO], sum.c[NETLOGG_STAT_MSGS + NETLOGG_DEBUG]);
+    NETLOGG_BACK(p->fd, NETLOGG_INFO, "Bytes: %" PRIu64 " rendered, %" PRIu64 " sent to the clients, %" PRIu64 " batches",
+                 sum.c[NETLOGG_STAT_RENDERED_BYTES], sum.c[NETLOGG_STAT_SENT_BYTES], sum.c[NETLOGG_STAT_BATCHES]);
+    NETLOGG_BACK(p->fd, NETLOGG_INFO, "Dropped: %" PRIu64 " ring full, %" PRIu64 " overwritten, %" PRIu64 " slow clients, %" PRIu64 " syslog, %" PRIu64 " file, %" PRIu64 " rate limit (%" PRIu64 " repeats collapsed, %" PRIu64 " waits for the ring)",
+                 sum.c[NETLOGG_STAT_RING_DROPS], sum.c[NETLOGG_STAT_RING_OVERWRITES], sum.c[NETLOGG_STAT_CLIENT_DROPS], sum.c[NETLOGG_STAT_SYSLOG_DROPS], sum.c[NETLOGG_STAT_FILE_DROPS],
+                 sum.c[NETLOGG_STAT_RATE_DROPS], sum.c[NETLOGG_STAT_REPEATS], sum.c[NETLOGG_STAT_RING_WAITS]);
+    NETLOGG_BACK(p->fd, NETLOGG_INFO, "Queues: %d clients, %" PRIu64 " messages and %" PRIu64 " bytes waiting (%" PRIu64 " bytes for the slowest client)",
+                 netlogg_nb_connected_clients(), msgs, bytes, max_bytes);
+    NETLOGG_BACK(p->fd, NETLOGG_INFO, "System calls: sendmsg %" PRIu64 ", sendmmsg %" PRIu64 ", pwritev %" PRIu64 ", epoll_wait %" PRIu64 ", eventfd_write %" PRIu64,
+                 sum.c[NETLOGG_STAT_SC_SENDMSG], sum.c[NETLOGG_STAT_SC_SENDMMSG], sum.c[NETLOGG_STAT_SC_PWRITEV], sum.c[NETLOGG_STAT_SC_EPOLL_WAIT],
+                 sum.c[NETLOGG_STAT_SC_EVENTFD_WRITE]);
+    NETLOGG_BACK(p->fd, NETLOGG_INFO, "Latency to the sockets (us): p50 %.1f, p90 %.1f, p99 %.1f, p99.9 %.1f, max %.1f (%" PRIu64 " batches)",
+                 netlogg_stats_quantile(&sum, 0.5) / 1e3, netlogg_stats_quantile(&sum, 0.9) / 1e3, netlogg_stats_quantile(&sum, 0.99) / 1e3,
+                 netlogg_stats_quantile(&sum, 0.999) / 1e3, netlogg_stats_quantile(&sum, 1.0) / 1e3, sum.lat_count);
+}
+
+
+
+static void handle_filter(struct epoll_fd_ctx   *p,
+                          char                  *buff,
+                          ssize_t               recv_size
+                          )
+{
+    char        *spec   = buff + strlen("filter");
+    char        err[256];
+    int         id      = -1;
+
+
+    spec += strspn(spec, " \t");
+
+    if ( *spec == 0 )
+    {
+        NETLOGG_BACK(p->fd, NETLOGG_INFO, "Filter: %s", (p->filter != -1) ? netlogg_filter_spec(p->filter) : "none");
+
+        return;
+    }
+
+    if ( strcmp(spec, "none") == 0 )
+    {
+        if ( p->filter != -1 )
+        {
+            netlogg_filter_put(p->filter);
+            p->filter = -1;
+        }
+
+        NETLOGG_BACK(p->fd, NETLOGG_INFO, "Sending all the messages (from %s)", p->ipv4_addr);
+
+        return;
+    }
+
+    if ( ( (strncmp(spec, "file=", 5) != 0) && (strncmp(spec, "match=", 6) != 0) && (strncmp(spec, "regex=", 6) != 0) ) ||
+         (strchr(spec, '=')[1] == 0) )
+    {
+        NETLOGG_BACK(p->fd, NETLOGG_INFO, "Usage: filter file=NAME|match=TEXT|regex=REGEX|none");
+
+        return;
+    }
+
+    // The members are compressed once per level for all the clients
+    if ( p->zip )
+    {
+        NETLOGG_BACK(p->fd, NETLOGG_INFO, "The filtered messages are not compressed (compress none first)");
+
+        return;
+    }
+
+    // Compiled only if no other client uses the same filter
+    id = netlogg_filter_get(spec, err, sizeof(err) );
+
+    if ( id == -1 )
+    {
+        NETLOGG_BACK(p->fd, NETLOGG_INFO, "Filter %s refused: %s", spec, err);
+
+        return;
+    }
+
+    if ( p->filter != -1 )
+    {
+        netlogg_filter_put(p->filter);
+    }
+
+    p->filter = id;
+
+    NETLOGG_BACK(p->fd, NETLOGG_INFO, "Sending the messages of the filter %s (from %s)", spec, p->ipv4_addr);
+}
+
+
+
+static void handle_ratelimit(struct epoll_fd_ctx    *p,
+                             char                   *buff,
+                             ssize_t                recv_size
+                             )
+{
+    const netlogg_ratelimit_rule    *rules  = NULL;
+    const char                      *file   = NULL;
+    char                            *colon  = NULL;
+    char                            target[NETLOGG_RATELIMIT_FILE_MAX + 16];
+    char                            rate[16];
+    unsigned int                    burst   = 0;
+    uint32_t                        nb      = 0;
+    int32_t                         lineno  = 0;
+    uint64_t                        dropped = 0;
+    int                             n       = 0;
+
+
+    n = sscanf(buff, "ratelimit %143s %15s %u", target, rate, &burst);
+
+    if ( n <= 0 )
+    {
+        rules = netlogg_ratelimit_rules(&nb);
+
+        for ( uint32_t i = 0; i < nb; i++ )
+        {
+            if ( __atomic_load_n(&rules[i].rate, __ATOMIC_RELAXED) != 0 )
+            {
+                NETLOGG_BACK(p->fd, NETLOGG_INFO, "Rate limit of %s:%" PRId32 ": %" PRIu32 " messages/s, burst %" PRIu32, rules[i].file, rules[i].lineno,
+                             __atomic_load_n(&rules[i].rate, __ATOMIC_RELAXED), __atomic_load_n(&rules[i].burst, __ATOMIC_RELAXED) );
+            }
+        }
+
+        for ( uint32_t i = 0; i < NETLOGG_RATELIMIT_SITES; i++ )
+        {
+            dropped = netlogg_ratelimit_site(i, &file, &lineno);
+
+            if ( dropped != 0 )
+            {
+                NETLOGG_BACK(p->fd, NETLOGG_INFO, "%s:%" PRId32 ": %" PRIu64 " messages dropped", file, lineno, dropped);
+            }
+        }
+
+        return;
+    }
+
+    if ( (n < 2) || ( (strcmp(rate, "off") != 0) && (strspn(rate, "0123456789") != strlen(rate) ) ) )
+    {
+        NETLOGG_BACK(p->fd, NETLOGG_INFO, "Usage: ratelimit FILE[:LINE]|* RATE|off [BURST]");
+
+        return;
+    }
+
+    // The line of the site, 0 for every line of the file
+    colon = strrchr(target, ':');
+
+    if ( colon != NULL )
+    {
+        *colon  = 0;
+        lineno  = atoi(colon + 1);
+    }
+
+    if ( netlogg_ratelimit_set(target, lineno, (strcmp(rate, "off") != 0) ? (uint32_t) strtoul(rate, NULL, 10) : 0, burst) == -1 )
+    {
+        NETLOGG_BACK(p->fd, NETLOGG_INFO, "Rate limit of %s refused: too many rules (%d) or file name too long", target, NETLOGG_RATELIMIT_RULES_MAX);
+
+        return;
+    }
+
+    NETLOGG_BACK(p->fd, NETLOGG_INFO, "Rate limit of %s:%" PRId32 " set to %s messages/s (from %s)", target, lineno, rate, p->ipv4_addr);
+}
+
+
+
+static void handle_setlevel(struct epoll_fd_ctx     *p,
+                            char                    *buff,
+                            ssize_t                 recv_size
+                            )
+{
+    static const char               *names[NETLOGG_LVLS] = {"emerg", "alert", "crit", "error", "warn", "notice", "info", "debug"};
+    const netlogg_levels_rule       *rules  = NULL;
+    char                            glob[NETLOGG_LEVELS_GLOB_MAX + 16];
+    char                            name[16];
+    uint32_t                        nb      = 0;
+    int                             lvl     = -1;
+    int                             n       = 0;
+
+
+    n = sscanf(buff, "setlevel %143s %15s", glob, name);
+
+    if ( n <= 0 )
     {
-        if ( netlogger_ctx[i].fd != -1 )
+        rules = netlogg_levels_rules(&nb);
+
+        for ( uint32_t i = 0; i < nb; i++ )
         {
-            NETLOGG_BACK(p->fd, NETLOGG_INFO, "Client %d: %s (%s:%s)", i + 1 - EPOLL_FD_SEND0, netlogger_ctx[i].hostname, netlogger_ctx[i].ipv4_addr, netlogger_ctx[i].service);
+            lvl = __atomic_load_n(&rules[i].lvl, __ATOMIC_RELAXED);
+
+            if ( lvl != -1 )
+            {
+                NETLOGG_BACK(p->fd, NETLOGG_INFO, "Level of %s: %s", rules[i].glob, names[lvl]);
+            }
         }
+
+        return;
+    }
+
+    for ( lvl = NETLOGG_LVLS - 1; (n == 2) && (lvl >= 0) && (strcmp(name, names[lvl]) != 0); lvl-- )
+    {
+    }
+
+    if ( (n != 2) || ( (lvl == -1) && (strcmp(name, "reset") != 0) ) )
+    {
+        NETLOGG_BACK(p->fd, NETLOGG_INFO, "Usage: setlevel GLOB emerg|alert|crit|error|warn|notice|info|debug|reset");
+
+        return;
+    }
+
+    if ( netlogg_levels_set(glob, lvl) == -1 )
+    {
+        NETLOGG_BACK(p->fd, NETLOGG_INFO, "Level of %s refused: too many patterns (%d) or pattern too long", glob, NETLOGG_LEVELS_MAX);
+
+        return;
     }
-}
\ No newline at end of file
+
+    // The call sites see the new level on their next call
+    netlogg_lvl_gen_bump();
+
+    NETLOGG(NETLOGG_NOTICE, "Level of %s set to %s by %s", glob, name, p->ipv4_addr);
+    NETLOGG_BACK(p->fd, NETLOGG_INFO, "Level of %s set to %s (from %s)", glob, name, p->ipv4_addr);
+}
@@ -9,6 +9,7 @@
 #define __NETLOGGING_H__
 
 #include <stdint.h>          // int8_t, int32_t
+#include <stddef.h>          // size_t
 #include <stdio.h>           // vfprintf
 #include <syslog.h>
 
@@ -17,6 +18,7 @@ extern "C" {
 #endif
 
 typedef enum Netlogging_lvl {
+    NETLOGG_LVL_EMERG_ONLY = -1,          ///< Only NETLOGG_EMERG, which means dft_lvl in the levels of Netlogging_args
     NETLOGG_EMERG = LOG_EMERG,
     NETLOGG_ALERT = LOG_ALERT,
     NETLOGG_CRIT = LOG_CRIT,
@@ -29,23 +31,239 @@ typedef enum Netlogging_lvl {
 } Netlogging_lvl;
 
 
+typedef enum Netlogging_overflow {
+    NETLOGG_OVERFLOW_DROP_OLDEST = 0,          ///< Drop the oldest messages not sent yet
+    NETLOGG_OVERFLOW_DROP_NEWEST,          ///< Drop the new messages
+    NETLOGG_OVERFLOW_DISCONNECT          ///< Close the connection of the client
+} Netlogging_overflow;
+
+
+typedef enum Netlogging_backpressure {
+    NETLOGG_BP_LEVEL = -1,          ///< The policy of the level of the message (Netlogging_args.backpressure)
+    NETLOGG_BP_DROP = 0,          ///< Drop the new message and count it, never wait
+    NETLOGG_BP_BLOCK,          ///< Wait for room up to Netlogging_args.block_timeout_us, then drop the new message
+    NETLOGG_BP_OVERWRITE          ///< Drop the oldest messages not rendered yet
+} Netlogging_backpressure;
+
+
 typedef struct {
     const char      *progname;
     uint16_t        port;
     Netlogging_lvl  dft_lvl;
+    size_t          out_queue_size;          ///< Bytes waiting for a slow client before the overflow policy applies (0: default)
+    Netlogging_overflow overflow;          ///< What to do when the output queue of a client is full
+    uint32_t        max_clients;          ///< Maximum number of connected clients, the next ones are rejected (0: default)
+    uint32_t        batch_size;          ///< Messages sent to a client with one system call (0: default, at most IOV_MAX)
+    size_t          batch_bytes;          ///< Bytes rendered before they are sent to the clients (0: default)
+    uint8_t         coarse_clock;          ///< Timestamp the messages with CLOCK_REALTIME_COARSE (faster, precise to a tick)
+    uint32_t        workers;          ///< Threads sharing the clients to send them the messages (0: the netlogging thread does it)
+    uint32_t        history_msgs;          ///< Messages kept in the history (0: default, rounded up to a power of two, at most 2^24)
+    size_t          history_size;          ///< Bytes of rendered messages kept in the history (0: default)
+    Netlogging_lvl  history_lvl;          ///< Less severe level kept in the history (0: dft_lvl, NETLOGG_LVL_EMERG_ONLY: NETLOGG_EMERG)
+    const char      *recorder_path;          ///< File keeping the records not sent yet after a crash, e.g. in /dev/shm (NULL: none)
+    const char      *file_path;          ///< File where the messages are written (NULL: none)
+    Netlogging_lvl  file_lvl;          ///< Less severe level written in the file (0: dft_lvl, NETLOGG_LVL_EMERG_ONLY: NETLOGG_EMERG)
+    uint64_t        file_max_size;          ///< Size of the file that triggers a rotation (0: no rotation on the size)
+    uint32_t        file_max_age;          ///< Seconds after which the file is rotated (0: no rotation on the time)
+    uint32_t        file_keep;          ///< Number of rotated files kept (0: default)
+    uint32_t        file_sync_ms;          ///< Interval between two fdatasync of the file in milliseconds (0: never synced)
+    uint8_t         file_compress;          ///< Write the file compressed with gzip (e.g. name it .gz)
+    uint16_t        metrics_port;          ///< Port of the metrics endpoint, in the text format of Prometheus (0: none)
+    uint32_t        rate_limit;          ///< Broadcast messages per second of each call site, the next ones are dropped (0: no limit)
+    uint32_t        rate_burst;          ///< Messages of a call site sent at once before rate_limit applies (0: rate_limit)
+    uint8_t         collapse_repeats;          ///< Send the same message logged again as "last message repeated N times"
+    Netlogging_backpressure backpressure[NETLOGG_LVLS];          ///< What a message of each level does when the ring is full (default: NETLOGG_BP_DROP)
+    uint32_t        block_timeout_us;          ///< Longest wait of a NETLOGG_BP_BLOCK message in microseconds (0: default)
 } Netlogging_args;
 
 
 /**
- * \brief      Send a message through
+ * \brief Line sent before the first binary frame (see the "mode binary" command)
+ */
+#define NETLOGG_FRAME_HELLO     "NLGBIN1\n"
+
+
+/**
+ * \brief Type of a binary frame
+ */
+typedef enum Netlogging_frame_type {
+    NETLOGG_FRAME_FILE = 1,          ///< Entry of the file dictionary: the payload is the name of file_id
+    NETLOGG_FRAME_MSG          ///< Message: the payload is its text (without the date, the file, the level and the newline)
+} Netlogging_frame_type;
+
+
+/**
+ * \brief file_id of a message whose file is not in the dictionary: its name (nul terminated) starts the payload
+ */
+#define NETLOGG_FILE_ID_INLINE  0xFFFF
+
+
+/**
+ * \brief Header of a binary frame (little endian), followed by the payload
+ */
+typedef struct __attribute__( (packed) ) {
+    uint32_t        size;          ///< Size of the frame, header included
+    uint8_t         type;          ///< Netlogging_frame_type
+    uint8_t         lvl;          ///< Level of the message
+    uint16_t        file_id;          ///< File of the message (see NETLOGG_FRAME_FILE)
+    int32_t         lineno;          ///< Line of the message
+    uint64_t        ts;          ///< Timestamp of the message (nanoseconds since the Epoch)
+} netlogg_frame;
+
+
+/**
+ * \brief Highest level wanted by the syslog or a connected client (kept up to date by the netlogging thread)
+ */
+extern int netlogg_max_lvl;
+
+
+/**
+ * \brief Generation of the levels, incremented when netlogg_max_lvl or the level of a file changes (low 24 bits, never 0)
+ */
+extern uint32_t netlogg_lvl_gen;
+
+
+/**
+ * \brief Less severe level kept at compile time: the NETLOGG calls above it are removed
+ *
+ * Define it before including netlogging.h (or with -DNETLOGG_COMPILE_MIN_LVL=NETLOGG_INFO)
+ */
+#ifndef NETLOGG_COMPILE_MIN_LVL
+    #define NETLOGG_COMPILE_MIN_LVL     NETLOGG_DEBUG
+#endif
+
+
+/**
+ * \brief Static description of a NETLOGG call site
+ *
+ * One is created by each NETLOGG call and placed in the `netlogg_sites`
+ * section, so that the sites of a binary can be listed with the
+ * __start_netlogg_sites and __stop_netlogg_sites symbols (e.g. to decode the
+ * format pointers of the records offline).
+ */
+typedef struct netlogg_site {
+    const char      *file;          ///< File of the call site
+    const char      *format;          ///< Format of the message
+    int32_t         lineno;          ///< Line of the call site
+    Netlogging_lvl  lvl;          ///< Level of the message
+    uint32_t        lvl_cache;          ///< Less severe level wanted for the site, and netlogg_lvl_gen when it was computed (atomic)
+    Netlogging_backpressure bp;          ///< What the message does when the ring is full (NETLOGG_BP_LEVEL: the policy of its level)
+} netlogg_site;
+
+
+/**
+ * \brief      Compute again the level wanted for a call site (level of its file and netlogg_max_lvl)
+ *
+ * \param      site  The call site
+ *
+ * \return     The new lvl_cache word of the site
+ */
+uint32_t netlogg_site_refresh(netlogg_site *site);
+
+
+/**
+ * \brief      Tell if the message of a call site is wanted
+ *
+ * The level is only computed again when the levels change: a disabled site
+ * costs two loads.
  *
+ * \param      site  The call site
+ *
+ * \return     1 if it is wanted, 0 otherwise
+ */
+static inline int netlogg_site_enabled(netlogg_site *site) __attribute__( (always_inline) );
+static inline int netlogg_site_enabled(netlogg_site *site)
+{
+    uint32_t     word = __atomic_load_n(&site->lvl_cache, __ATOMIC_RELAXED);
+
+
+    if ( (word >> 8) != (__atomic_load_n(&netlogg_lvl_gen, __ATOMIC_RELAXED) & 0xFFFFFF) )
+    {
+        word = netlogg_site_refresh(site);
+    }
+
+    return ( (int) site->lvl <= (int) (word & 0xFF) );
+}
+
+
+/**
+ * \brief      Only there to let the compiler check the format of the NETLOGG calls
+ */
+static inline void netlogg_check_format(const char *format, ...) __attribute__( (format(printf, 1, 2) ) );
+static inline void netlogg_check_format(const char *format, ...)
+{
+    (void) format;
+}
+
+
+/**
+ * \brief      Send a message to a client (or to all of them if fd is -1), with its own policy when the ring is full
+ *
+ * The level and the format have to be constants. Nothing is done (no argument
+ * evaluated) if nobody wants the level or if the file of the call is set to a
+ * less verbose level (setlevel command), and nothing is compiled if the level
+ * is above NETLOGG_COMPILE_MIN_LVL.
+ *
+ * \param      fd    The client (-1 for all the clients)
+ * \param      bp    What to do when the ring is full (Netlogging_backpressure)
+ * \param      l     level
+ * \param      f     The format
+ * \param      ...   List of variable for the format
+ */
+#define NETLOGG_TO_BP(fd, bp, l, f, ...) \
+    do \
+    { \
+        if ( (int) (l) <= (int) NETLOGG_COMPILE_MIN_LVL ) \
+        { \
+            static netlogg_site netlogg_site_ __attribute__( (section("netlogg_sites"), aligned(8) ) ) = \
+            { \
+                __FILE__, f, __LINE__, l, 0, bp \
+            }; \
+            if ( 0 ) \
+            { \
+                netlogg_check_format(f, ##__VA_ARGS__); \
+            } \
+            if ( ( (fd) != -1) || netlogg_site_enabled(&netlogg_site_) ) \
+            { \
+                netlogg_send_site(&netlogg_site_, (fd), ##__VA_ARGS__); \
+            } \
+        } \
+    } while ( 0 )
+
+
+/**
+ * \brief      Send a message to a client (or to all of them if fd is -1)
+ *
+ * \param      fd    The client (-1 for all the clients)
+ * \param      l     level
+ * \param      f     The format
+ * \param      ...   List of variable for the format
+ */
+#define NETLOGG_TO(fd, l, f, ...)       NETLOGG_TO_BP(fd, NETLOGG_BP_LEVEL, l, f, ##__VA_ARGS__)
+
+
+/**
+ * \brief      Send a message to all the clients, with its own policy when the ring is full
+ *
+ * e.g. NETLOGG_BP(NETLOGG_BP_OVERWRITE, NETLOGG_DEBUG, ...) for a message that
+ * should push the older ones out rather than be lost.
+ *
+ * \param      bp    What to do when the ring is full (Netlogging_backpressure)
  * \param      l     level
- * \param      f     { parameter_description }
- * \param      ...   { parameter_description }
+ * \param      f     The format
+ * \param      ...   List of variable for the format
+ */
+#define NETLOGG_BP(bp, l, f, ...)       NETLOGG_TO_BP(-1, bp, l, f, ##__VA_ARGS__)
+
+
+/**
+ * \brief      Send a message to all the clients
  *
- * \return     { description_of_the_return_value }
+ * \param      l     level
+ * \param      f     The format
+ * \param      ...   List of variable for the format
  */
-#define NETLOGG(...)        netlogg_send(__FILE__, __LINE__, -1, __VA_ARGS__)
+#define NETLOGG(l, f, ...)      NETLOGG_TO(-1, l, f, ##__VA_ARGS__)
 
 
 /**
@@ -64,8 +282,17 @@ void netlogg_start(void);
 /**
  * \brief      Send a message to all connected clients
  *
+ * The message is rendered by the caller and copied in the ring with the name
+ * of the file: file and format can be built or freed once it returns. The
+ * NETLOGG calls use netlogg_send_site instead, which is cheaper. The level of
+ * the file (setlevel command) and the rate limits (ratelimit command) only
+ * apply to the NETLOGG calls. When the ring is full, the policy of the level applies
+ * (Netlogging_args.backpressure); the messages from NETLOGG_ERROR up to
+ * NETLOGG_EMERG also have the end of the ring to themselves.
+ *
  * \param[in]  file       The file
  * \param[in]  lineno     The line number
+ * \param[in]  fd         The client (-1 for all the clients)
  * \param[in]  lvl        The logging level
  * \param      format     The format
  * \param[in]  ...        List of variable for the format
@@ -77,7 +304,40 @@ int8_t netlogg_send(const char              *file,
                     const int               fd,
                     const Netlogging_lvl    lvl,
                     const char              *format,
-                    ...);
+                    ...) __attribute__( (format(printf, 5, 6) ) );
+
+
+/**
+ * \brief      Send a message described by a call site (see NETLOGG_TO)
+ *
+ * Only the arguments are copied by the caller, the message is rendered later by
+ * the netlogging thread: the file and the format of the site have to be static
+ * strings (string literals), the strings given for %s are copied. Positional
+ * arguments (%1$d) are not supported.
+ *
+ * \param[in]  site       The call site (file, line, level, format and policy when the ring is full)
+ * \param[in]  fd         The client (-1 for all the clients)
+ * \param[in]  ...        List of variable for the format
+ *
+ * \return     Error code
+ */
+int8_t netlogg_send_site(const netlogg_site     *site,
+                         const int              fd,
+                         ...);
+
+
+/**
+ * \brief      Write the records not sent yet to a file (async-signal-safe)
+ *
+ * Meant to be called from a crash handler: only write(2) is used. The file has
+ * the format of the flight recorder (see Netlogging_args.recorder_path) and is
+ * read by netlogg_decode.
+ *
+ * \param[in]  fd    The file descriptor
+ *
+ * \return     0 on success, -1 on error
+ */
+int netlogg_recorder_dump(int fd);
 
 
 #ifdef __cplusplus